@@ -59,6 +59,7 @@ extern "C" {
 #define restrict
 #endif
 
+int asprintf (char** restrict, const char* restrict, ...) NIRVANA_PRINTF (2, 3);
 void clearerr (FILE*);
 int fclose (FILE*);
 FILE *fdopen(int, const char *);
@@ -69,6 +70,7 @@ int fgetc (FILE*);
 int fgetpos (FILE* restrict, fpos_t* restrict);
 char* fgets (char* restrict, int, FILE* restrict);
 int fileno (FILE*);
+void flockfile (FILE*);
 FILE* fopen (const char* restrict, const char* restrict);
 int fputc (int, FILE*);
 int fputs (const char* restrict, FILE* restrict);
@@ -81,6 +83,8 @@ int fseeko (FILE*, off_t, int);
 int fsetpos (FILE*, const fpos_t*);
 long ftell (FILE*);
 off_t ftello (FILE*);
+int ftrylockfile (FILE*);
+void funlockfile (FILE*);
 size_t fwrite (const void* restrict, size_t, size_t, FILE* restrict);
 
 inline int getc (FILE* f)
@@ -89,6 +93,8 @@ inline int getc (FILE* f)
 }
 
 int getchar (void);
+ssize_t getdelim (char** restrict, size_t* restrict, int, FILE* restrict);
+ssize_t getline (char** restrict, size_t* restrict, FILE* restrict);
 char* gets (char*);  // removed in C++14
 void perror (const char*);
 int printf (const char* restrict, ...) NIRVANA_PRINTF (1, 2);
@@ -124,6 +130,79 @@ int vsprintf (char* restrict, const char* restrict, va_list);
 int vsscanf (const char* restrict, const char* restrict, va_list);
 int ungetc (int, FILE*);
 
+// The streams are never shared between execution contexts, so the stream locking
+// only validates the stream. getc_unlocked () and putc_unlocked () skip the validation
+// and access the stream buffer directly. The other unlocked functions are the same
+// as the regular ones.
+
+int getc_unlocked (FILE*);
+int putc_unlocked (int, FILE*);
+
+inline int getchar_unlocked (void)
+{
+	return getchar ();
+}
+
+inline int putchar_unlocked (int ch)
+{
+	return putchar (ch);
+}
+
+inline void clearerr_unlocked (FILE* f)
+{
+	clearerr (f);
+}
+
+inline int feof_unlocked (FILE* f)
+{
+	return feof (f);
+}
+
+inline int ferror_unlocked (FILE* f)
+{
+	return ferror (f);
+}
+
+inline int fflush_unlocked (FILE* f)
+{
+	return fflush (f);
+}
+
+inline int fgetc_unlocked (FILE* f)
+{
+	return getc_unlocked (f);
+}
+
+inline char* fgets_unlocked (char* restrict s, int n, FILE* restrict f)
+{
+	return fgets (s, n, f);
+}
+
+inline int fileno_unlocked (FILE* f)
+{
+	return fileno (f);
+}
+
+inline int fputc_unlocked (int ch, FILE* f)
+{
+	return putc_unlocked (ch, f);
+}
+
+inline int fputs_unlocked (const char* restrict s, FILE* restrict f)
+{
+	return fputs (s, f);
+}
+
+inline size_t fread_unlocked (void* restrict buf, size_t size, size_t count, FILE* restrict f)
+{
+	return fread (buf, size, count, f);
+}
+
+inline size_t fwrite_unlocked (const void* restrict buf, size_t size, size_t count, FILE* restrict f)
+{
+	return fwrite (buf, size, count, f);
+}
+
 #ifdef _MSC_VER
 #define _scprintf(format, ...) sprintf_s (nullptr, 0, format, __VA_ARGS__)
 #endif
@@ -92,6 +92,7 @@ int           vswscanf (const wchar_t *restrict, const wchar_t *restrict, va_lis
 int           vwprintf (const wchar_t *restrict, va_list);
 int           vwscanf (const wchar_t *restrict, va_list);
 size_t        wcrtomb (char *restrict, wchar_t, mbstate_t *restrict);
+int           wcscasecmp (const wchar_t *, const wchar_t *);
 wchar_t      *wcscat (wchar_t *restrict, const wchar_t *restrict);
 wchar_t      *wcschr (const wchar_t *, wchar_t);
 int           wcscmp (const wchar_t *, const wchar_t *);
@@ -103,6 +104,7 @@ size_t        wcscspn (const wchar_t *, const wchar_t *);
 size_t        wcsftime (wchar_t* restrict, size_t, const wchar_t* restrict,
   const struct tm* restrict) NIRVANA_WSTRFTIME(3);
 size_t        wcslen (const wchar_t*);
+int           wcsncasecmp (const wchar_t *, const wchar_t *, size_t);
 wchar_t      *wcsncat (wchar_t *restrict, const wchar_t *restrict, size_t);
 int           wcsncmp (const wchar_t *, const wchar_t *, size_t);
 wchar_t      *wcsncpy (wchar_t *restrict, const wchar_t *restrict, size_t);
@@ -55,6 +55,14 @@ wint_t towupper (wint_t);
 wctrans_t wctrans (const char*);
 wctype_t wctype(const char*);
 
+/// Convert \p n wide characters to lowercase.
+/// Nirvana extension. \p dst may be equal to \p src.
+void towlower_n (wchar_t* dst, const wchar_t* src, size_t n);
+
+/// Convert \p n wide characters to uppercase.
+/// Nirvana extension. \p dst may be equal to \p src.
+void towupper_n (wchar_t* dst, const wchar_t* src, size_t n);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,62 +25,124 @@
 */
 #include <ctype.h>
 #include "impl/locale.h"
+#include "impl/Global.h"
 #include <Nirvana/locale_defs.h>
 
+namespace CRTL {
+
+namespace {
+
+typedef Nirvana::CodePage::CharCategory Category;
+typedef Nirvana::CodePage CP;
+
+// Category flags of the ASCII character in the "C" locale
+constexpr Category ascii_category (int c) noexcept
+{
+	Category cat = 0;
+	if (c < 0x20 || c == 0x7F)
+		cat |= CP::CC_CNTRL;
+	if (c == ' ' || (c >= '\t' && c <= '\r'))
+		cat |= CP::CC_SPACE;
+	if (c == ' ' || c == '\t')
+		cat |= CP::CC_BLANK;
+	if (c >= 'A' && c <= 'Z')
+		cat |= CP::CC_UPPER;
+	else if (c >= 'a' && c <= 'z')
+		cat |= CP::CC_LOWER;
+	else if (c >= '0' && c <= '9')
+		cat |= CP::CC_DIGIT;
+	else if (c > ' ' && c < 0x7F)
+		cat |= CP::CC_PUNCT;
+	if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'))
+		cat |= CP::CC_XDIGIT;
+	return cat;
+}
+
+// Category flags of the "C" locale. Octets above 0x7F have no category.
+struct CTypeTable
+{
+	constexpr CTypeTable () noexcept :
+		category ()
+	{
+		for (int c = 0; c < 0x80; ++c) {
+			category [c] = ascii_category (c);
+		}
+	}
+
+	Category category [256];
+};
+
+constexpr CTypeTable c_locale;
+
+inline Category category (int c) noexcept
+{
+	return (unsigned)c < 256 ? c_locale.category [c] : 0;
+}
+
+// Category flags in the locale.
+// The locale tables are cached, so the locale facet is not queried per character.
+inline Category category (int c, locale_t l) noexcept
+{
+	if ((unsigned)c >= 256)
+		return 0;
+	const CodePageTable* table = Global::ctype_table (l);
+	if (table)
+		return table->category ((uint8_t)c);
+	else
+		return c_locale.category [c];
+}
+
+// <space> is the only printable character of the space class
+inline int is_print (Category cat) noexcept
+{
+	return (cat & CP::CC_PRINT) && !(cat & CP::CC_CNTRL);
+}
+
+}
+
+}
+
+using CRTL::category;
+using CRTL::CP;
+
 extern "C" int isalnum (int c)
 {
-	return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	return (category (c) & CP::CC_ALNUM) != 0;
 }
 
 extern "C" int isalnum_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_ALNUM;
-	else
-		return isalnum (c);
+	return (category (c, l) & CP::CC_ALNUM) != 0;
 }
 
 extern "C" int isalpha (int c)
 {
-	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+	return (category (c) & CP::CC_ALPHA) != 0;
 }
 
 extern "C" int isalpha_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_ALPHA;
-	else
-		return isalpha (c);
+	return (category (c, l) & CP::CC_ALPHA) != 0;
 }
 
 extern "C" int isblank (int c)
 {
-	return c == ' ' || c == '\t';
+	return (category (c) & CP::CC_BLANK) != 0;
 }
 
 extern "C" int isblank_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_BLANK;
-	else
-		return isblank (c);
+	return (category (c, l) & CP::CC_BLANK) != 0;
 }
 
 extern "C" int iscntrl (int c)
 {
-	return (c <= 0x1F) || (c == 0x7F);
+	return (category (c) & CP::CC_CNTRL) != 0;
 }
 
 extern "C" int iscntrl_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_CNTRL;
-	else
-		return iscntrl (c);
+	return (category (c, l) & CP::CC_CNTRL) != 0;
 }
 
 extern "C" int isdigit (int c)
@@ -90,25 +152,17 @@ extern "C" int isdigit (int c)
 
 extern "C" int isdigit_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_DIGIT;
-	else
-		return isdigit (c);
+	return (category (c, l) & CP::CC_DIGIT) != 0;
 }
 
 extern "C" int isgraph (int c)
 {
-	return c >= 0x21 && c <= 0x7E;
+	return (category (c) & CP::CC_GRAPH) != 0;
 }
 
 extern "C" int isgraph_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_GRAPH;
-	else
-		return isgraph (c);
+	return (category (c, l) & CP::CC_GRAPH) != 0;
 }
 
 extern "C" int islower (int c)
@@ -118,59 +172,37 @@ extern "C" int islower (int c)
 
 extern "C" int islower_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_LOWER;
-	else
-		return islower (c);
+	return (category (c, l) & CP::CC_LOWER) != 0;
 }
 
 extern "C" int isprint (int c)
 {
-	return c >= 0x20 && c <= 0x7E;
+	return CRTL::is_print (category (c));
 }
 
 extern "C" int isprint_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_PRINT;
-	else
-		return isprint (c);
+	return CRTL::is_print (category (c, l));
 }
 
 extern "C" int ispunct (int c)
 {
-	return c == '!' || c == '"' || c == '#' || c == '$' || c == '%' || c == '&'
-	|| c == '\'' || c == '(' || c == ')' || c == '*' || c == '+' || c == ','
-	|| c == '-' || c == '.' || c == '/'
-	|| c == ':' || c == ';' || c == '<' || c == '=' || c == '>' || c == '?'
-	|| c == '@'
-	|| c == '[' || c == '\\' || c == ']' || c == '^' || c == '_' || c == '`'
-	|| c == '{' || c == '|' || c == '}' || c == '~';
+	return (category (c) & CP::CC_PUNCT) != 0;
 }
 
 extern "C" int ispunct_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_PUNCT;
-	else
-		return ispunct (c);
+	return (category (c, l) & CP::CC_PUNCT) != 0;
 }
 
 extern "C" int isspace (int c)
 {
-	return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+	return (category (c) & CP::CC_SPACE) != 0;
 }
 
 extern "C" int isspace_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_SPACE;
-	else
-		return isspace (c);
+	return (category (c, l) & CP::CC_SPACE) != 0;
 }
 
 extern "C" int isupper (int c)
@@ -180,25 +212,17 @@ extern "C" int isupper (int c)
 
 extern "C" int isupper_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_UPPER;
-	else
-		return isupper (c);
+	return (category (c, l) & CP::CC_UPPER) != 0;
 }
 
 extern "C" int isxdigit (int c)
 {
-	return c >= '0' && c <= '9';
+	return (category (c) & CP::CC_XDIGIT) != 0;
 }
 
 extern "C" int isxdigit_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->get_category (c) == Nirvana::CodePage::CC_XDIGIT;
-	else
-		return isxdigit (c);
+	return (category (c, l) & CP::CC_XDIGIT) != 0;
 }
 
 extern "C" int tolower (int c)
@@ -211,9 +235,9 @@ extern "C" int tolower (int c)
 
 extern "C" int tolower_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->to_lower (c);
+	const CRTL::CodePageTable* table;
+	if ((unsigned)c < 256 && (table = CRTL::Global::ctype_table (l)))
+		return table->to_lower ((uint8_t)c);
 	else
 		return tolower (c);
 }
@@ -228,9 +252,9 @@ extern "C" int toupper (int c)
 
 extern "C" int toupper_l (int c, locale_t l)
 {
-	auto cp = CRTL::get_cp (l);
-	if (cp)
-		return cp->to_upper (c);
+	const CRTL::CodePageTable* table;
+	if ((unsigned)c < 256 && (table = CRTL::Global::ctype_table (l)))
+		return table->to_upper ((uint8_t)c);
 	else
 		return toupper (c);
 }
@@ -30,3 +30,8 @@ extern "C" FILE* fopen (const char* file, const char* mode)
 {
 	return CRTL::Global::fopen (file, mode);
 }
+
+extern "C" FILE* fdopen (int fd, const char* mode)
+{
+	return CRTL::Global::fdopen (fd, mode);
+}
@@ -29,8 +29,14 @@ namespace CRTL {
 
 void ByteOutFile::put (unsigned c)
 {
-	char ch = (char)c;
-	int e = file_->write (&ch, 1);
+	int e = file_->putc ((char)c);
+	if (e)
+		throw CORBA::UNKNOWN (Nirvana::make_minor_errno (e));
+}
+
+void ByteOutFile::write (const char* s, size_t len)
+{
+	int e = file_->write (s, len);
 	if (e)
 		throw CORBA::UNKNOWN (Nirvana::make_minor_errno (e));
 }
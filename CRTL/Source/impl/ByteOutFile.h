@@ -40,6 +40,7 @@ public:
 	{}
 
 	void put (unsigned c) override;
+	void write (const char* s, size_t len) override;
 
 private:
 	File* file_;
@@ -0,0 +1,101 @@
+/*
+* Nirvana C runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include "CodePageTable.h"
+#include <algorithm>
+
+namespace CRTL {
+
+void CodePageTable::build (Nirvana::CodePage::_ptr_type cp)
+{
+	code_page_ = nullptr;
+	code_page_ref_ = nullptr;
+
+	// The reverse table is the inverse of the narrow to wide mapping.
+	// The first octet mapped to a wide character wins.
+	std::fill_n (narrow_, sizeof (narrow_), 0);
+	for (unsigned c = 0; c < 256; ++c) {
+		uint32_t wc;
+		try {
+			wc = cp->to_wide ((uint8_t)c);
+		} catch (const CORBA::CODESET_INCOMPATIBLE&) {
+			wc = NO_WIDE;
+		}
+		wide_ [c] = wc;
+		if (wc && wc < sizeof (narrow_) && !narrow_ [wc])
+			narrow_ [wc] = (uint8_t)c;
+
+		category_ [c] = cp->get_category ((uint8_t)c);
+		upper_ [c] = cp->to_upper ((uint8_t)c);
+		lower_ [c] = cp->to_lower ((uint8_t)c);
+	}
+
+	// The reference keeps the code page alive, so the pointer can not be reused.
+	code_page_ref_ = cp;
+	code_page_ = &cp;
+}
+
+bool CodePageTable::to_wide (const char*& src, const char* end, wchar_t*& dst, wchar_t* dst_end)
+	const noexcept
+{
+	const char* p = src;
+	wchar_t* d = dst;
+	const char* stop = p + std::min (end - p, dst_end - d);
+	bool ret = true;
+	for (; p != stop; ++p) {
+		uint32_t wc = wide_ [(uint8_t)*p];
+		if (NO_WIDE == wc) {
+			ret = false;
+			break;
+		}
+		*(d++) = (wchar_t)wc;
+	}
+	src = p;
+	dst = d;
+	return ret;
+}
+
+bool CodePageTable::to_narrow (const wchar_t*& src, const wchar_t* end, char*& dst, char* dst_end)
+	const noexcept
+{
+	const wchar_t* p = src;
+	char* d = dst;
+	const wchar_t* stop = p + std::min (end - p, dst_end - d);
+	bool ret = true;
+	for (; p != stop; ++p) {
+		uint32_t wc = (uint32_t)*p;
+		uint8_t c;
+		if (wc >= sizeof (narrow_) || (!(c = narrow_ [wc]) && wc)) {
+			ret = false;
+			break;
+		}
+		*(d++) = (char)c;
+	}
+	src = p;
+	dst = d;
+	return ret;
+}
+
+}
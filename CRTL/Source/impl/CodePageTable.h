@@ -0,0 +1,118 @@
+/*
+* Nirvana C runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef CRTL_IMPL_CODEPAGETABLE_H_
+#define CRTL_IMPL_CODEPAGETABLE_H_
+#pragma once
+
+#include <CORBA/CORBA.h>
+#include <Nirvana/nls.h>
+#include <stdint.h>
+
+namespace CRTL {
+
+/// Translation and classification tables of the single-byte code page.
+/// 
+/// The tables are built once from the CodePage interface, so the bulk conversions
+/// and the character classification do not call the interface per character.
+class CodePageTable
+{
+public:
+	CodePageTable () noexcept :
+		code_page_ (nullptr)
+	{}
+
+	/// \returns `true` if the tables are built for \p cp.
+	bool is_same (Nirvana::CodePage::_ptr_type cp) const noexcept
+	{
+		return code_page_ == &cp;
+	}
+
+	/// Build the tables for the code page.
+	/// 
+	/// \param cp The code page.
+	void build (Nirvana::CodePage::_ptr_type cp);
+
+	/// Convert narrow characters to wide.
+	/// Conversion stops at the end of the source or if there is no room in the destination.
+	/// 
+	/// \param [in, out] src The source pointer.
+	/// \param end The source end.
+	/// \param [in, out] dst The destination pointer.
+	/// \param dst_end The destination end.
+	/// \returns `false` if the source contains an octet that is not defined in the code page.
+	///   \p src points to the octet.
+	bool to_wide (const char*& src, const char* end, wchar_t*& dst, wchar_t* dst_end) const noexcept;
+
+	/// Convert wide characters to narrow.
+	/// Conversion stops at the end of the source or if there is no room in the destination.
+	/// 
+	/// \param [in, out] src The source pointer.
+	/// \param end The source end.
+	/// \param [in, out] dst The destination pointer.
+	/// \param dst_end The destination end.
+	/// \returns `false` if the source contains a character that can not be represented in the
+	///   code page. \p src points to the character.
+	bool to_narrow (const wchar_t*& src, const wchar_t* end, char*& dst, char* dst_end) const noexcept;
+
+	/// \returns Character category flags.
+	Nirvana::CodePage::CharCategory category (uint8_t c) const noexcept
+	{
+		return category_ [c];
+	}
+
+	/// \returns Uppercase character.
+	uint8_t to_upper (uint8_t c) const noexcept
+	{
+		return upper_ [c];
+	}
+
+	/// \returns Lowercase character.
+	uint8_t to_lower (uint8_t c) const noexcept
+	{
+		return lower_ [c];
+	}
+
+private:
+	// Marks the octets that are not defined in the code page
+	static const uint32_t NO_WIDE = 0xFFFFFFFF;
+
+	Nirvana::CodePage::_ref_type code_page_ref_;
+	Nirvana::CodePage* code_page_;
+
+	// Narrow to wide
+	uint32_t wide_ [256];
+
+	Nirvana::CodePage::CharCategory category_ [256];
+	uint8_t upper_ [256];
+	uint8_t lower_ [256];
+
+	// BMP character to narrow. Zero means no mapping for all characters except the null.
+	uint8_t narrow_ [0x10000];
+};
+
+}
+
+#endif
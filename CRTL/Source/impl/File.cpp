@@ -44,9 +44,25 @@ File* File::cast (FILE* stream) noexcept
 
 FileDyn* File::cast_no_std (FILE* stream) noexcept
 {
-	if (!stream)
+	if (!stream) {
 		errno = EINVAL;
-	return reinterpret_cast <FileDyn*> (stream);
+		return nullptr;
+	}
+	FileDyn* f = reinterpret_cast <FileDyn*> (stream);
+	if (!Global::is_own_stream (*f)) {
+		errno = EBADF;
+		return nullptr;
+	}
+	return f;
+}
+
+File* File::cast_locked (FILE* stream) noexcept
+{
+	int i = is_std_stream (stream);
+	if (i)
+		return Global::get_std_stream (i);
+	else
+		return reinterpret_cast <FileDyn*> (stream);
 }
 
 int File::parse_modestring (const char* mode) noexcept
@@ -95,23 +111,14 @@ int File::parse_modestring (const char* mode) noexcept
 	return flags;
 }
 
-File::File (int fd, bool external_descriptor) noexcept :
+File::File (int fd, bool external_descriptor, DirtyFiles& dirty_list) noexcept :
 	buffer_ptr_ (nullptr),
-	buffer_size_ (DEFAULT_BUFFER_SIZE),
-	offset_ (0),
-	io_offset_ (0),
-	valid_limit_ (0),
-	dirty_begin_ (0),
-	dirty_end_ (0),
 	unget_ptr_ (nullptr),
-	io_mode_ (0),
-	status_bits_ (0),
-	type_ (StreamType::unknown),
-	bufmode_ (BufferMode::unknown),
-	fd_ (fd),
 	external_buffer_ (false),
-	external_descriptor_ (external_descriptor)
-{}
+	dirty_list_ (dirty_list)
+{
+	attach (fd, external_descriptor);
+}
 
 File::~File ()
 {
@@ -119,9 +126,73 @@ File::~File ()
 	deallocate_buffer ();
 }
 
+void File::attach (int fd, bool external_descriptor) noexcept
+{
+	assert (!buffer_ptr_);
+	buffer_size_ = DEFAULT_BUFFER_SIZE;
+	offset_ = 0;
+	io_offset_ = 0;
+	valid_limit_ = 0;
+	dirty_begin_ = 0;
+	dirty_end_ = 0;
+	io_mode_ = 0;
+	status_bits_ = 0;
+	type_ = StreamType::unknown;
+	bufmode_ = BufferMode::unknown;
+	fd_ = fd;
+	external_descriptor_ = external_descriptor;
+}
+
+void File::detach () noexcept
+{
+	purge ();
+	deallocate_buffer ();
+	buffer_ptr_ = nullptr;
+	unget_ptr_ = nullptr;
+	external_buffer_ = false;
+}
+
+bool File::probe () noexcept
+{
+	mode_t mode = 0;
+	if (CRTL::fstat_mode (fd_, mode) || !mode)
+		return false;
+	set_mode (mode);
+	return true;
+}
+
+void File::set_mode (mode_t mode) noexcept
+{
+	StreamType type;
+	BufferMode bufmode;
+	switch (mode & S_IFMT) {
+		case S_IFREG:
+		case S_IFBLK:
+			type = StreamType::file_like;
+			bufmode = BufferMode::full_buffer;
+			break;
+
+		case S_IFCHR:
+			// Not every character device is a terminal, init_bufmode () calls isatty () lazily.
+			type = StreamType::pipe_like;
+			bufmode = BufferMode::unknown;
+			break;
+
+		default:
+			type = StreamType::pipe_like;
+			bufmode = BufferMode::full_buffer;
+	}
+
+	if (type_ == StreamType::unknown)
+		type_ = type;
+	// Do not override setvbuf ()
+	if (bufmode_ == BufferMode::unknown)
+		bufmode_ = bufmode;
+}
+
 int File::init_type () noexcept
 {
-	if (type_ != StreamType::unknown)
+	if (type_ != StreamType::unknown || probe ())
 		return 0;
 
 	fpos_t offset;
@@ -145,6 +216,9 @@ int File::init_bufmode () noexcept
 	if (bufmode_ != BufferMode::unknown)
 		return 0;
 
+	if (type_ == StreamType::unknown && probe () && bufmode_ != BufferMode::unknown)
+		return 0;
+
 	bool atty;
 	int e = CRTL::isatty (fd_, atty);
 	if (e)
@@ -185,6 +259,7 @@ int File::write_back () noexcept
 			return e;
 		}
 		io_offset_ = dirty_begin_ = dirty_end_;
+		set_clean ();
 	}
 
 	return 0;
@@ -274,47 +349,123 @@ int File::read (char* buffer, size_t max_size, size_t& actual_size) noexcept
 		return 0;
 	}
 
+	if ((e = fill ()))
+		return e;
+	if (offset_ == valid_limit_) {
+		actual_size = unget_length;
+		return 0;
+	}
+
+	// Return data from the buffer.
+	assert (offset_ < valid_limit_);
+
+	auto chunk = std::min (size_t (valid_limit_ - offset_), max_size);
+	memcpy (buffer, buffer_ptr_ + offset_, chunk);
+	offset_ += chunk;
+
+	actual_size = chunk + unget_length;
+	return 0;
+}
+
+int File::fill () noexcept
+{
 	// Ensure correct buffer type for pipe-like streams.
 	// TODO: In order to support pipe-like streams we need to write-back the buffer.
 	assert (!(io_mode_ && valid_limit_));
 	io_mode_ = 0;
 
+	if (offset_ != valid_limit_)
+		return 0;
+
 	// Clear the buffer, then buffer new data.
-	if (offset_ == valid_limit_) {
-		// TODO: We only have to write-back/reset if __valid_limit reaches the buffer end.
-		int e = write_back ();
-		if (e)
-			return e;
-		if ((e = reset ()))
-			return e;
+	// TODO: We only have to write-back/reset if __valid_limit reaches the buffer end.
+	int e = write_back ();
+	if (e)
+		return e;
+	if ((e = reset ()))
+		return e;
 
-		// Perform a read-ahead.
-		if ((e = ensure_allocation ()))
-			return e;
+	// Perform a read-ahead.
+	if ((e = ensure_allocation ()))
+		return e;
 
-		size_t io_size;
-		if ((e = io_read (buffer_ptr_, buffer_size_, io_size))) {
-			status_bits_ |= ERROR_BIT;
-			return e;
-		}
-		if (!io_size) {
-			status_bits_ |= EOF_BIT;
-			actual_size = 0;
+	size_t io_size;
+	if ((e = io_read (buffer_ptr_, buffer_size_, io_size))) {
+		status_bits_ |= ERROR_BIT;
+		return e;
+	}
+	if (!io_size)
+		status_bits_ |= EOF_BIT;
+
+	io_offset_ = io_size;
+	valid_limit_ = io_size;
+	return 0;
+}
+
+int File::read_until (int delim, char* buffer, size_t max_size, size_t& actual_size) noexcept
+{
+	assert (max_size);
+
+	actual_size = 0;
+	const char c = (char)delim;
+
+	if (unget_ptr_ != buffer_ptr_) {
+		size_t cb = std::min (max_size, (size_t)(buffer_ptr_ - unget_ptr_));
+		const char* found = (const char*)memchr (unget_ptr_, c, cb);
+		if (found)
+			cb = found + 1 - unget_ptr_;
+		memcpy (buffer, unget_ptr_, cb);
+		unget_ptr_ += cb;
+		actual_size = cb;
+		if (found || cb == max_size)
 			return 0;
-		}
+		buffer += cb;
+		max_size -= cb;
+	}
 
-		io_offset_ = io_size;
-		valid_limit_ = io_size;
+	int e = init_bufmode ();
+	if (e)
+		return e;
+
+	if (bufmode_ == BufferMode::no_buffer) {
+		// We must not read beyond the delimiter.
+		do {
+			size_t io_size;
+			if ((e = io_read (buffer, 1, io_size))) {
+				status_bits_ |= ERROR_BIT;
+				return e;
+			}
+			if (!io_size) {
+				status_bits_ |= EOF_BIT;
+				break;
+			}
+			++actual_size;
+			--max_size;
+		} while (*(buffer++) != c && max_size);
+		return 0;
 	}
 
-	// Return data from the buffer.
-	assert (offset_ < valid_limit_);
+	for (;;) {
+		if ((e = fill ()))
+			return e;
+		if (offset_ == valid_limit_)
+			break;
 
-	auto chunk = std::min (size_t (valid_limit_ - offset_), max_size);
-	memcpy (buffer, buffer_ptr_ + offset_, chunk);
-	offset_ += chunk;
+		// Copy the whole run up to the delimiter at once.
+		const char* begin = buffer_ptr_ + offset_;
+		size_t cb = std::min (valid_limit_ - offset_, max_size);
+		const char* found = (const char*)memchr (begin, c, cb);
+		if (found)
+			cb = found + 1 - begin;
+		memcpy (buffer, begin, cb);
+		offset_ += cb;
+		actual_size += cb;
+		if (found || cb == max_size)
+			break;
+		buffer += cb;
+		max_size -= cb;
+	}
 
-	actual_size = chunk + unget_length;
 	return 0;
 }
 
@@ -379,6 +530,7 @@ int File::write (const char* buffer, size_t size) noexcept
 		} else {
 			dirty_begin_ = offset_;
 			dirty_end_ = offset_ + chunk;
+			set_dirty ();
 		}
 		valid_limit_ = std::max (offset_ + chunk, valid_limit_);
 		offset_ += chunk;
@@ -458,6 +610,7 @@ void File::purge () noexcept
 	valid_limit_ = 0;
 	dirty_end_ = dirty_begin_;
 	unget_ptr_ = buffer_ptr_;
+	set_clean ();
 }
 
 int File::tell (fpos_t& current_offset) noexcept
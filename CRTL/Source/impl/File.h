@@ -36,11 +36,15 @@
 
 namespace CRTL {
 
+class File;
 class FileDyn;
 
+/// Intrusive list of the streams which have pending writes.
+using DirtyFiles = Nirvana::SimpleList <File, 1>;
+
 /// @brief Stream I/O FILE implementation.
 /// Based on mlibc abstract_file class.
-class File
+class File : public DirtyFiles::Element
 {
 	// Use quite small buffer size at this level.
 	// The main buffering implemented in AccessBuf
@@ -53,8 +57,22 @@ class File
 	static const int ERROR_BIT = 2;
 
 public:
+	/// Obtain the stream object.
+	/// The streams belong to the execution context which opened them and can not be used
+	/// from the other one. Such streams are rejected with EBADF.
+	/// 
+	/// \param stream The stream.
+	/// \returns The stream object or `nullptr` with errno set.
 	static File* cast (FILE* stream) noexcept;
+
+	/// \copydoc cast(FILE*)
+	/// The standard streams are not accepted.
 	static FileDyn* cast_no_std (FILE* stream) noexcept;
+
+	/// Obtain the stream object without the validation.
+	/// Used by the *_unlocked functions: the caller has already validated the stream
+	/// with flockfile ().
+	static File* cast_locked (FILE* stream) noexcept;
 	
 	static int is_std_stream (FILE* stream) noexcept
 	{
@@ -74,9 +92,23 @@ public:
 		return CRTL::open (path, oflags, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH, fd);
 	}
 
-	File (int fd, bool external_descriptor) noexcept;
+	File (int fd, bool external_descriptor, DirtyFiles& dirty_list) noexcept;
 	~File ();
 
+	/// Bind the detached object to a new file descriptor.
+	void attach (int fd, bool external_descriptor) noexcept;
+
+	/// Drop the buffer and all unwritten data.
+	/// The descriptor must be closed before.
+	void detach () noexcept;
+
+	/// Obtain the stream type and the default buffering mode from a single fstat() call.
+	/// If it fails, the stream falls back to the lazy probing on the first I/O.
+	/// The buffering mode of a character device is left for the lazy isatty () check.
+	/// 
+	/// \returns `true` on success.
+	bool probe () noexcept;
+
   File (const File &) = delete;
   File &operator = (const File&) = delete;
 
@@ -102,6 +134,7 @@ public:
 			type_ = StreamType::unknown;
 			bufmode_ = BufferMode::unknown;
 			status_bits_ = 0;
+			probe ();
 		} else {
 			int ret;
 			int e = CRTL::fcntl (fd_, F_SETFL, mode_flags & (O_APPEND | O_TEXT | O_ACCMODE), ret);
@@ -130,8 +163,55 @@ public:
 	}
 
 	int read (char* buffer, size_t max_size, size_t& actual_size) noexcept;
+
+	/// Read bytes up to and including the delimiter.
+	/// Stops when the delimiter is stored, \p max_size bytes are read or at the end of file.
+	int read_until (int delim, char* buffer, size_t max_size, size_t& actual_size) noexcept;
+
 	int write (const char* buffer, size_t size) noexcept;
 	int unget (int c) noexcept;
+
+	/// Get one byte.
+	/// The buffered data is accessed directly, I/O is performed only on the buffer boundary.
+	/// 
+	/// \param [out] c The byte read as `unsigned char` or EOF at the end of file.
+	/// \returns Error code.
+	int getc (int& c) noexcept
+	{
+		if (unget_ptr_ != buffer_ptr_) {
+			c = (unsigned char)*(unget_ptr_++);
+			return 0;
+		}
+		if (!io_mode_ && offset_ < valid_limit_) {
+			c = (unsigned char)buffer_ptr_ [offset_++];
+			return 0;
+		}
+		char b;
+		size_t cb;
+		int e = read (&b, 1, cb);
+		if (!e)
+			c = cb ? (unsigned char)b : EOF;
+		return e;
+	}
+
+	/// Put one byte.
+	/// If the byte fits into the buffer, it is appended to the dirty region directly.
+	/// 
+	/// \param c The byte to write.
+	/// \returns Error code.
+	int putc (char c) noexcept
+	{
+		if (io_mode_ && dirty_begin_ != dirty_end_ && dirty_end_ == offset_ && offset_ < buffer_size_
+			&& (bufmode_ == BufferMode::full_buffer || (bufmode_ == BufferMode::line_buffer && c != '\n'))
+		) {
+			buffer_ptr_ [offset_++] = c;
+			dirty_end_ = offset_;
+			if (valid_limit_ < offset_)
+				valid_limit_ = offset_;
+			return 0;
+		}
+		return write (&c, 1);
+	}
 	int tell (fpos_t& current_offset) noexcept;
 	int seek (off_t offset, int whence) noexcept;
 	int flush () noexcept;
@@ -165,6 +245,11 @@ public:
 		return status_bits_ & ERROR_BIT;
 	}
 
+	bool dirty () const noexcept
+	{
+		return dirty_begin_ != dirty_end_;
+	}
+
 	bool eof () const noexcept
 	{
 		return status_bits_ & EOF_BIT;
@@ -175,6 +260,12 @@ public:
 		status_bits_ = 0;
 	}
 
+	/// \returns `true` if the stream was opened with the \p dirty_list of the runtime data.
+	bool owned_by (const DirtyFiles& dirty_list) const noexcept
+	{
+		return &dirty_list_ == &dirty_list;
+	}
+
 private:
 	enum class StreamType {
 		unknown,
@@ -189,15 +280,28 @@ private:
 		full_buffer = _IOFBF
 	};
 
+	void set_mode (mode_t mode) noexcept;
 	int init_type () noexcept;
 	int init_bufmode () noexcept;
 	int write_back () noexcept;
+	int fill () noexcept;
 	int reset () noexcept;
 	int ensure_allocation () noexcept;
 	void deallocate_buffer () noexcept;
 	int save_pos () noexcept;
 	void purge () noexcept;
 
+	void set_dirty () noexcept
+	{
+		if (!DirtyFiles::Element::listed ())
+			dirty_list_.push_back (*this);
+	}
+
+	void set_clean () noexcept
+	{
+		DirtyFiles::Element::remove ();
+	}
+
   int io_read (char *buffer, size_t max_size, size_t& actual_size) const noexcept
 	{
 		return CRTL::read (fd_, buffer, max_size, reinterpret_cast <ssize_t&> (actual_size));
@@ -256,6 +360,9 @@ private:
 
 	bool external_buffer_;
 	bool external_descriptor_;
+
+	// List to register the stream in when it becomes dirty.
+	DirtyFiles& dirty_list_;
 };
 
 class FileDyn :
@@ -264,8 +371,8 @@ class FileDyn :
 	public Nirvana::ObjectMemory
 {
 public:
-	FileDyn (int fd, Nirvana::SimpleList <FileDyn>& list) noexcept :
-		File (fd, false)
+	FileDyn (int fd, Nirvana::SimpleList <FileDyn>& list, DirtyFiles& dirty_list) noexcept :
+		File (fd, false, dirty_list)
 	{
 		list.push_back (*this);
 	}
@@ -31,8 +31,16 @@
 #include <Nirvana/Nirvana.h>
 #include <Nirvana/Module.h>
 #include <Nirvana/mbstate.h>
+#include <Nirvana/Numpunct.h>
+#include <Nirvana/Parser.h>
+#include <Nirvana/nls.h>
+#include <memory>
+#include <string.h>
+#include "CodePageTable.h"
 #include "File.h"
+#include "locale.h"
 #include "RandomGen.h"
+#include "TimeFormat.h"
 
 namespace CRTL {
 
@@ -61,6 +69,20 @@ public:
 		}
 	}
 
+	/// Streams are kept in the context-specific runtime data, so the stream opened
+	/// in the other execution context is not accessible.
+	/// 
+	/// \param f The stream.
+	/// \returns `true` if \p f belongs to the current execution context.
+	static bool is_own_stream (const File& f) noexcept
+	{
+		try {
+			return f.owned_by (runtime_data ().dirty_streams ());
+		} catch (...) {
+			return false;
+		}
+	}
+
 	static FILE* fopen (const char* file, const char* mode) noexcept
 	{
 		try {
@@ -71,6 +93,27 @@ public:
 		}
 	}
 
+	static FILE* fdopen (int fd, const char* mode) noexcept
+	{
+		try {
+			return runtime_data ().fdopen (fd, mode);
+		} catch (...) {
+			errno = ENOMEM;
+			return nullptr;
+		}
+	}
+
+	static int fclose (FileDyn* f) noexcept
+	{
+		int e = f->close ();
+		try {
+			runtime_data ().release_stream (*f);
+		} catch (...) {
+			delete f;
+		}
+		return e;
+	}
+
 	static int flush_all () noexcept
 	{
 		try {
@@ -110,6 +153,64 @@ public:
 
 	static int get_mb_state (__Mbstate*& ps, Mbstate i) noexcept;
 
+	/// Numeric punctuation of the locale.
+	/// It is obtained from the locale on first use and cached until the other locale is requested.
+	/// 
+	/// \param loc The locale.
+	/// \returns The numeric punctuation.
+	static const Nirvana::Numpunct& numpunct (Nirvana::Locale::_ptr_type loc)
+	{
+		return runtime_data ().numpunct (loc);
+	}
+
+	/// Translation tables for the mbs/wcs conversion functions.
+	/// One code page per execution context is kept; a call with a different code page
+	/// rebuilds the tables in place instead of allocating new ones.
+	/// 
+	/// \param cp The code page.
+	/// \returns The translation tables.
+	static const CodePageTable& code_page_table (Nirvana::CodePage::_ptr_type cp)
+	{
+		return runtime_data ().code_page_table (cp);
+	}
+
+	/// Classification tables of the locale.
+	/// The tables are kept apart from code_page_table (), so the character conversion
+	/// in the other code page does not force to rebuild them.
+	/// 
+	/// \param locobj The locale object.
+	/// \returns The code page tables or `nullptr` for the UTF-8 locale or if \p locobj is invalid.
+	static const CodePageTable* ctype_table (locale_t locobj) noexcept
+	{
+		try {
+			return runtime_data ().ctype_table (locobj);
+		} catch (...) {
+			return nullptr;
+		}
+	}
+
+	/// Compiled strftime () format.
+	/// The last used format is cached, so repeated calls with the same format do not parse it again.
+	/// 
+	/// \param format The format string.
+	/// \param loc The date/time locale.
+	/// \returns The compiled format.
+	static const TimeFormat& time_format (const char* format, const Nirvana::DateTimeLocale& loc)
+	{
+		return runtime_data ().time_format (format, loc);
+	}
+
+	/// Compiled scanf () format.
+	/// Programs usually scan the input in a loop with one format string, so only the last
+	/// compiled format is kept and it is found by the string contents.
+	/// 
+	/// \param format The format string.
+	/// \returns The compiled format.
+	static const Nirvana::Parser::Compiled& scan_format (const char* format)
+	{
+		return runtime_data ().scan_format (format);
+	}
+
   static IDL::String* temporary_string () noexcept
   {
 		try {
@@ -125,14 +226,26 @@ private:
 	{
 	public:
 		RuntimeData () noexcept :
-			std_streams_ { {0, true}, {1, true}, {2, true} },
-			mb_states_ { 0 }
+			std_streams_ { {0, true, dirty_streams_}, {1, true, dirty_streams_}, {2, true, dirty_streams_} },
+			free_stream_cnt_ (0),
+			mb_states_ { 0 },
+			numpunct_locale_ (nullptr),
+			ctype_locobj_ (nullptr),
+			ctype_locale_ (nullptr)
 		{}
 
 		~RuntimeData ()
 		{
+			flush_all ();
 			while (!streams_.empty ())
 				delete &streams_.front ();
+			while (!free_streams_.empty ())
+				delete &free_streams_.front ();
+		}
+
+		const DirtyFiles& dirty_streams () const noexcept
+		{
+			return dirty_streams_;
 		}
 
 		File* get_std_stream (int fd) noexcept
@@ -148,46 +261,196 @@ private:
 			if (e)
 				errno = e;
 			else {
+				FileDyn* f;
 				try {
-					return File::cast (new FileDyn (fd, streams_));
+					f = create_stream (fd);
 				} catch (...) {
 					CRTL::close (fd);
 					throw;
 				}
+				f->probe ();
+				return File::cast (f);
 			}
 			return nullptr;
 		}
 
-		int flush_all ()
+		FILE* fdopen (int fd, const char* mode)
 		{
+			if (!mode || !*mode || !strchr ("rwa", *mode) || mode [strspn (mode + 1, "+btx") + 1]) {
+				errno = EINVAL;
+				return nullptr;
+			}
+			int mode_flags = File::parse_modestring (mode);
+
+			int fd_flags;
+			int e = CRTL::fcntl (fd, F_GETFL, 0, fd_flags);
+			if (e) {
+				errno = e;
+				return nullptr;
+			}
+
+			// The requested access must be allowed by the descriptor.
+			int acc = mode_flags & O_ACCMODE, fd_acc = fd_flags & O_ACCMODE;
+			if (acc != fd_acc && fd_acc != O_RDWR) {
+				errno = EINVAL;
+				return nullptr;
+			}
+
+			if ((mode_flags & O_APPEND) && !(fd_flags & O_APPEND)) {
+				int ret;
+				e = CRTL::fcntl (fd, F_SETFL, (fd_flags | O_APPEND) & (O_APPEND | O_TEXT | O_ACCMODE), ret);
+				if (e) {
+					errno = e;
+					return nullptr;
+				}
+			}
+
+			FileDyn* f = create_stream (fd);
+			f->probe ();
+			return File::cast (f);
+		}
+
+		// Only the streams with pending writes are listed in dirty_streams_,
+		// so the cost does not depend on the number of open streams.
+		int flush_all () noexcept
+		{
+			DirtyFiles pending;
+			pending.transfer (dirty_streams_);
 			int e = 0;
-			for (auto& f : streams_) {
+			while (!pending.empty ()) {
+				File& f = pending.front ();
 				int e1 = f.flush ();
 				if (!e)
 					e = e1;
-			}
-			for (int i = 1; i < 3; ++i) {
-				int e1 = std_streams_ [i].flush ();
-				if (!e)
-					e = e1;
+				// On successful write-back the stream removes itself from the list.
+				// Otherwise keep it for the next attempt.
+				if (f.dirty ())
+					dirty_streams_.push_back (f);
 			}
 			return e;
 		}
 
+		void release_stream (FileDyn& f) noexcept
+		{
+			f.detach ();
+			if (free_stream_cnt_ < STREAM_POOL_MAX) {
+				free_streams_.push_back (f);
+				++free_stream_cnt_;
+			} else
+				delete &f;
+		}
+
 		__Mbstate* get_mb_state (Mbstate i)
 		{
 			return mb_states_ + i;
 		}
 
+		const Nirvana::Numpunct& numpunct (Nirvana::Locale::_ptr_type loc)
+		{
+			// The reference keeps the cached locale alive, so the pointer can not be reused.
+			if (numpunct_locale_ != &loc) {
+				numpunct_ = Nirvana::Numpunct (loc->localeconv ());
+				numpunct_locale_ref_ = loc;
+				numpunct_locale_ = &loc;
+			}
+			return numpunct_;
+		}
+
+		const CodePageTable& code_page_table (Nirvana::CodePage::_ptr_type cp)
+		{
+			return get_table (code_page_table_, cp);
+		}
+
+		const CodePageTable* ctype_table (locale_t locobj)
+		{
+			// The global locale may be changed by setlocale (), so it is obtained on every call.
+			// The reference keeps the cached locale alive, so the pointer can not be reused.
+			if (LC_GLOBAL_LOCALE == locobj || ctype_locobj_ != locobj) {
+				Nirvana::Locale::_ptr_type loc = check_locale (locobj);
+				if (!loc)
+					return nullptr;
+				if (ctype_locale_ != &loc) {
+					ctype_code_page_ = Nirvana::CodePage::_downcast (loc->get_facet (LC_CTYPE));
+					ctype_locale_ref_ = loc;
+					ctype_locale_ = &loc;
+				}
+				ctype_locobj_ = locobj;
+			}
+			if (!ctype_code_page_)
+				return nullptr;
+			// The classification uses own tables, so the conversion in the other code page
+			// does not rebuild them on each call.
+			return &get_table (ctype_table_, ctype_code_page_);
+		}
+
+		const TimeFormat& time_format (const char* format, const Nirvana::DateTimeLocale& loc)
+		{
+			if (!time_format_.is_same (format, loc))
+				time_format_.compile (format, loc);
+			return time_format_;
+		}
+
+		const Nirvana::Parser::Compiled& scan_format (const char* format)
+		{
+			if (scan_format_source_ != format) {
+				Nirvana::Parser::Compiled compiled (format);
+				scan_format_source_ = format;
+				scan_format_ = std::move (compiled);
+			}
+			return scan_format_;
+		}
+
     IDL::String& temporary_string () noexcept
     {
       return temporary_string_;
     }
 
 	private:
+		FileDyn* create_stream (int fd)
+		{
+			if (free_streams_.empty ())
+				return new FileDyn (fd, streams_, dirty_streams_);
+
+			FileDyn& f = free_streams_.front ();
+			--free_stream_cnt_;
+			f.attach (fd, false);
+			streams_.push_back (f);
+			return &f;
+		}
+
+		static const CodePageTable& get_table (std::unique_ptr <CodePageTable>& table,
+			Nirvana::CodePage::_ptr_type cp)
+		{
+			// The tables are large, so they are allocated only if a code page is used.
+			if (!table)
+				table.reset (new CodePageTable);
+			if (!table->is_same (cp))
+				table->build (cp);
+			return *table;
+		}
+
+	private:
+		// Maximal number of the closed FileDyn objects kept for reuse.
+		static const size_t STREAM_POOL_MAX = 64;
+
+		DirtyFiles dirty_streams_;
 		File std_streams_ [3];
 		Nirvana::SimpleList <FileDyn> streams_;
+		Nirvana::SimpleList <FileDyn> free_streams_;
+		size_t free_stream_cnt_;
 		__Mbstate mb_states_ [MBS_CNT];
+		Nirvana::Locale::_ref_type numpunct_locale_ref_;
+		Nirvana::Locale* numpunct_locale_;
+		Nirvana::Numpunct numpunct_;
+		std::unique_ptr <CodePageTable> code_page_table_;
+		locale_t ctype_locobj_;
+		Nirvana::Locale::_ref_type ctype_locale_ref_;
+		Nirvana::Locale* ctype_locale_;
+		Nirvana::CodePage::_ref_type ctype_code_page_;
+		std::unique_ptr <CodePageTable> ctype_table_;
+		TimeFormat time_format_;
+		Nirvana::Parser::Compiled scan_format_;
+		std::string scan_format_source_;
     IDL::String temporary_string_;    
 	};
 
@@ -0,0 +1,172 @@
+/*
+* Nirvana C runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef CRTL_IMPL_TIMEFORMAT_H_
+#define CRTL_IMPL_TIMEFORMAT_H_
+#pragma once
+
+#include <Nirvana/WideIn.h>
+#include <Nirvana/WideOut.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct tm;
+
+namespace Nirvana {
+
+/// Name string of the date/time locale with the precomputed length.
+struct DateTimeName
+{
+	template <size_t N>
+	constexpr DateTimeName (const char (&s) [N]) noexcept :
+		str (s),
+		len (N - 1),
+		ascii (is_ascii (s, N - 1))
+	{}
+
+	const char* str;
+	size_t len;
+
+	/// `true` if all characters are ASCII, so the name may be output by WideOut::put_ascii ().
+	bool ascii;
+
+private:
+	static constexpr bool is_ascii (const char* s, size_t len) noexcept
+	{
+		for (; len; ++s, --len) {
+			if ((unsigned char)*s >= 0x80)
+				return false;
+		}
+		return true;
+	}
+};
+
+struct DateTimeLocale
+{
+	DateTimeName month [12];
+	DateTimeName abmonth [12];
+	DateTimeName day [7];
+	DateTimeName abday [7];
+	DateTimeName am;
+	DateTimeName pm;
+	const char* date_format;
+	const char* time_format;
+	const char* time_format_ampm;
+	const char* date_time_format;
+};
+
+}
+
+namespace CRTL {
+
+/// Compiled strftime () format.
+/// 
+/// The format string is parsed once into the sequence of fields and literal runs.
+/// The locale formats (%c, %x, %X, %r) and the composite fields (%D, %F, %R, %T)
+/// are expanded on compilation, so the output does not require any parsing.
+class TimeFormat
+{
+public:
+	TimeFormat () noexcept :
+		loc_ (nullptr)
+	{}
+
+	/// Compile format.
+	/// 
+	/// \param format The format string.
+	/// \param loc The date/time locale.
+	void compile (Nirvana::WideIn& format, const Nirvana::DateTimeLocale& loc);
+
+	/// Compile UTF-8 format and remember it for is_same ().
+	/// 
+	/// \param format The format string.
+	/// \param loc The date/time locale.
+	void compile (const char* format, const Nirvana::DateTimeLocale& loc);
+
+	/// \returns `true` if this object is compiled from the same UTF-8 format and locale.
+	bool is_same (const char* format, const Nirvana::DateTimeLocale& loc) const noexcept
+	{
+		return loc_ == &loc && source_ == format;
+	}
+
+	/// Output formatted time.
+	/// 
+	/// \param tm The time.
+	/// \param out The output stream.
+	void format (const struct tm& tm, Nirvana::WideOut& out) const;
+
+private:
+	enum Field : uint8_t
+	{
+		LITERAL,    // ASCII literal run, the value is the length in text_
+		LITERAL_WC, // Non-ASCII literal character, the value is the code point
+		YEAR,       // %Y
+		CENTURY,    // %C
+		YEAR2,      // %y
+		MONTH,      // %m
+		DAY,        // %d
+		DAY_SP,     // %e
+		YDAY,       // %j
+		HOUR,       // %H
+		HOUR_SP,    // %k
+		HOUR12,     // %I
+		HOUR12_SP,  // %l
+		MINUTE,     // %M
+		SECOND,     // %S
+		TZ_OFFSET,  // %z
+		TZ_NAME,    // %Z
+		ABDAY,      // %a
+		DAY_NAME,   // %A
+		ABMONTH,    // %b, %h
+		MONTH_NAME, // %B
+		AMPM,       // %p
+		AMPM_LOWER  // %P
+	};
+
+	// Maximal nesting of the locale formats, like %c containing %x.
+	static const unsigned MAX_DEPTH = 3;
+
+	struct Item
+	{
+		Field field;
+		uint32_t value;
+	};
+
+	void compile (Nirvana::WideIn& format, const Nirvana::DateTimeLocale& loc, unsigned depth);
+	void compile (const char* format, const Nirvana::DateTimeLocale& loc, unsigned depth);
+	void add_literal (int32_t c);
+	void add (Field f);
+
+private:
+	std::vector <Item> items_;
+	std::string text_;
+	std::string source_;
+	const Nirvana::DateTimeLocale* loc_;
+};
+
+}
+
+#endif
@@ -27,76 +27,75 @@
 #include <Nirvana/Nirvana.h>
 #include <Nirvana/POSIX.h>
 
+using namespace CORBA::Internal;
+
 namespace CRTL {
 
-int read (int fildes, void* buf, size_t count, ssize_t& readed) noexcept
+// The hot path functions call the POSIX interface EPV directly with the environment.
+// So errors like EAGAIN or EBADF cost a branch instead of the C++ exception unwinding.
+
+static Bridge <Nirvana::POSIX>* posix_bridge () noexcept
 {
-	int err = EIO;
-	try {
-		readed = Nirvana::the_posix->read (fildes, buf, count);
+	return static_cast <Bridge <Nirvana::POSIX>*> (
+		&static_cast <I_ptr <Nirvana::POSIX> > (Nirvana::the_posix));
+}
+
+static int env_errno (const Environment& env) noexcept
+{
+	const CORBA::Exception* ex = env.exception ();
+	if (!ex)
 		return 0;
-	} catch (const CORBA::NO_MEMORY&) {
+
+	int err = EIO;
+	if (CORBA::NO_MEMORY::_downcast (ex))
 		err = ENOMEM;
-	} catch (const CORBA::SystemException& ex) {
-		int e = Nirvana::get_minor_errno (ex.minor ());
-		if (e)
-			err = e;
-	} catch (...) {
+	else {
+		const CORBA::SystemException* sys = CORBA::SystemException::_downcast (ex);
+		if (sys) {
+			int e = Nirvana::get_minor_errno (sys->minor ());
+			if (e)
+				err = e;
+		}
 	}
 	return err;
 }
 
-int write (int fildes, const void* buf, size_t count) noexcept
+int read (int fildes, void* buf, size_t count, ssize_t& readed) noexcept
 {
-	int err = EIO;
-	try {
-		Nirvana::the_posix->write (fildes, buf, count);
-		return 0;
-	} catch (const CORBA::NO_MEMORY&) {
-		err = ENOMEM;
-	} catch (const CORBA::SystemException& ex) {
-		int e = Nirvana::get_minor_errno (ex.minor ());
-		if (e)
-			err = e;
-	} catch (...) {
-	}
+	Bridge <Nirvana::POSIX>* br = posix_bridge ();
+	Environment env;
+	size_t cb = (br->_epv ().epv.read) (br, fildes, buf, count, &env);
+	int err = env_errno (env);
+	if (!err)
+		readed = cb;
 	return err;
 }
 
+int write (int fildes, const void* buf, size_t count) noexcept
+{
+	Bridge <Nirvana::POSIX>* br = posix_bridge ();
+	Environment env;
+	(br->_epv ().epv.write) (br, fildes, buf, count, &env);
+	return env_errno (env);
+}
+
 int lseek (int fildes, off_t offset, int whence, fpos_t& pos) noexcept
 {
-	int err = EIO;
-	try {
-		if (Nirvana::the_posix->seek (fildes, offset, whence, pos))
-			return 0;
-		else
-			err = ESPIPE;
-	} catch (const CORBA::NO_MEMORY&) {
-		err = ENOMEM;
-	} catch (const CORBA::SystemException& ex) {
-		int e = Nirvana::get_minor_errno (ex.minor ());
-		if (e)
-			err = e;
-	} catch (...) {
-	}
+	Bridge <Nirvana::POSIX>* br = posix_bridge ();
+	Environment env;
+	bool ok = (br->_epv ().epv.seek) (br, fildes, offset, whence, &pos, &env);
+	int err = env_errno (env);
+	if (!err && !ok)
+		err = ESPIPE;
 	return err;
 }
 
 int close (int fildes) noexcept
 {
-	int err = EIO;
-	try {
-		Nirvana::the_posix->close (fildes);
-		return 0;
-	} catch (const CORBA::NO_MEMORY&) {
-		err = ENOMEM;
-	} catch (const CORBA::SystemException& ex) {
-		int e = Nirvana::get_minor_errno (ex.minor ());
-		if (e)
-			err = e;
-	} catch (...) {
-	}
-	return err;
+	Bridge <Nirvana::POSIX>* br = posix_bridge ();
+	Environment env;
+	(br->_epv ().epv.close) (br, fildes, &env);
+	return env_errno (env);
 }
 
 int open (const char* path, int oflag, mode_t mode, int& fildes) noexcept
@@ -118,35 +117,36 @@ int open (const char* path, int oflag, mode_t mode, int& fildes) noexcept
 
 int isatty (int fildes, bool& atty) noexcept
 {
-	int err = EIO;
-	try {
-		atty = Nirvana::the_posix->isatty (fildes);
-		return 0;
-	} catch (const CORBA::NO_MEMORY&) {
-		err = ENOMEM;
-	} catch (const CORBA::SystemException& ex) {
-		int e = Nirvana::get_minor_errno (ex.minor ());
-		if (e)
-			err = e;
-	} catch (...) {
-	}
+	Bridge <Nirvana::POSIX>* br = posix_bridge ();
+	Environment env;
+	bool ret = (br->_epv ().epv.isatty) (br, fildes, &env);
+	int err = env_errno (env);
+	if (!err)
+		atty = ret;
 	return err;
 }
 
 int fcntl (int fildes, int cmd, uintptr_t param, int& ret) noexcept
 {
-	int err = EIO;
-	try {
-		ret = Nirvana::the_posix->fcntl (fildes, cmd, param);
-		return 0;
-	} catch (const CORBA::NO_MEMORY&) {
-		err = ENOMEM;
-	} catch (const CORBA::SystemException& ex) {
-		int e = Nirvana::get_minor_errno (ex.minor ());
-		if (e)
-			err = e;
-	} catch (...) {
-	}
+	Bridge <Nirvana::POSIX>* br = posix_bridge ();
+	Environment env;
+	int fd = (br->_epv ().epv.fcntl) (br, fildes, cmd, param, &env);
+	int err = env_errno (env);
+	if (!err)
+		ret = fd;
+	return err;
+}
+
+int fstat_mode (int fildes, mode_t& mode) noexcept
+{
+	Bridge <Nirvana::POSIX>* br = posix_bridge ();
+	Environment env;
+	Nirvana::FileStat st;
+	Type <Nirvana::FileStat>::C_out out (st);
+	(br->_epv ().epv.fstat) (br, fildes, &out, &env);
+	int err = env_errno (env);
+	if (!err)
+		mode = st.mode ();
 	return err;
 }
 
@@ -39,6 +39,7 @@ int close (int fildes) noexcept;
 int open (const char* path, int oflag, mode_t mode, int& fildes) noexcept;
 int isatty (int fildes, bool& atty) noexcept;
 int fcntl (int fildes, int cmd, uintptr_t param, int& ret) noexcept;
+int fstat_mode (int fildes, mode_t& mode) noexcept;
 
 }
 
@@ -25,11 +25,35 @@
 */
 #include "mbcs.h"
 #include <errno.h>
+#include <string.h>
+#include <wchar.h>
+#include <algorithm>
 #include <Nirvana/utf8.h>
 #include "Global.h"
 
 namespace CRTL {
 
+namespace {
+
+// Characters converted per step
+const size_t CHUNK_SIZE = 256;
+
+// Maximal UTF-8 sequence length
+const size_t UTF8_MAX = 4;
+
+inline bool is_high_surrogate (wchar_t wc) noexcept
+{
+	return sizeof (wchar_t) == 2 && ((unsigned)wc & 0xFC00) == 0xD800;
+}
+
+}
+
+// The conversion state usage:
+//   wcsnrtombs: __wchar holds the high surrogate at the end of the previous source (16-bit wchar_t).
+//   mbsnrtowcs: __octets is the count of the incomplete sequence octets, packed into __wchar.
+//     If __octets is zero, non-zero __wchar is the low surrogate which did not fit into
+//     the destination (16-bit wchar_t).
+
 int wcsnrtombs (char* dst, const wchar_t** src, size_t nwc, size_t len, __Mbstate* ps,
 	Nirvana::CodePage::_ptr_type cp, size_t& count) noexcept
 {
@@ -41,52 +65,85 @@ int wcsnrtombs (char* dst, const wchar_t** src, size_t nwc, size_t len, __Mbstat
 		if (err)
 			return err;
 	}
-		
-  // If no dst pointer, treat len as maximum possible value.
-	if (!dst)
+
+	// If no dst pointer, treat len as maximum possible value
+	// and leave the conversion state intact.
+	__Mbstate tmp_state;
+	if (!dst) {
 		len = std::numeric_limits <size_t>::max ();
+		tmp_state = *ps;
+		ps = &tmp_state;
+	}
 
 	const wchar_t* psrc = *src;
-	const wchar_t* end = psrc + nwc;
 	size_t cnt = 0;
 	int err = 0;
+	bool terminated = false;
+	char buf [CHUNK_SIZE * UTF8_MAX]; // Output for counting
 
 	try {
-		for (;;) {
-
-			while (ps->__octets && cnt < len) {
-				char c = Nirvana::pop_octet (*ps);
-				if (dst)
-					*(dst++) = c;
-				++cnt;
-			}
+		const CodePageTable* table = cp ? &Global::code_page_table (cp) : nullptr;
+		if (ps->__wchar && nwc) {
+			// Complete the surrogate pair
+			wchar_t pair [2] = { (wchar_t)ps->__wchar, *psrc };
+			const wchar_t* pp = pair;
+			char* out = dst ? dst : buf;
+			char* out_end = out + std::min (len, UTF8_MAX);
+			if (!Nirvana::wide_to_utf8 (pp, pair + 2, out, out_end))
+				err = EILSEQ;
+			else if (pp == pair + 2) {
+				cnt = out - (dst ? dst : buf);
+				Nirvana::state_clear (*ps);
+				++psrc;
+				--nwc;
+			} else
+				nwc = 0; // No room
+		}
 
-			if (psrc >= end)
-				break;
+		while (!err && nwc && cnt < len) {
+			size_t max_chunk = std::min (nwc, CHUNK_SIZE);
+			size_t chunk = wcsnlen (psrc, max_chunk);
+			const wchar_t* end = psrc + chunk;
+			const wchar_t* chunk_begin = psrc;
+			char* out_begin = dst ? dst + cnt : buf;
+			char* out = out_begin;
+			char* out_end = out + std::min (len - cnt, sizeof (buf));
+			if (!(table ? table->to_narrow (psrc, end, out, out_end)
+				: Nirvana::wide_to_utf8 (psrc, end, out, out_end)))
+				err = EILSEQ;
+			cnt += out - out_begin;
+			nwc -= psrc - chunk_begin;
 
-			wchar_t wc = *psrc;
-			if (!wc) {
-				if (dst && cnt < len)
-					*dst = 0;
-				Nirvana::state_clear (*ps);
+			if (err)
 				break;
+			if (psrc < end) {
+				if (!table && psrc + 1 == end && nwc == 1 && is_high_surrogate (*psrc)) {
+					// The low surrogate will come with the next call
+					ps->__wchar = (unsigned)*psrc;
+					++psrc;
+					nwc = 0;
+				}
+				break; // No room
 			}
-
-			if (cp) {
-				bool dfl;
-				ps->__wchar = cp->to_narrow (wc, Nirvana::CodePage::NO_DEFAULT, dfl);
-				ps->__octets = 1;
-			} else if (!Nirvana::push_wide (*ps, wc)) {
-				err = EILSEQ;
+			if (chunk < max_chunk) {
+				// The terminating null
+				if (dst && cnt < len)
+					dst [cnt] = 0;
+				if (cnt < len) {
+					terminated = true;
+					Nirvana::state_clear (*ps);
+				}
 				break;
 			}
-			++psrc;
 		}
+	} catch (const std::bad_alloc&) {
+		err = ENOMEM;
 	} catch (...) {
 		err = EILSEQ;
 	}
 	count = cnt;
-	*src = psrc;
+	if (dst)
+		*src = terminated ? nullptr : psrc;
 	return err;
 }
 
@@ -101,56 +158,160 @@ int mbsnrtowcs (wchar_t* dst, const char** src, size_t nms, size_t len, __Mbstat
 		if (err)
 			return err;
 	}
-		
-  // If no dst pointer, treat len as maximum possible value.
-	if (!dst)
+
+	// If no dst pointer, treat len as maximum possible value
+	// and leave the conversion state intact.
+	__Mbstate tmp_state;
+	if (!dst) {
 		len = std::numeric_limits <size_t>::max ();
+		tmp_state = *ps;
+		ps = &tmp_state;
+	}
 
 	const char* psrc = *src;
 	size_t cnt = 0;
 	int err = 0;
+	bool terminated = false;
+	wchar_t buf [CHUNK_SIZE]; // Output for counting
 
-	try {
-		for (;;) {
-			if (!ps->__octets && ps->__wchar && len) {
+	// Store one converted character, the low surrogate is kept in the state if there is no room.
+	auto put = [dst, len, ps, &cnt] (const wchar_t* w, const wchar_t* end) {
+		for (; w < end; ++w) {
+			if (cnt < len) {
 				if (dst)
-					*(dst++) = ps->__wchar;
-				--len;
-				ps->__wchar = 0;
+					dst [cnt] = *w;
+				++cnt;
+			} else {
+				ps->__wchar = (unsigned)*w;
+				ps->__octets = 0;
 			}
+		}
+	};
 
-			if (cnt >= nms)
-				break;
-
-			char c = *psrc;
+	try {
+		const CodePageTable* table = cp ? &Global::code_page_table (cp) : nullptr;
+		if (!ps->__octets && ps->__wchar && cnt < len) {
+			// The low surrogate from the previous call
+			wchar_t wc = (wchar_t)ps->__wchar;
+			Nirvana::state_clear (*ps);
+			put (&wc, &wc + 1);
+		}
 
-			if (!c) {
-				if (ps->__octets)
+		if (ps->__octets && cnt < len) {
+			// Complete the sequence from the previous call
+			char seq [UTF8_MAX];
+			size_t octets = ps->__octets;
+			for (size_t i = 0; i < octets; ++i) {
+				seq [i] = (char)(ps->__wchar >> (i * 8));
+			}
+			for (;;) {
+				if (!nms)
+					break;
+				char c = *psrc;
+				if (!c || octets >= UTF8_MAX) {
 					err = EILSEQ; // Missing octets before the terminator
-				else {
-					if (dst)
-						*dst = 0;
+					break;
+				}
+				seq [octets++] = c;
+				++psrc;
+				--nms;
+				const char* sp = seq;
+				wchar_t w [2];
+				wchar_t* wp = w;
+				if (!Nirvana::utf8_to_wide (sp, seq + octets, wp, w + 2)) {
+					err = EILSEQ;
+					break;
+				}
+				if (wp != w) {
 					Nirvana::state_clear (*ps);
+					put (w, wp);
+					octets = 0;
+					break;
 				}
-				break;
 			}
+			if (octets && !err) {
+				// Still incomplete
+				uint32_t packed = 0;
+				for (size_t i = 0; i < octets; ++i) {
+					packed |= (uint32_t)(uint8_t)seq [i] << (i * 8);
+				}
+				ps->__wchar = packed;
+				ps->__octets = (unsigned)octets;
+			}
+		}
 
-			if (cp) {
-				ps->__wchar = cp->to_wide (c);
-				ps->__octets = 0;
-			} else if (!(ps->__octets ? Nirvana::push_next (*ps, c) : Nirvana::push_first (*ps, c))) {
+		while (!err && nms && cnt < len) {
+			size_t max_chunk = std::min (nms, CHUNK_SIZE);
+			size_t chunk = strnlen (psrc, max_chunk);
+			const char* end = psrc + chunk;
+			const char* chunk_begin = psrc;
+			wchar_t* out_begin = dst ? dst + cnt : buf;
+			wchar_t* out = out_begin;
+			wchar_t* out_end = out + std::min (len - cnt, CHUNK_SIZE);
+			if (!(table ? table->to_wide (psrc, end, out, out_end)
+				: Nirvana::utf8_to_wide (psrc, end, out, out_end)))
 				err = EILSEQ;
+			cnt += out - out_begin;
+			nms -= psrc - chunk_begin;
+
+			if (err)
+				break;
+			if (psrc < end) {
+				if (out == out_end && cnt == len)
+					break; // No room
+
+				// Try to convert the next character into the temporary buffer
+				const char* sp = psrc;
+				wchar_t w [2];
+				wchar_t* wp = w;
+				Nirvana::utf8_to_wide (sp, end, wp, w + 2);
+				if (wp != w) {
+					// The character did not fit into the chunk output
+					nms -= sp - psrc;
+					psrc = sp;
+					put (w, wp);
+					continue;
+				}
+
+				// Incomplete sequence
+				if (chunk < max_chunk) {
+					err = EILSEQ; // Missing octets before the terminator
+					break;
+				} else if ((size_t)(end - psrc) == nms) {
+					// The rest octets will come with the next call
+					uint32_t packed = 0;
+					unsigned octets = 0;
+					for (; psrc < end; ++psrc, ++octets) {
+						packed |= (uint32_t)(uint8_t)*psrc << (octets * 8);
+					}
+					ps->__wchar = packed;
+					ps->__octets = octets;
+					nms = 0;
+					break;
+				}
+				// The sequence crosses the chunk boundary
+				continue;
+			}
+			if (chunk < max_chunk) {
+				// The terminating null
+				if (cnt < len) {
+					if (dst)
+						dst [cnt] = 0;
+					terminated = true;
+					Nirvana::state_clear (*ps);
+				}
 				break;
 			}
-			++psrc;
-			++cnt;
 		}
+	} catch (const std::bad_alloc&) {
+		err = ENOMEM;
 	} catch (...) {
 		err = EILSEQ;
 	}
 
 	count = cnt;
-	*src = psrc;
+	if (dst)
+		*src = terminated ? nullptr : psrc;
 	return err;
 }
 
@@ -164,14 +325,27 @@ int mbrtowc (wchar_t* pwc, const char* s, size_t n, __Mbstate* ps,
 		if (!s) {
 			s = "";
 			n = 1;
+			pwc = nullptr;
 		}
-		size_t len;
-		err = mbsnrtowcs (nullptr, &s, n, 0, ps, cp, len);
+		wchar_t wc;
+		const char* p = s;
+		size_t cnt;
+		err = mbsnrtowcs (&wc, &p, n, 1, ps, cp, cnt);
 		if (!err) {
-			if (ps->__octets)
+			if (!p) {
+				// The null character
+				if (pwc)
+					*pwc = 0;
+				count = 0;
+			} else if (cnt) {
+				if (pwc)
+					*pwc = wc;
+				if (p != s)
+					count = p - s;
+				else
+					count = (size_t)-3; // The low surrogate stored in the state
+			} else
 				count = (size_t)-2; // Incomplete character
-			else
-				count = len;
 		}
 	}
 	return err;
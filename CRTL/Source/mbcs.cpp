@@ -67,8 +67,16 @@ extern "C" size_t wcrtomb (char* s, wchar_t wc, __Mbstate* ps)
 			return (size_t)-1;
 		}
 	}
+	char buf [4]; // Maximal UTF-8 sequence length
+	if (!s) {
+		s = buf;
+		wc = 0;
+	}
 	const wchar_t* pwc = &wc;
-	return wcsnrtombs (s, &pwc, 1, MB_CUR_MAX, ps);
+	size_t ret = wcsnrtombs (s, &pwc, 1, MB_CUR_MAX, ps);
+	if (!wc && ret != (size_t)-1)
+		++ret; // Count the terminating null
+	return ret;
 }
 
 extern "C" int wctomb (char* s, wchar_t wc)
@@ -115,7 +123,7 @@ size_t mbrlen (const char* s, size_t n, __Mbstate* ps)
 			return 0;
 		} else {
 			size_t len;
-			err = CRTL::mbrtowc (nullptr, s, std::numeric_limits <size_t>::max (), ps, CRTL::cur_code_page (), len);
+			err = CRTL::mbrtowc (nullptr, s, n, ps, CRTL::cur_code_page (), len);
 			if (!err)
 				return len;
 		}
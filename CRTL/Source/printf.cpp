@@ -27,10 +27,10 @@
 #include <wchar.h>
 #include <limits>
 #include <Nirvana/POSIX.h>
-#include <Nirvana/locale_defs.h>
 #include <Nirvana/Formatter.h>
 #include "impl/strutl.h"
 #include "impl/ByteOutFile.h"
+#include "impl/Global.h"
 
 using namespace Nirvana;
 
@@ -43,16 +43,18 @@ namespace CRTL {
 /// \param args Arguments.
 /// \param out Output stream.
 /// \param [out] ret Number of wide characters transmitted to the output stream.
-/// \param loc Locale conversion settings.
+/// \param loc Locale or nullptr for the "C" locale.
 /// \returns Zero on success or error code.
 template <class C> inline
 int vprintf (const C* fmt, va_list args, WideOut& out, size_t& ret,
-	const struct lconv* loc = nullptr) noexcept
+	Locale::_ptr_type loc = nullptr) noexcept
 {
 	int err = 0;
 	try {
-		WideInStrT <C> fmt_in (fmt);
-		ret = Formatter::format (fmt_in, args, out, loc);
+		if (loc)
+			ret = Formatter::format (fmt, args, out, Global::numpunct (loc));
+		else
+			ret = Formatter::format (fmt, args, out);
 	} catch (const CORBA::CODESET_INCOMPATIBLE&) {
 		err = EILSEQ;
 	} catch (const CORBA::NO_MEMORY&) {
@@ -80,21 +82,105 @@ int vprintf (const C* fmt, va_list args, WideOut& out, size_t& ret,
 /// \param args Arguments.
 /// \param ret Number of characters (not including the terminating null character) which would have
 ///   been written to buffer if bufsz was ignored.
-/// \param loc Locale conversion settings.
+/// \param loc Locale or nullptr for the "C" locale.
 /// \returns Zero on success or error code.
 template <class C>
 int vsnprintf (C* buffer, size_t bufsz, const C* fmt, va_list args, size_t& ret,
-	const struct lconv* loc = nullptr) noexcept
+	Locale::_ptr_type loc = nullptr) noexcept
 {
-	WideOutBufT <C> out (buffer, bufsz ? get_end (buffer, bufsz - 1) : buffer);
 	size_t cnt;
+	if (!bufsz) {
+		// Size probing, output is only counted
+		WideOutCount <C> out;
+		int err = vprintf (fmt, args, out, cnt, loc);
+		ret = out.count ();
+		return err;
+	}
+
+	WideOutBufT <C> out (buffer, get_end (buffer, bufsz - 1));
 	int err = vprintf (fmt, args, out, cnt, loc);
 	ret = out.count ();
-  if (bufsz)
-	  *out.cur_ptr () = 0;
+	*out.cur_ptr () = 0;
 	return err;
 }
 
+/// Growing buffer allocated by malloc ().
+/// Meets the container requirements of WideOutContainerT.
+/// 
+/// \typeparam C Character type.
+template <class C>
+class MallocBuf
+{
+	static const size_t INIT_SIZE = 128;
+
+public:
+	typedef C value_type;
+
+	MallocBuf () noexcept :
+		buf_ (nullptr),
+		end_ (nullptr),
+		cap_end_ (nullptr)
+	{}
+
+	~MallocBuf ()
+	{
+		free (buf_);
+	}
+
+	C* end () const noexcept
+	{
+		return end_;
+	}
+
+	void push_back (C c)
+	{
+		reserve (1);
+		*(end_++) = c;
+	}
+
+	template <class It>
+	void insert (C*, It first, It last)
+	{
+		size_t cnt = last - first;
+		reserve (cnt);
+		end_ = std::copy (first, last, end_);
+	}
+
+	size_t size () const noexcept
+	{
+		return end_ - buf_;
+	}
+
+	/// Release the zero-terminated string.
+	C* release ()
+	{
+		push_back (0);
+		C* p = buf_;
+		buf_ = end_ = cap_end_ = nullptr;
+		return p;
+	}
+
+private:
+	void reserve (size_t cnt)
+	{
+		if ((size_t)(cap_end_ - end_) < cnt) {
+			size_t size = end_ - buf_;
+			size_t cap = std::max (std::max ((size_t)(cap_end_ - buf_) * 2, size + cnt), INIT_SIZE);
+			C* p = (C*)realloc (buf_, cap * sizeof (C));
+			if (!p)
+				throw std::bad_alloc ();
+			buf_ = p;
+			end_ = p + size;
+			cap_end_ = p + cap;
+		}
+	}
+
+private:
+	C* buf_;
+	C* end_;
+	C* cap_end_;
+};
+
 /// \brief Generalized C-style formatting function.
 /// As it intended to C formatting, it does not throw exceptions
 /// but sets `errno` codes on error instead.
@@ -103,11 +189,11 @@ int vsnprintf (C* buffer, size_t bufsz, const C* fmt, va_list args, size_t& ret,
 /// \param fmt Format string.
 /// \param args Arguments.
 /// \param out Output stream.
-/// \param loc Locale conversion settings.
+/// \param loc Locale.
 /// \returns Number of characters transmitted to the output stream or negative value if an output
 ///          error or an encoding error (for string and character conversion specifiers) occurred.
 template <class C>
-int vprintf (const C* fmt, va_list args, WideOut& out, const struct lconv* loc) noexcept
+int vprintf (const C* fmt, va_list args, WideOut& out, Locale::_ptr_type loc) noexcept
 {
 	size_t ret;
 	int err = vprintf (fmt, args, out, ret, loc);
@@ -134,8 +220,7 @@ template <class C>
 int vsnprintf (C* buffer, size_t bufsz, const C* fmt, va_list args) noexcept
 {
 	size_t ret;
-	int err = vsnprintf (buffer, bufsz, fmt, args, ret,
-		the_posix->cur_locale ()->localeconv ());
+	int err = vsnprintf (buffer, bufsz, fmt, args, ret, the_posix->cur_locale ());
 	if (err) {
 		errno = err;
 		return -1;
@@ -143,19 +228,29 @@ int vsnprintf (C* buffer, size_t bufsz, const C* fmt, va_list args) noexcept
 		return (int)ret;
 }
 
+/// \brief Generalized vasprintf implementation.
+/// The string is formatted in one pass into the growing buffer.
+/// 
+/// \typeparam C Character type.
+/// \param strp The pointer to the allocated string.
+/// \param fmt Format string.
+/// \param args Arguments.
+/// \returns Number of characters (not including the terminating null character) or -1 on error.
 template <class C>
-int vasprintf (C** strp, const C* fmt, va_list args)
+int vasprintf (C** strp, const C* fmt, va_list args) noexcept
 {
-	const struct lconv* lc = the_posix->cur_locale ()->localeconv ();
+	MallocBuf <C> buf;
+	WideOutContainerT <MallocBuf <C> > out (buf);
 	size_t cnt;
-	int err = vsnprintf ((C*)nullptr, 0, fmt, args, cnt, lc);
+	int err = vprintf (fmt, args, out, cnt, the_posix->cur_locale ());
 	C* msg = nullptr;
 	if (!err) {
-		msg = (C*)malloc ((cnt + 1) * sizeof (C));
-		if (!msg)
+		cnt = buf.size ();
+		try {
+			msg = buf.release ();
+		} catch (...) {
 			err = ENOMEM;
-		else
-			err = vsnprintf (msg, cnt + 1, fmt, args, cnt, lc);
+		}
 	}
 	*strp = msg;
 	if (err) {
@@ -182,7 +277,7 @@ int vfprintf (FILE* stream, const char* fmt, va_list args)
 	ByteOutFile file_bytes (f);
 	WideOutCP out (file_bytes, code_page);
 
-	return CRTL::vprintf (fmt, args, out, loc->localeconv ());
+	return CRTL::vprintf (fmt, args, out, loc);
 }
 
 int vprintf (const char* fmt, va_list args)
@@ -264,4 +359,13 @@ int vasprintf (char** strp, const char* fmt, va_list arg)
 	return CRTL::vasprintf (strp, fmt, arg);
 }
 
+int asprintf (char** strp, const char* fmt, ...)
+{
+	va_list args;
+	va_start (args, fmt);
+	int ret = vasprintf (strp, fmt, args);
+	va_end (args);
+	return ret;
+}
+
 }
@@ -30,6 +30,7 @@
 #include <Nirvana/locale_defs.h>
 #include "impl/ByteInFile.h"
 #include "impl/locale.h"
+#include "impl/Global.h"
 
 using namespace Nirvana;
 
@@ -38,14 +39,16 @@ namespace CRTL {
 // \brief Generalized C-style scan function.
 /// As it intended to C, it does not throw exceptions
 /// but sets `errno` codes on error instead.
-template <class C>
-int vscanf (WideIn& in, const C* fmt, va_list args, const struct lconv* loc = nullptr) noexcept
+/// The format is taken from Global::scan_format ().
+/// 
+/// \typeparam In Input stream or the string pointer.
+template <class In>
+int vscanf (In& in, const char* fmt, va_list args, const struct lconv* loc = nullptr) noexcept
 {
 	int err;
-	size_t cnt;
+	size_t cnt = 0;
 	try {
-		WideInStrT <C> fmt_in (fmt);
-		bool ok = Parser::parse (in, fmt_in, args, cnt, loc);
+		bool ok = Parser::parse (in, Global::scan_format (fmt), args, cnt, loc);
 		err = 0;
 		if (!ok && !cnt)
 			return EOF;
@@ -64,11 +67,10 @@ int vscanf (WideIn& in, const C* fmt, va_list args, const struct lconv* loc = nu
 /// \brief Generalized C-style string scan function.
 /// As it intended to C, it does not throw exceptions
 /// but sets `errno` codes on error instead.
-template <class C>
-int vsscanf (const C* buffer, const C* fmt, va_list args, const struct lconv* loc) noexcept
+/// The string is read directly by pointer.
+inline int vsscanf (const char* buffer, const char* fmt, va_list args, const struct lconv* loc) noexcept
 {
-	WideInStrT <C> in (buffer);
-	return vscanf (in, fmt, args, loc);
+	return vscanf (buffer, fmt, args, loc);
 }
 
 }
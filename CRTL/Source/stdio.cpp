@@ -63,6 +63,11 @@ void perror (const char* s)
 	fputs ("\n", stderr);
 }
 
+int getchar (void)
+{
+	return getc (stdin);
+}
+
 int putchar (int ch)
 {
 	return putc (ch, stdout);
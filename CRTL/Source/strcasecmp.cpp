@@ -53,3 +53,24 @@ extern "C" int strcasecmp (const char* s1, const char* s2)
 {
 	return strncasecmp (s1, s2, std::numeric_limits <size_t>::max ());
 }
+
+extern "C" int wcsncasecmp (const wchar_t* s1, const wchar_t* s2, size_t n)
+{
+	for (; n; ++s1, ++s2, --n) {
+		wint_t wc1 = *s1, wc2 = *s2;
+		if (wc1 != wc2) {
+			// Case mapping is only needed for the different characters
+			wc1 = towlower (wc1);
+			wc2 = towlower (wc2);
+			if (wc1 != wc2)
+				return wc1 < wc2 ? -1 : 1;
+		} else if (!wc1)
+			break;
+	}
+	return 0;
+}
+
+extern "C" int wcscasecmp (const wchar_t* s1, const wchar_t* s2)
+{
+	return wcsncasecmp (s1, s2, std::numeric_limits <size_t>::max ());
+}
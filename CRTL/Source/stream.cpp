@@ -24,11 +24,45 @@
 *  popov.nirvana@gmail.com
 */
 #include <stdio.h>
+#include <stdlib.h>
 #include <limits>
+#include <algorithm>
 #include "impl/File.h"
+#include "impl/Global.h"
 #include "impl/mbcs.h"
 #include "impl/locale.h"
 
+namespace CRTL {
+
+inline int getc (File* f) noexcept
+{
+	if (!f)
+		return EOF;
+
+	int c;
+	int e = f->getc (c);
+	if (e) {
+		errno = e;
+		return EOF;
+	}
+	return c;
+}
+
+inline int putc (int c, File* f) noexcept
+{
+	if (!f)
+		return EOF;
+
+	int e = f->putc ((char)c);
+	if (e) {
+		errno = e;
+		return EOF;
+	}
+	return (unsigned char)c;
+}
+
+}
+
 extern "C" {
   
 int fclose (FILE* stream)
@@ -41,8 +75,7 @@ int fclose (FILE* stream)
 	if (!f)
 		return EOF;
 
-	int e = f->close ();
-	delete f;
+	int e = CRTL::Global::fclose (f);
 	if (e) {
 		errno = e;
 		return EOF;
@@ -100,10 +133,12 @@ size_t fwrite (const void* buffer, size_t size, size_t count, FILE* stream)
 
 int fputc (int c, FILE* stream)
 {
-	char d = c;
-	if (fwrite (&d, 1, 1, stream) != 1)
-		return EOF;
-	return 1;
+	return CRTL::putc (c, CRTL::File::cast (stream));
+}
+
+int putc_unlocked (int c, FILE* stream)
+{
+	return CRTL::putc (c, CRTL::File::cast_locked (stream));
 }
 
 int fputs (const char* s, FILE* stream)
@@ -203,11 +238,87 @@ long ftell (FILE* stream)
 
 int fgetc (FILE* stream)
 {
-	char c;
-	auto bytes_read = fread (&c, 1, 1, stream);
-	if (bytes_read != 1)
-		return EOF;
-	return c;
+	return CRTL::getc (CRTL::File::cast (stream));
+}
+
+int getc_unlocked (FILE* stream)
+{
+	return CRTL::getc (CRTL::File::cast_locked (stream));
+}
+
+char* fgets (char* s, int n, FILE* stream)
+{
+	CRTL::File* f = CRTL::File::cast (stream);
+	if (!f || !s || n <= 0) {
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	size_t cb = 0;
+	if (n > 1) {
+		int e = f->read_until ('\n', s, n - 1, cb);
+		if (e) {
+			errno = e;
+			return nullptr;
+		}
+		if (!cb)
+			return nullptr;
+	}
+	s [cb] = 0;
+	return s;
+}
+
+ssize_t getdelim (char** lineptr, size_t* n, int delim, FILE* stream)
+{
+	CRTL::File* f = CRTL::File::cast (stream);
+	if (!f || !lineptr || !n) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	const size_t MIN_SIZE = 128;
+	char* buf = *lineptr;
+	size_t size = buf ? *n : 0;
+	size_t len = 0;
+	for (;;) {
+		if (size - len < 2) {
+			size_t new_size = std::max (size * 2, MIN_SIZE);
+			char* p = (char*)realloc (buf, new_size);
+			if (!p) {
+				errno = ENOMEM;
+				return -1;
+			}
+			*lineptr = buf = p;
+			*n = size = new_size;
+		}
+
+		size_t cb;
+		size_t max_size = size - len - 1;
+		int e = f->read_until (delim, buf + len, max_size, cb);
+		if (e) {
+			errno = e;
+			return -1;
+		}
+		len += cb;
+		if (cb < max_size || buf [len - 1] == (char)delim)
+			break;
+	}
+
+	if (!len)
+		return -1;
+
+	if (len > (size_t)std::numeric_limits <ssize_t>::max ()) {
+		errno = EOVERFLOW;
+		return -1;
+	}
+
+	buf [len] = 0;
+	return (ssize_t)len;
+}
+
+ssize_t getline (char** lineptr, size_t* n, FILE* stream)
+{
+	return getdelim (lineptr, n, '\n', stream);
 }
 
 int ungetc (int c, FILE* stream)
@@ -358,6 +469,26 @@ wint_t fputwc (wchar_t wc, FILE* stream)
 	return wc;
 }
 
+// Streams are kept in the context-specific runtime data and File::cast rejects
+// the stream of the other execution context. So the stream is always owned by
+// the calling context and there is nothing to lock: the functions only validate
+// the stream for the subsequent *_unlocked calls.
+
+void flockfile (FILE* stream)
+{
+	CRTL::File::cast (stream);
+}
+
+int ftrylockfile (FILE* stream)
+{
+	return CRTL::File::cast (stream) ? 0 : -1;
+}
+
+void funlockfile (FILE* stream)
+{
+	CRTL::File::cast (stream);
+}
+
 int puts (const char* s)
 {
   return fputs (s, stdout);
@@ -25,27 +25,18 @@
 */
 #include <wctype.h>
 #include <time.h>
+#include <stdlib.h>
+#include <string.h>
 #include <algorithm>
-#include <Nirvana/Formatter.h>
+#include <Nirvana/WideIn.h>
+#include <Nirvana/WideOut.h>
+#include "impl/TimeFormat.h"
+#include "impl/Global.h"
 
 namespace Nirvana {
 
-struct DateTimeLocale
-{
-	const char* month [12];
-	const char* abmonth [12];
-	const char* day [7];
-	const char* abday [7];
-	const char* am;
-	const char* pm;
-	const char* date_format;
-	const char* time_format;
-	const char* time_format_ampm;
-	const char* date_time_format;
-};
-
 static const DateTimeLocale default_time_locale = {
-	{	"January", "Feburary", "March", "April", "May", "June", "July", "August", "September",
+	{	"January", "February", "March", "April", "May", "June", "July", "August", "September",
 		"October", "November", "December" },
 	{ "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" },
 	{ "Sunday", "Monday", "Tuesday", "Wednesday", "Thursday", "Friday", "Saturday" },
@@ -53,7 +44,8 @@ static const DateTimeLocale default_time_locale = {
 	"AM", "PM",
 	"%m/%d/%y",
 	"%H:%M:%S",
-	"%I:%M:%S %p"
+	"%I:%M:%S %p",
+	"%a %b %e %H:%M:%S %Y"
 };
 
 }
@@ -62,214 +54,393 @@ namespace CRTL {
 
 using namespace Nirvana;
 
-void strftime (WideOut& out, WideIn& format, const struct tm& tm,
-	const DateTimeLocale& loc = default_time_locale);
+static const char digit_pairs [200] = {
+	'0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+	'1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+	'2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+	'3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+	'4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+	'5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+	'6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+	'7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+	'8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+	'9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+/// Output decimal integer.
+/// 
+/// \param out The output stream.
+/// \param v The value.
+/// \param prec Minimal number of digits, the leading positions are filled with zeros.
+/// \param width Minimal field width, the leading positions are filled with spaces.
+/// \param plus Output '+' for the non-negative value.
+static void put_int (WideOut& out, long v, unsigned prec, unsigned width = 0, bool plus = false)
+{
+	char buf [24];
+	char* end = buf + sizeof (buf);
+	char* p = end;
+	unsigned long u = v < 0 ? 0 - (unsigned long)v : (unsigned long)v;
+	while (u >= 100) {
+		p -= 2;
+		memcpy (p, digit_pairs + (u % 100) * 2, 2);
+		u /= 100;
+	}
+	if (u >= 10) {
+		p -= 2;
+		memcpy (p, digit_pairs + u * 2, 2);
+	} else
+		*--p = (char)('0' + u);
+	while ((unsigned)(end - p) < prec)
+		*--p = '0';
+	if (v < 0)
+		*--p = '-';
+	else if (plus)
+		*--p = '+';
+	while ((unsigned)(end - p) < width)
+		*--p = ' ';
+	out.put_ascii (p, end - p);
+}
+
+/// Output two-digit zero-padded field.
+inline void put2 (WideOut& out, int v)
+{
+	if ((unsigned)v < 100)
+		out.put_ascii (digit_pairs + v * 2, 2);
+	else
+		put_int (out, v, 2);
+}
+
+static void put_name (WideOut& out, const DateTimeName& name)
+{
+	if (name.ascii)
+		out.put_ascii (name.str, name.len);
+	else {
+		WideInStrUTF8 in (name.str);
+		copy (in, out);
+	}
+}
+
+static int hour12 (int hour) noexcept
+{
+	if (!hour)
+		hour = 12;
+	if (hour > 12)
+		hour -= 12;
+	return hour;
+}
+
+void TimeFormat::compile (WideIn& format, const DateTimeLocale& loc)
+{
+	loc_ = nullptr;
+	items_.clear ();
+	text_.clear ();
+	compile (format, loc, 0);
+	loc_ = &loc;
+}
 
-void strftime (WideOut& out, const char* format, const struct tm& tm,
-	const DateTimeLocale& loc)
+void TimeFormat::compile (const char* format, const DateTimeLocale& loc)
 {
+	loc_ = nullptr;
+	source_ = format;
 	WideInStrUTF8 in (format);
-	strftime (out, in, tm, loc);
+	compile (in, loc);
 }
 
-static void append_format (WideOut& out, const char* fmt, ...)
+void TimeFormat::compile (const char* format, const DateTimeLocale& loc, unsigned depth)
 {
-	va_list args;
-	va_start (args, fmt);
-	WideInStr <char> fmt_in (fmt);
-	Formatter::format (fmt_in, args, out);
-	va_end (args);
+	WideInStrUTF8 in (format);
+	if (depth < MAX_DEPTH)
+		compile (in, loc, depth + 1);
+	else {
+		// The locale format refers to itself, output it as is.
+		for (int32_t c; (c = in.get ()) != EOF;)
+			add_literal (c);
+	}
 }
 
-static void append (WideOut& out, const char* s)
+void TimeFormat::add_literal (int32_t c)
 {
-	WideInStrUTF8 in (s);
-	copy (in, out);
+	if ((uint32_t)c < 0x80) {
+		if (items_.empty () || items_.back ().field != LITERAL)
+			items_.push_back ({ LITERAL, 0 });
+		++(items_.back ().value);
+		text_.push_back ((char)c);
+	} else
+		items_.push_back ({ LITERAL_WC, (uint32_t)c });
 }
 
-void strftime (WideOut& out, WideIn& format, const struct tm& tm, const DateTimeLocale& loc)
+void TimeFormat::add (Field f)
 {
-	//auto c = format;
-	//auto p = dest;
-	bool use_alternative_symbols = false;
-	bool use_alternative_era_format = false;
+	items_.push_back ({ f, 0 });
+}
 
+void TimeFormat::compile (WideIn& format, const DateTimeLocale& loc, unsigned depth)
+{
 	int32_t c = format.get ();
-	while (c) {
+	while (c != EOF) {
 
-		if(c != '%') {
-			out.put (c);
+		if (c != '%') {
+			add_literal (c);
 			c = format.get ();
 			continue;
 		}
 
 		c = format.get ();
+
+		// The alternative symbols and era formats are not supported, the modifiers are ignored.
 		if (c == 'O') {
-			char valid [] = {'B', 'b', 'd', 'e', 'H', 'I', 'm', 'M', 'S', 'u', 'U', 'V', 'w', 'W', 'y'};
+			static const char valid [] = { 'B', 'b', 'd', 'e', 'H', 'I', 'm', 'M', 'S', 'u', 'U', 'V', 'w', 'W', 'y' };
 			c = format.get ();
-			if (std::find (std::begin (valid), std::end (valid), c) != std::end (valid)) {
-				use_alternative_symbols = true;
-				c = format.get ();
-			} else {
-				out.put ('%');
-				out.put ('O');
+			if (std::find (std::begin (valid), std::end (valid), c) == std::end (valid)) {
+				add_literal ('%');
+				add_literal ('O');
 				continue;
 			}
 		} else if (c == 'E') {
-			char valid [] = {'c', 'C', 'x', 'X', 'y', 'Y'};
+			static const char valid [] = { 'c', 'C', 'x', 'X', 'y', 'Y' };
 			c = format.get ();
-			if (std::find (std::begin (valid), std::end (valid), c) != std::end (valid)) {
-				use_alternative_era_format = true;
-				c = format.get ();
-			} else {
-				out.put ('%');
-				out.put ('E');
+			if (std::find (std::begin (valid), std::end (valid), c) == std::end (valid)) {
+				add_literal ('%');
+				add_literal ('E');
 				continue;
 			}
 		}
 
 		switch (c) {
 		case 'Y':
-			append_format (out, "%d", 1900 + tm.tm_year);
+			add (YEAR);
 			break;
 		case 'm':
-			append_format (out, "%.2d", tm.tm_mon + 1);
+			add (MONTH);
 			break;
 		case 'd':
-			append_format (out, "%.2d", tm.tm_mday);
+			add (DAY);
 			break;
-		case 'z': {
-			auto min = tm.tm_gmtoff / 60;
-			auto diff = ((min / 60) * 100) + (min % 60);
-			append_format (out, "%c%04d", diff >= 0 ? '+' : '-', abs (diff));
+		case 'z':
+			add (TZ_OFFSET);
 			break;
-		}
 		case 'Z':
-			if (tm.tm_gmtoff)
-				append_format (out, "UTC%+02d:%02u", tm.tm_gmtoff / 60, std::abs (tm.tm_gmtoff % 60));
-			else
-				append (out, "UTC");
+			add (TZ_NAME);
 			break;
 		case 'H':
-			append_format (out, "%.2i", tm.tm_hour);
+			add (HOUR);
 			break;
 		case 'M':
-			append_format (out, "%.2i", tm.tm_min);
+			add (MINUTE);
 			break;
 		case 'S':
-			append_format (out, "%.2d", tm.tm_sec);
+			add (SECOND);
 			break;
 		case 'R':
-			append_format (out, "%.2i:%.2i", tm.tm_hour, tm.tm_min);
+			add (HOUR);
+			add_literal (':');
+			add (MINUTE);
 			break;
 		case 'T':
-			append_format (out, "%.2i:%.2i:%.2i", tm.tm_hour, tm.tm_min, tm.tm_sec);
+			add (HOUR);
+			add_literal (':');
+			add (MINUTE);
+			add_literal (':');
+			add (SECOND);
 			break;
 		case 'F':
-			append_format (out, "%d-%.2d-%.2d", 1900 + tm.tm_year, tm.tm_mon + 1, tm.tm_mday);
+			add (YEAR);
+			add_literal ('-');
+			add (MONTH);
+			add_literal ('-');
+			add (DAY);
 			break;
 		case 'D':
-			append_format (out, "%.2d/%.2d/%.2d", tm.tm_mon + 1, tm.tm_mday, (tm.tm_year + 1900) % 100);
+			add (MONTH);
+			add_literal ('/');
+			add (DAY);
+			add_literal ('/');
+			add (YEAR2);
 			break;
-		case 'a': {
-			int day = tm.tm_wday;
-			if (day >= 0 && day < 7)
-				append (out, loc.abday [day]);
+		case 'a':
+			add (ABDAY);
 			break;
-		}
 		case 'b':
+		case 'h':
+			add (ABMONTH);
+			break;
 		case 'B':
-		case 'h': {
-			int mon = tm.tm_mon;
-			if (mon >= 0 && mon < 12)
-				append (out, (c == 'B') ? loc.month [mon] : loc.abmonth [mon]);
+			add (MONTH_NAME);
 			break;
-		}
 		case 'c':
-			strftime (out, loc.date_time_format, tm, loc);
+			compile (loc.date_time_format, loc, depth);
 			break;
 		case 'e':
-			append_format (out, "%2d", tm.tm_mday);
+			add (DAY_SP);
 			break;
-		case 'l': {
-			int hour = tm.tm_hour;
-			if(!hour)
-				hour = 12;
-			if(hour > 12)
-				hour -= 12;
-			append_format (out, "%2d", hour);
+		case 'l':
+			add (HOUR12_SP);
 			break;
-		}
 		case 'k':
-			append_format (out, "%2d", tm.tm_hour);
+			add (HOUR_SP);
 			break;
-		case 'I': {
-			int hour = tm.tm_hour;
-			if(!hour)
-				hour = 12;
-			if(hour > 12)
-				hour -= 12;
-			append_format (out, "%.2d", hour);
+		case 'I':
+			add (HOUR12);
 			break;
-		}
-		case 'p': {
-			append (out, (tm.tm_hour < 12) ? loc.am : loc.pm);
+		case 'p':
+			add (AMPM);
 			break;
-		}
-		case 'P': {
-			const char *str = (tm.tm_hour < 12) ? loc.am : loc.pm;
-			WideInStrUTF8 in (str);
-			for (auto wc = in.get (); wc; wc = in.get ())
-				out.put (towlower (wc));
+		case 'P':
+			add (AMPM_LOWER);
 			break;
-		}
 		case 'C':
-			append_format (out, "%.2d", (1900 + tm.tm_year) / 100);
+			add (CENTURY);
 			break;
 		case 'y':
-			append_format (out, "%.2d", (1900 + tm.tm_year) % 100);
+			add (YEAR2);
 			break;
 		case 'j':
-			append_format (out, "%.3d", tm.tm_yday + 1);
+			add (YDAY);
 			break;
-		case 'A': {
-			int day = tm.tm_wday;
-			if (day >= 0 && day < 7)
-				append (out, loc.day [day]);
+		case 'A':
+			add (DAY_NAME);
 			break;
-		}
 		case 'r':
-			strftime (out, loc.time_format_ampm, tm, loc);
+			compile (loc.time_format_ampm, loc, depth);
 			break;
 		case '%':
-			out.put ('%');
+			add_literal ('%');
 			break;
 		case 'n':
-			out.put ('\n');
+			add_literal ('\n');
 			break;
 		case 't':
-			out.put ('\t');
+			add_literal ('\t');
 			break;
 		case 'x':
-			strftime (out, loc.date_format, tm, loc);
+			compile (loc.date_format, loc, depth);
 			break;
 		case 'X':
-			strftime (out, loc.time_format, tm, loc);
+			compile (loc.time_format, loc, depth);
 			break;
-		case '\0':
-			out.put ('%');
+		case EOF:
+			add_literal ('%');
 			continue;
 		}
 		c = format.get ();
 	}
 }
 
+void TimeFormat::format (const struct tm& tm, WideOut& out) const
+{
+	assert (loc_);
+	const DateTimeLocale& loc = *loc_;
+	const char* text = text_.data ();
+	for (const Item& item : items_) {
+		switch (item.field) {
+		case LITERAL:
+			out.put_ascii (text, item.value);
+			text += item.value;
+			break;
+		case LITERAL_WC:
+			out.put (item.value);
+			break;
+		case YEAR:
+			put_int (out, 1900 + tm.tm_year, 1);
+			break;
+		case CENTURY:
+			put_int (out, (1900 + tm.tm_year) / 100, 2);
+			break;
+		case YEAR2:
+			put2 (out, (1900 + tm.tm_year) % 100);
+			break;
+		case MONTH:
+			put2 (out, tm.tm_mon + 1);
+			break;
+		case DAY:
+			put2 (out, tm.tm_mday);
+			break;
+		case DAY_SP:
+			put_int (out, tm.tm_mday, 1, 2);
+			break;
+		case YDAY:
+			put_int (out, tm.tm_yday + 1, 3);
+			break;
+		case HOUR:
+			put2 (out, tm.tm_hour);
+			break;
+		case HOUR_SP:
+			put_int (out, tm.tm_hour, 1, 2);
+			break;
+		case HOUR12:
+			put2 (out, hour12 (tm.tm_hour));
+			break;
+		case HOUR12_SP:
+			put_int (out, hour12 (tm.tm_hour), 1, 2);
+			break;
+		case MINUTE:
+			put2 (out, tm.tm_min);
+			break;
+		case SECOND:
+			put2 (out, tm.tm_sec);
+			break;
+		case TZ_OFFSET: {
+			auto min = tm.tm_gmtoff / 60;
+			auto diff = ((min / 60) * 100) + (min % 60);
+			out.put (diff >= 0 ? '+' : '-');
+			put_int (out, std::abs (diff), 4);
+		} break;
+		case TZ_NAME:
+			out.put_ascii ("UTC", 3);
+			if (tm.tm_gmtoff) {
+				put_int (out, tm.tm_gmtoff / 60, 1, 0, true);
+				out.put (':');
+				put2 (out, (int)std::abs (tm.tm_gmtoff % 60));
+			}
+			break;
+		case ABDAY:
+			if (tm.tm_wday >= 0 && tm.tm_wday < 7)
+				put_name (out, loc.abday [tm.tm_wday]);
+			break;
+		case DAY_NAME:
+			if (tm.tm_wday >= 0 && tm.tm_wday < 7)
+				put_name (out, loc.day [tm.tm_wday]);
+			break;
+		case ABMONTH:
+			if (tm.tm_mon >= 0 && tm.tm_mon < 12)
+				put_name (out, loc.abmonth [tm.tm_mon]);
+			break;
+		case MONTH_NAME:
+			if (tm.tm_mon >= 0 && tm.tm_mon < 12)
+				put_name (out, loc.month [tm.tm_mon]);
+			break;
+		case AMPM:
+			put_name (out, (tm.tm_hour < 12) ? loc.am : loc.pm);
+			break;
+		case AMPM_LOWER: {
+			WideInStrUTF8 in (((tm.tm_hour < 12) ? loc.am : loc.pm).str);
+			for (auto wc = in.get (); wc != EOF; wc = in.get ())
+				out.put (towlower (wc));
+		} break;
+		}
+	}
+}
+
+template <class C>
+void strftime (WideOut& out, const C* format, const struct tm& tm)
+{
+	WideInStrT <C> in (format);
+	TimeFormat tf;
+	tf.compile (in, default_time_locale);
+	tf.format (tm, out);
+}
+
+void strftime (WideOut& out, const char* format, const struct tm& tm)
+{
+	// The compiled format is cached, as the same format is usually used repeatedly.
+	Global::time_format (format, default_time_locale).format (tm, out);
+}
+
 template <class C>
 size_t strftime (C* buf, size_t maxsize, const C* fmt, const struct tm* time)
 {
 	WideOutBufT <C> out (buf, buf + maxsize);
-	WideInStrT <C> in (fmt);
-	strftime (out, in, *time);
+	strftime (out, fmt, *time);
 	size_t cnt = out.count ();
 	if (cnt >= maxsize) {
 		errno = ERANGE;
@@ -0,0 +1,180 @@
+/* Case mappings: {towlower (c) - c, towupper (c) - c} */
+  {0, 0},
+  {32, 0},
+  {0, -32},
+  {0, 743},
+  {0, 121},
+  {1, 0},
+  {0, -1},
+  {-199, 0},
+  {0, -232},
+  {-121, 0},
+  {0, -300},
+  {0, 195},
+  {210, 0},
+  {206, 0},
+  {205, 0},
+  {79, 0},
+  {202, 0},
+  {203, 0},
+  {207, 0},
+  {0, 97},
+  {211, 0},
+  {209, 0},
+  {0, 163},
+  {213, 0},
+  {0, 130},
+  {214, 0},
+  {218, 0},
+  {217, 0},
+  {219, 0},
+  {0, 56},
+  {2, 0},
+  {1, -1},
+  {0, -2},
+  {0, -79},
+  {-97, 0},
+  {-56, 0},
+  {-130, 0},
+  {10795, 0},
+  {-163, 0},
+  {10792, 0},
+  {0, 10815},
+  {-195, 0},
+  {69, 0},
+  {71, 0},
+  {0, 10783},
+  {0, 10780},
+  {0, 10782},
+  {0, -210},
+  {0, -206},
+  {0, -205},
+  {0, -202},
+  {0, -203},
+  {0, 42319},
+  {0, 42315},
+  {0, -207},
+  {0, 42280},
+  {0, 42308},
+  {0, -209},
+  {0, -211},
+  {0, 10743},
+  {0, 42305},
+  {0, 10749},
+  {0, -213},
+  {0, -214},
+  {0, 10727},
+  {0, -218},
+  {0, 42307},
+  {0, 42282},
+  {0, -69},
+  {0, -217},
+  {0, -71},
+  {0, -219},
+  {0, 42261},
+  {0, 42258},
+  {0, 84},
+  {116, 0},
+  {38, 0},
+  {37, 0},
+  {64, 0},
+  {63, 0},
+  {0, -38},
+  {0, -37},
+  {0, -31},
+  {0, -64},
+  {0, -63},
+  {8, 0},
+  {0, -62},
+  {0, -57},
+  {0, -47},
+  {0, -54},
+  {0, -8},
+  {0, -86},
+  {0, -80},
+  {0, 7},
+  {0, -116},
+  {-60, 0},
+  {0, -96},
+  {-7, 0},
+  {80, 0},
+  {15, 0},
+  {0, -15},
+  {48, 0},
+  {0, -48},
+  {7264, 0},
+  {0, 3008},
+  {38864, 0},
+  {0, -6254},
+  {0, -6253},
+  {0, -6244},
+  {0, -6242},
+  {0, -6243},
+  {0, -6236},
+  {0, -6181},
+  {0, 35266},
+  {-3008, 0},
+  {0, 35332},
+  {0, 3814},
+  {0, 35384},
+  {0, -59},
+  {-7615, 0},
+  {0, 8},
+  {-8, 0},
+  {0, 74},
+  {0, 86},
+  {0, 100},
+  {0, 128},
+  {0, 112},
+  {0, 126},
+  {0, 9},
+  {-74, 0},
+  {-9, 0},
+  {0, -7205},
+  {-86, 0},
+  {-100, 0},
+  {-112, 0},
+  {-128, 0},
+  {-126, 0},
+  {-7517, 0},
+  {-8383, 0},
+  {-8262, 0},
+  {28, 0},
+  {0, -28},
+  {16, 0},
+  {0, -16},
+  {26, 0},
+  {0, -26},
+  {-10743, 0},
+  {-3814, 0},
+  {-10727, 0},
+  {0, -10795},
+  {0, -10792},
+  {-10780, 0},
+  {-10749, 0},
+  {-10783, 0},
+  {-10782, 0},
+  {-10815, 0},
+  {0, -7264},
+  {-35332, 0},
+  {-42280, 0},
+  {0, 48},
+  {-42308, 0},
+  {-42319, 0},
+  {-42315, 0},
+  {-42305, 0},
+  {-42258, 0},
+  {-42282, 0},
+  {-42261, 0},
+  {928, 0},
+  {-48, 0},
+  {-42307, 0},
+  {-35384, 0},
+  {0, -928},
+  {0, -38864},
+  {40, 0},
+  {0, -40},
+  {39, 0},
+  {0, -39},
+  {34, 0},
+  {0, -34},
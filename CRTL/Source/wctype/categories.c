@@ -2,51 +2,29 @@
 #include <stdint.h>
 #include "categories.h"
 
-#if defined (_MSC_VER)
-#pragma pack (push, 1)
-#endif
+/* Two-stage lookup: the block index of the code point selects
+   the block of categories. Equal blocks are shared. */
 
-struct _category {
-  enum category cat: 8;
-  uint_least32_t first: 24;
-  uint_least16_t delta;
-}
-#if (defined (__GNUG__) || defined (__clang__))
-__attribute__((packed))
-#endif
-;
+#define CAT_BLOCK_SHIFT 7
+#define CAT_BLOCK_SIZE (1 << CAT_BLOCK_SHIFT)
+#define CAT_NONE 0xFF
 
-#if defined (_MSC_VER)
-#pragma pack (pop)
-#endif
+static const uint8_t category_index[] = {
+#include "catindex.t"
+};
 
-static const struct _category categories[] = {
-#include "categories.t"
+static const uint8_t category_blocks[] = {
+#include "catblocks.t"
 };
 
-static enum category
-bisearch_cat(wint_t ucs, const struct _category *table, int max)
+enum category category(wint_t ucs)
 {
-  int min = 0;
-  int mid;
+  uint_least32_t block = ucs >> CAT_BLOCK_SHIFT;
+  uint8_t cat;
 
-  if (ucs < table[0].first || ucs > table[max].first + table[max].delta)
+  if (block >= sizeof(category_index) / sizeof(*category_index))
     return -1;
-  while (max >= min)
-    {
-      mid = (min + max) / 2;
-      if (ucs > table[mid].first + table[mid].delta)
-	min = mid + 1;
-      else if (ucs < table[mid].first)
-	max = mid - 1;
-      else
-	return table[mid].cat;
-    }
-  return -1;
-}
-
-enum category category(wint_t ucs)
-{
-  return bisearch_cat(ucs, categories,
-		      sizeof(categories) / sizeof(*categories) - 1);
+  cat = category_blocks[(category_index[block] << CAT_BLOCK_SHIFT)
+                        + (ucs & (CAT_BLOCK_SIZE - 1))];
+  return cat == CAT_NONE ? -1 : (enum category)cat;
 }
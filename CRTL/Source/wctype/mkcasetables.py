@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+#
+# Generate the two-stage case mapping tables of towctrans.c from caseconv.t.
+#
+# caseconv.t is the range table of newlib (generated by its mkcaseconv script
+# from the Unicode data). Each line is {first, diff, mode, delta} and describes
+# the range first...first + diff:
+#   TOLO    towlower (c) = c + delta
+#   TOUP    towupper (c) = c + delta
+#   TOBOTH  towlower (c) = c + 1, towupper (c) = c - 1
+#   TO1     capital and small letters alternate, delta is EVENCAP or ODDCAP
+#
+# Output:
+#   casedeltas.t  {towlower (c) - c, towupper (c) - c} pairs
+#   caseblocks.t  the pair numbers of the code points, 64 per block
+#   caseindex.t   the block numbers of the code points
+#
+# The pairs and the blocks are numbered in the order of the first occurrence,
+# equal blocks are shared. The index ends at the last block with a mapping.
+#
+# Usage: mkcasetables.py [directory]
+
+import os
+import re
+import sys
+
+BLOCK_SHIFT = 6
+BLOCK_SIZE = 1 << BLOCK_SHIFT
+MAX_CODE = 0x110000
+
+def read_ranges (path):
+	entry = re.compile (r'\{\s*(0x[0-9A-Fa-f]+),\s*(\d+),\s*(\w+),\s*(-?\w+)\s*\}')
+	with open (path) as f:
+		for m in entry.finditer (f.read ()):
+			yield int (m.group (1), 16), int (m.group (2)), m.group (3), m.group (4)
+
+def deltas (ranges):
+	lower = [0] * MAX_CODE
+	upper = [0] * MAX_CODE
+	for first, diff, mode, delta in ranges:
+		for c in range (first, first + diff + 1):
+			if mode == 'TOLO':
+				lower [c] = int (delta)
+			elif mode == 'TOUP':
+				upper [c] = int (delta)
+			elif mode == 'TOBOTH':
+				lower [c] = 1
+				upper [c] = -1
+			elif mode == 'TO1':
+				capital = (c & 1) == (0 if delta == 'EVENCAP' else 1)
+				if capital:
+					lower [c] = 1
+				else:
+					upper [c] = -1
+			else:
+				raise ValueError ('Unknown mode ' + mode)
+	return lower, upper
+
+def byte_lines (values):
+	for i in range (0, len (values), 16):
+		yield '  ' + ' '.join ('0x%02X,' % v for v in values [i:i + 16]) + '\n'
+
+def main ():
+	directory = sys.argv [1] if len (sys.argv) > 1 else os.path.dirname (os.path.abspath (__file__))
+	lower, upper = deltas (read_ranges (os.path.join (directory, 'caseconv.t')))
+
+	pairs = {(0, 0): 0}
+	numbers = []
+	for c in range (MAX_CODE):
+		pair = (lower [c], upper [c])
+		numbers.append (pairs.setdefault (pair, len (pairs)))
+
+	blocks = {}
+	index = []
+	for b in range (MAX_CODE // BLOCK_SIZE):
+		block = tuple (numbers [b * BLOCK_SIZE:(b + 1) * BLOCK_SIZE])
+		index.append (blocks.setdefault (block, len (blocks)))
+	zero = blocks [(0,) * BLOCK_SIZE]
+	while index [-1] == zero:
+		index.pop ()
+
+	assert len (pairs) <= 256 and len (blocks) <= 256
+
+	with open (os.path.join (directory, 'casedeltas.t'), 'w', newline = '\n') as f:
+		f.write ('/* Case mappings: {towlower (c) - c, towupper (c) - c} */\n')
+		for pair in sorted (pairs, key = pairs.get):
+			f.write ('  {%d, %d},\n' % pair)
+
+	with open (os.path.join (directory, 'caseblocks.t'), 'w', newline = '\n') as f:
+		f.write ('/* Case mapping numbers of the code points in the blocks */\n')
+		for n, block in enumerate (sorted (blocks, key = blocks.get)):
+			f.write ('  /* %d */\n' % n)
+			f.writelines (byte_lines (block))
+
+	with open (os.path.join (directory, 'caseindex.t'), 'w', newline = '\n') as f:
+		f.write ('/* Block numbers of the code points, %d code points per block */\n' % BLOCK_SIZE)
+		f.writelines (byte_lines (index))
+
+if __name__ == '__main__':
+	main ()
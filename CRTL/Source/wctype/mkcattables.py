@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+#
+# Generate the two-stage category tables of categories.c from categories.t.
+#
+# categories.t is the range table of newlib (generated by its mkcategories
+# script from the Unicode data). Each line is {CAT_xx, first, delta} and
+# describes the range first...first + delta. The category numbers are
+# the positions of the names in categories.cat.
+#
+# Output:
+#   catblocks.t  the categories of the code points, 128 per block,
+#                0xFF for the unassigned code points
+#   catindex.t   the block numbers of the code points
+#
+# The blocks are numbered in the order of the first occurrence, equal blocks
+# are shared. The index ends at the last block with an assigned code point.
+#
+# Usage: mkcattables.py [directory]
+
+import os
+import re
+import sys
+
+BLOCK_SHIFT = 7
+BLOCK_SIZE = 1 << BLOCK_SHIFT
+MAX_CODE = 0x110000
+CAT_NONE = 0xFF
+
+def read_names (path):
+	with open (path) as f:
+		names = re.findall (r'(CAT_\w+)', f.read ())
+	return {name: i for i, name in enumerate (names)}
+
+def read_ranges (path):
+	entry = re.compile (r'\{\s*(CAT_\w+),\s*(0x[0-9A-Fa-f]+),\s*(\d+)\s*\}')
+	with open (path) as f:
+		for m in entry.finditer (f.read ()):
+			yield m.group (1), int (m.group (2), 16), int (m.group (3))
+
+def byte_lines (values):
+	for i in range (0, len (values), 16):
+		yield '  ' + ' '.join ('0x%02X,' % v for v in values [i:i + 16]) + '\n'
+
+def main ():
+	directory = sys.argv [1] if len (sys.argv) > 1 else os.path.dirname (os.path.abspath (__file__))
+	names = read_names (os.path.join (directory, 'categories.cat'))
+
+	categories = [CAT_NONE] * MAX_CODE
+	for name, first, delta in read_ranges (os.path.join (directory, 'categories.t')):
+		for c in range (first, first + delta + 1):
+			categories [c] = names [name]
+
+	blocks = {}
+	index = []
+	for b in range (MAX_CODE // BLOCK_SIZE):
+		block = tuple (categories [b * BLOCK_SIZE:(b + 1) * BLOCK_SIZE])
+		index.append (blocks.setdefault (block, len (blocks)))
+	none = blocks.get ((CAT_NONE,) * BLOCK_SIZE)
+	while index [-1] == none:
+		index.pop ()
+
+	assert len (names) < CAT_NONE and len (blocks) <= 256
+
+	with open (os.path.join (directory, 'catblocks.t'), 'w', newline = '\n') as f:
+		f.write ('/* Categories of the code points in the blocks, 0x%02X for unassigned */\n' % CAT_NONE)
+		for n, block in enumerate (sorted (blocks, key = blocks.get)):
+			f.write ('  /* %d */\n' % n)
+			f.writelines (byte_lines (block))
+
+	with open (os.path.join (directory, 'catindex.t'), 'w', newline = '\n') as f:
+		f.write ('/* Block numbers of the code points, %d code points per block */\n' % BLOCK_SIZE)
+		f.writelines (byte_lines (index))
+
+if __name__ == '__main__':
+	main ()
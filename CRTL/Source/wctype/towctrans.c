@@ -1,140 +1,56 @@
 #include <wctype.h>
+#include <wchar.h>
 #include <stdint.h>
+#include <string.h>
 #include <errno.h>
 #include "local.h"
 
 /*
-   struct caseconv_entry describes the case conversion behaviour
-   of a range of Unicode characters.
-   It was designed to be compact for a minimal table size.
-   The range is first...first + diff.
-   Conversion behaviour for a character c in the respective range:
-     mode == TOLO	towlower (c) = c + delta
-     mode == TOUP	towupper (c) = c + delta
-     mode == TOBOTH	(titling case characters)
-			towlower (c) = c + 1
-			towupper (c) = c - 1
-     mode == TO1	capital/small letters are alternating
-	delta == EVENCAP	even codes are capital
-	delta == ODDCAP		odd codes are capital
-			(this correlates with an even/odd first range value
-			as of Unicode 10.0 but we do not rely on this)
-   As of Unicode 10.0, the following field lengths are sufficient
-	first: 17 bits
-	diff: 8 bits
-	delta: 17 bits
-	mode: 2 bits
-   The reserve of 4 bits (to limit the struct to 6 bytes)
-   is currently added to the 'first' field;
-   should a future Unicode version make it necessary to expand the others,
-   the 'first' field could be reduced as needed, or larger ranges could
-   be split up (reduce limit max=255 e.g. to max=127 or max=63 in 
-   script mkcaseconv, check increasing table size).
+   Two-stage case mapping lookup.
+   The block index of the code point selects the block of case mapping
+   numbers, equal blocks are shared. The case mapping number selects
+   the deltas to the lowercase and uppercase characters.
+   The tables are generated from the Unicode case conversion data.
  */
-enum {TO1, TOLO, TOUP, TOBOTH};
-enum {EVENCAP, ODDCAP};
-
-static struct caseconv_entry {
-  uint_least32_t first: 21;
-  uint_least32_t diff: 8;
-  uint_least32_t mode: 2;
-  int_least32_t delta: 17;
-}
-caseconv_table [] = {
-#include "caseconv.t"
+
+#define CASE_BLOCK_SHIFT 6
+#define CASE_BLOCK_SIZE (1 << CASE_BLOCK_SHIFT)
+
+static const uint8_t case_index[] = {
+#include "caseindex.t"
+};
+
+static const uint8_t case_blocks[] = {
+#include "caseblocks.t"
 };
 
-#define first(ce)	ce.first
-#define last(ce)	(ce.first + ce.diff)
+static const struct case_delta {
+  int_least32_t lower;
+  int_least32_t upper;
+}
+case_deltas[] = {
+#include "casedeltas.t"
+};
 
-/* auxiliary function for binary search in interval properties table */
-static const struct caseconv_entry *
-bisearch (wint_t ucs, const struct caseconv_entry *table, int max)
+static const struct case_delta *
+case_delta (wint_t c)
 {
-  int min = 0;
-  int mid;
+  uint_least32_t block = c >> CASE_BLOCK_SHIFT;
 
-  if (ucs < first(table[0]) || ucs > last(table[max]))
-    return 0;
-  while (max >= min)
-    {
-      mid = (min + max) / 2;
-      if (ucs > last(table[mid]))
-	min = mid + 1;
-      else if (ucs < first(table[mid]))
-	max = mid - 1;
-      else
-	return &table[mid];
-    }
-  return 0;
+  if (block >= sizeof(case_index) / sizeof(*case_index))
+    return case_deltas;
+  return case_deltas + case_blocks[(case_index[block] << CASE_BLOCK_SHIFT)
+                                   + (c & (CASE_BLOCK_SIZE - 1))];
 }
 
 static wint_t toulower (wint_t c)
 {
-  const struct caseconv_entry * cce =
-    bisearch(c, caseconv_table,
-             sizeof(caseconv_table) / sizeof(*caseconv_table) - 1);
-
-  if (cce)
-    switch (cce->mode)
-      {
-      case TOLO:
-	return c + cce->delta;
-      case TOBOTH:
-	return c + 1;
-      case TO1:
-	switch (cce->delta)
-	  {
-	  case EVENCAP:
-	    if (!(c & 1))
-	      return c + 1;
-	    break;
-	  case ODDCAP:
-	    if (c & 1)
-	      return c + 1;
-	    break;
-	  default:
-	    break;
-	  }
-	default:
-	  break;
-      }
-
-  return c;
+  return c + case_delta (c)->lower;
 }
 
 static wint_t touupper (wint_t c)
 {
-  const struct caseconv_entry * cce =
-    bisearch(c, caseconv_table,
-             sizeof(caseconv_table) / sizeof(*caseconv_table) - 1);
-
-  if (cce)
-    switch (cce->mode)
-      {
-      case TOUP:
-	return c + cce->delta;
-      case TOBOTH:
-	return c - 1;
-      case TO1:
-	switch (cce->delta)
-	  {
-	  case EVENCAP:
-	    if (c & 1)
-	      return c - 1;
-	    break;
-	  case ODDCAP:
-	    if (!(c & 1))
-	      return c - 1;
-	    break;
-	  default:
-	    break;
-	  }
-      default:
-	break;
-      }
-
-  return c;
+  return c + case_delta (c)->upper;
 }
 
 wint_t towctrans (wint_t c, wctrans_t w)
@@ -147,3 +63,57 @@ wint_t towctrans (wint_t c, wctrans_t w)
     errno = EINVAL;
   return c;
 }
+
+/*
+   towlower_n and towupper_n pack as many wide characters as fit into
+   uintptr_t. If all of them are ASCII, the letters first...last are marked
+   by the carries into bit 7 of each lane and get the case bit 0x20 flipped
+   with one XOR. A word with a non-ASCII character falls back to
+   the two-stage table lookup per character.
+ */
+
+typedef uintptr_t case_word;
+
+#define CASE_WORD_CHARS (sizeof (case_word) / sizeof (wchar_t))
+#define CASE_LANES ((case_word)~(case_word)0 \
+  / (case_word)(((unsigned long long)1 << (8 * sizeof (wchar_t))) - 1))
+#define CASE_NON_ASCII (~(CASE_LANES * 0x7F))
+
+static void
+case_n (wchar_t *dst, const wchar_t *src, size_t n, wchar_t first, wchar_t last,
+        wint_t (*conv) (wint_t))
+{
+  while (n >= CASE_WORD_CHARS)
+    {
+      case_word w;
+      memcpy (&w, src, sizeof (w));
+      if (!(w & CASE_NON_ASCII))
+	{
+	  case_word ge_first = w + CASE_LANES * (0x80 - first);
+	  case_word gt_last = w + CASE_LANES * (0x80 - last - 1);
+	  w ^= (ge_first & ~gt_last & (CASE_LANES * 0x80)) >> 2;
+	  memcpy (dst, &w, sizeof (w));
+	  src += CASE_WORD_CHARS;
+	  dst += CASE_WORD_CHARS;
+	}
+      else
+	{
+	  size_t i;
+	  for (i = 0; i < CASE_WORD_CHARS; ++i)
+	    *(dst++) = (wchar_t)conv ((wint_t)*(src++));
+	}
+      n -= CASE_WORD_CHARS;
+    }
+  for (; n; --n)
+    *(dst++) = (wchar_t)conv ((wint_t)*(src++));
+}
+
+void towlower_n (wchar_t *dst, const wchar_t *src, size_t n)
+{
+  case_n (dst, src, n, L'A', L'Z', toulower);
+}
+
+void towupper_n (wchar_t *dst, const wchar_t *src, size_t n)
+{
+  case_n (dst, src, n, L'a', L'z', touupper);
+}
@@ -0,0 +1,208 @@
+/// \file
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_ARRAYPARSER_H_
+#define NIRVANA_ARRAYPARSER_H_
+#pragma once
+
+#include "NirvanaBase.h"
+#include "errors.h"
+#include <stddef.h>
+#include <new>
+#include <vector>
+
+namespace Nirvana {
+
+/// Bulk parser of the delimited numeric text into the typed array.
+///
+/// Numbers are separated by white space and at most one delimiter character,
+/// so both "1 2 3" and "1, 2,\n3" are valid. One delimiter is also allowed before
+/// the first number and after the last one, so ", 1, 2," is parsed as "1 2",
+/// but ",," is an empty field and an error. Integers have the `strtol` syntax in base 10.
+/// Floating point values have the `strtod` syntax without the hexadecimal form
+/// and are correctly rounded.
+///
+/// The text is split into chunks at the separator boundaries, so a number never crosses
+/// the chunk boundary. The chunks are independent and may be parsed concurrently.
+/// The runtime library does not create threads itself, the chunk tasks are run by the
+/// executor supplied by the caller.
+///
+/// Instantiated for `int`, `long`, `long long`, their unsigned counterparts
+/// and the floating point types.
+class ArrayParser
+{
+public:
+	/// The text chunk.
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+		const char* error_pos; ///< Position of the erroneous number.
+		int error; ///< Zero, `EINVAL`, `ERANGE` or `ENOMEM`.
+	};
+
+	/// Minimal chunk size. Smaller text is not split.
+	static const size_t MIN_CHUNK_SIZE = 0x10000;
+
+	/// Split the text into chunks.
+	///
+	/// \param begin The text begin.
+	/// \param end The text end.
+	/// \param delim The delimiter character.
+	/// \param max_cnt Maximal number of chunks.
+	/// \param [out] chunks The chunks in the text order.
+	static void split (const char* begin, const char* end, char delim, size_t max_cnt,
+		std::vector <Chunk>& chunks);
+
+	/// Parse the text chunk.
+	///
+	/// The function is thread-safe and does not throw exceptions.
+	/// The numbers are appended to \p out.
+	/// On error, `chunk.error` and `chunk.error_pos` are set and \p out is left unchanged.
+	///
+	/// \tparam T The number type.
+	/// \param chunk The chunk.
+	/// \param delim The delimiter character.
+	/// \param [out] out The numbers.
+	/// \returns Zero on success or the error code.
+	template <typename T>
+	static int parse (Chunk& chunk, char delim, std::vector <T>& out) noexcept;
+
+	/// Parse the text.
+	///
+	/// The executor is called once as `exec (task_cnt, task)` and must call `task (i)`
+	/// for each `i` in [0, task_cnt), in any order and concurrently if possible,
+	/// and return after all tasks are completed.
+	///
+	/// \tparam T The number type.
+	/// \tparam Exec The executor type.
+	/// \param begin The text begin.
+	/// \param end The text end.
+	/// \param delim The delimiter character.
+	/// \param [out] out The numbers are appended to this vector. Unchanged on error.
+	/// \param max_chunks Maximal number of chunks, usually the hardware concurrency.
+	/// \param exec The executor.
+	/// \param [out] errptr Position of the erroneous number.
+	/// \returns Zero on success, `EINVAL` if the text contains invalid number,
+	///          `ERANGE` if the number is out of range or `ENOMEM`.
+	template <typename T, class Exec>
+	static int parse (const char* begin, const char* end, char delim, std::vector <T>& out,
+		size_t max_chunks, Exec&& exec, const char** errptr = nullptr);
+
+	/// Parse the text in the current thread.
+	///
+	/// \tparam T The number type.
+	/// \param begin The text begin.
+	/// \param end The text end.
+	/// \param delim The delimiter character.
+	/// \param [out] out The numbers are appended to this vector. Unchanged on error.
+	/// \param [out] errptr Position of the erroneous number.
+	/// \returns Zero on success or the error code.
+	template <typename T>
+	static int parse (const char* begin, const char* end, char delim, std::vector <T>& out,
+		const char** errptr = nullptr)
+	{
+		Chunk chunk { begin, end, nullptr, 0 };
+		int err = parse (chunk, delim, out);
+		if (err && errptr)
+			*errptr = chunk.error_pos;
+		return err;
+	}
+};
+
+template <typename T, class Exec>
+int ArrayParser::parse (const char* begin, const char* end, char delim, std::vector <T>& out,
+	size_t max_chunks, Exec&& exec, const char** errptr)
+{
+	std::vector <Chunk> chunks;
+	std::vector <std::vector <T> > parts;
+	try {
+		split (begin, end, delim, max_chunks, chunks);
+		parts.resize (chunks.size ());
+	} catch (const std::bad_alloc&) {
+		return ENOMEM;
+	}
+
+	auto task = [&chunks, &parts, delim] (size_t i) noexcept
+	{
+		parse (chunks [i], delim, parts [i]);
+	};
+	exec (chunks.size (), task);
+
+	size_t cnt = out.size ();
+	for (size_t i = 0; i < chunks.size (); ++i) {
+		const Chunk& chunk = chunks [i];
+		if (chunk.error) {
+			if (errptr)
+				*errptr = chunk.error_pos;
+			return chunk.error;
+		}
+		cnt += parts [i].size ();
+	}
+
+	size_t size = out.size ();
+	try {
+		out.reserve (cnt);
+		for (const auto& part : parts) {
+			out.insert (out.end (), part.begin (), part.end ());
+		}
+	} catch (const std::bad_alloc&) {
+		out.resize (size);
+		return ENOMEM;
+	}
+	return 0;
+}
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <int>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <unsigned int>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <long>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <unsigned long>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <long long>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <unsigned long long>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <float>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <double>& out) noexcept;
+
+extern template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <long double>& out) noexcept;
+
+}
+
+#endif
@@ -30,6 +30,7 @@
 
 #include <CORBA/CORBA.h>
 #include <assert.h>
+#include <string.h>
 
 namespace Nirvana {
 
@@ -38,6 +39,13 @@ class NIRVANA_NOVTABLE ByteOut
 public:
 	virtual void put (unsigned c) = 0;
 
+	/// Put multiple bytes.
+	/// The default implementation calls put () for each byte.
+	/// 
+	/// \param s The bytes.
+	/// \param len The number of bytes.
+	virtual void write (const char* s, size_t len);
+
 	virtual ~ByteOut ()
 	{}
 };
@@ -55,6 +63,12 @@ public:
 		*(p_++) = (char)c;
 	}
 
+	void write (const char* s, size_t len) override
+	{
+		memcpy (p_, s, len);
+		p_ += len;
+	}
+
 	char* cur_ptr () const noexcept
 	{
 		return p_;
@@ -76,6 +90,7 @@ public:
   }
 
 	void put (unsigned c) override;
+	void write (const char* s, size_t len) override;
 
 	size_t count () const noexcept
 	{
@@ -107,6 +122,11 @@ public:
 		container_.push_back ((char)c);
 	}
 
+	void write (const char* s, size_t len) override
+	{
+		container_.insert (container_.end (), s, s + len);
+	}
+
 private:
 	Cont& container_;
 };
@@ -116,6 +136,9 @@ class ByteOutNull : public ByteOut
 public:
 	void put (unsigned c) override
 	{}
+
+	void write (const char* s, size_t len) override
+	{}
 };
 
 }
@@ -0,0 +1,90 @@
+/// \file
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_DECIMALTOFLOAT_H_
+#define NIRVANA_DECIMALTOFLOAT_H_
+#pragma once
+
+#include <Nirvana/NirvanaBase.h>
+#include <stdint.h>
+
+namespace Nirvana {
+
+/// Correctly rounded conversion of the decimal value `significand * 10 ^ exponent`
+/// to `float` and `double`.
+///
+/// The conversion uses the Eisel-Lemire algorithm: the significand is multiplied by the
+/// 128-bit truncated power of 5 and the result is rounded to nearest, ties to even.
+/// For the exact 64-bit significand the 128-bit product is always sufficient
+/// (Noble Mushtak and Daniel Lemire, "Fast number parsing without fallback").
+class DecimalToFloat
+{
+public:
+	/// Convert the decimal value.
+	///
+	/// \param significand The decimal significand.
+	/// \param exponent The decimal exponent.
+	/// \param [out] ret The result. Overflow produces infinity, underflow produces zero.
+	static void convert (uint64_t significand, int exponent, double& ret) noexcept;
+
+	/// \copydoc convert(uint64_t,int,double&)
+	static void convert (uint64_t significand, int exponent, float& ret) noexcept;
+
+	/// Convert the value with truncated significand digits.
+	/// The exact value is between `significand * 10 ^ exponent` and
+	/// `(significand + 1) * 10 ^ exponent`.
+	///
+	/// \param significand The leading digits of the decimal significand.
+	/// \param exponent The decimal exponent.
+	/// \param [out] ret The result.
+	/// \returns `false` if the bounds are rounded to different values,
+	///          so the conversion must be done by the slow path.
+	template <typename F>
+	static bool convert_truncated (uint64_t significand, int exponent, F& ret) noexcept
+	{
+		F upper;
+		convert (significand, exponent, ret);
+		convert (significand + 1, exponent, upper);
+		return ret == upper;
+	}
+
+	/// Maximal number of significand digits which always fit in `uint64_t`.
+	static const unsigned SIGNIFICAND_DIGITS = 19;
+
+private:
+	template <class F>
+	static uint64_t compute (uint64_t w, int q) noexcept;
+
+	static const int POW5_MIN = -342;
+	static const int POW5_MAX = 308;
+
+	// Powers of 5 truncated to 128 bits: { low, high }.
+	static const uint64_t POW5_128 [POW5_MAX - POW5_MIN + 1][2];
+};
+
+}
+
+#endif
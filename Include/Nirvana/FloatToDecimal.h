@@ -0,0 +1,162 @@
+/// \file
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_FLOATTODECIMAL_H_
+#define NIRVANA_FLOATTODECIMAL_H_
+#pragma once
+
+#include <Nirvana/NirvanaBase.h>
+#include <stdint.h>
+#include <stddef.h>
+
+namespace Nirvana {
+
+/// Decimal representation of the `float` and `double` values.
+///
+/// The value is represented as significand () * 10 ^ exponent ().
+/// The conversion uses the integer-only Ryu algorithm by Ulf Adams.
+/// The sign of the value is ignored. The value must be finite.
+class FloatToDecimal
+{
+public:
+	/// Maximal length of the shortest representation string: "-2.2250738585072014e-308".
+	static const size_t SHORTEST_MAX = 24;
+
+	/// Obtain the leading decimal digits of the value.
+	/// At least 17 significant digits are obtained for the normal values, the rest is truncated.
+	///
+	/// \param value The value.
+	explicit FloatToDecimal (double value) noexcept;
+
+	/// Shortest decimal representation which is read back to the same value.
+	/// If there are several such representations, the closest to the value is chosen.
+	///
+	/// \param value The value.
+	static FloatToDecimal shortest (double value) noexcept;
+
+	/// \copydoc shortest(double)
+	static FloatToDecimal shortest (float value) noexcept;
+
+	/// Round to the decimal position, half to even.
+	///
+	/// \param pos The decimal exponent of the last digit to keep.
+	/// \returns `false` if the digits at the position are unknown and the value can not be rounded.
+	bool round (int pos) noexcept;
+
+	/// \returns The decimal significand.
+	uint64_t significand () const noexcept
+	{
+		return significand_;
+	}
+
+	/// \returns The decimal exponent of the last significand digit.
+	int exponent () const noexcept
+	{
+		return exponent_;
+	}
+
+	/// \returns The number of digits in the significand.
+	unsigned digits () const noexcept
+	{
+		return digits (significand_);
+	}
+
+	/// \returns The decimal exponent of the first significand digit.
+	int magnitude () const noexcept
+	{
+		return exponent_ + (int)digits () - 1;
+	}
+
+	/// Write the shortest representation in the fixed or the scientific notation,
+	/// whichever is shorter. Infinity and NaN are written as "inf" and "nan".
+	///
+	/// \param value The value.
+	/// \param buf The buffer of at least SHORTEST_MAX characters.
+	/// \returns The end of the string. Terminating zero is not written.
+	static char* to_chars (double value, char* buf) noexcept;
+
+	/// \copydoc to_chars(double,char*)
+	static char* to_chars (float value, char* buf) noexcept;
+
+	/// \returns The number of decimal digits in the unsigned value.
+	static unsigned digits (uint64_t u) noexcept;
+
+	/// Powers of 10 which fit in `uint64_t`.
+	static const uint64_t pow10_ [20];
+
+private:
+	FloatToDecimal () noexcept
+	{}
+
+	void truncated (uint64_t ieee_mantissa, unsigned ieee_exponent, unsigned mbits, int bias) noexcept;
+	void shortest (uint64_t ieee_mantissa, unsigned ieee_exponent, unsigned mbits, int bias) noexcept;
+
+	template <typename F>
+	static char* to_chars (F value, char* buf) noexcept;
+
+	static uint64_t mul_shift (uint64_t m, const uint64_t* mul, int j) noexcept;
+	static bool multiple_of_pow5 (uint64_t value, unsigned p) noexcept;
+
+	static bool multiple_of_pow2 (uint64_t value, unsigned p) noexcept
+	{
+		return !(value & (((uint64_t)1 << p) - 1));
+	}
+
+	// ceil (log2 (5^e)) for e > 0, 1 for e = 0.
+	static int pow5bits (int e) noexcept
+	{
+		return (int)(((unsigned)e * 1217359) >> 19) + 1;
+	}
+
+	// floor (log10 (2^e))
+	static unsigned log10_pow2 (int e) noexcept
+	{
+		return ((unsigned)e * 78913) >> 18;
+	}
+
+	// floor (log10 (5^e))
+	static unsigned log10_pow5 (int e) noexcept
+	{
+		return ((unsigned)e * 732923) >> 20;
+	}
+
+	static const int POW5_INV_BITCOUNT = 125;
+	static const int POW5_BITCOUNT = 125;
+
+	static const uint64_t POW5_INV_SPLIT [342][2];
+	static const uint64_t POW5_SPLIT [326][2];
+
+private:
+	uint64_t significand_;
+	int exponent_;
+
+	// All digits below the exponent are zeros.
+	bool exact_;
+};
+
+}
+
+#endif
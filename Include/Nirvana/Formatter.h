@@ -29,11 +29,157 @@
 #pragma once
 
 #include "Converter.h"
-
-struct lconv;
+#include "utf8.h"
+#include "Numpunct.h"
+#include <vector>
+#include <string>
 
 namespace Nirvana {
 
+/// Type-erased formatting argument.
+/// 
+/// Used by the type-safe formatting API instead of the C variable argument list.
+/// The argument references the original value, so it must not outlive the value.
+class FormatArg
+{
+public:
+	enum class Type : uint8_t
+	{
+		SIGNED,
+		UNSIGNED,
+		DOUBLE,
+		LONG_DOUBLE,
+		STRING,  ///< `char` string
+		WSTRING, ///< `wchar_t` string
+		POINTER,
+		OBJECT   ///< Object with `to_string ()` method
+	};
+
+	/// The string length is unknown, string is null-terminated.
+	static const size_t NPOS = ~(size_t)0;
+
+	template <typename I, typename std::enable_if <std::is_integral <I>::value
+		&& std::is_signed <I>::value, int>::type = 0>
+	FormatArg (I i) noexcept :
+		type_ (Type::SIGNED),
+		size_ (sizeof (I))
+	{
+		i_ = i;
+	}
+
+	template <typename U, typename std::enable_if <std::is_integral <U>::value
+		&& !std::is_signed <U>::value, int>::type = 0>
+	FormatArg (U u) noexcept :
+		type_ (Type::UNSIGNED),
+		size_ (sizeof (U))
+	{
+		u_ = u;
+	}
+
+	FormatArg (double d) noexcept :
+		type_ (Type::DOUBLE),
+		size_ (sizeof (double))
+	{
+		d_ = d;
+	}
+
+	FormatArg (float f) noexcept :
+		FormatArg ((double)f)
+	{}
+
+	FormatArg (long double ld) noexcept :
+		type_ (Type::LONG_DOUBLE),
+		size_ (sizeof (long double))
+	{
+		ld_ = ld;
+	}
+
+	FormatArg (const char* s, size_t len = NPOS) noexcept :
+		type_ (Type::STRING),
+		size_ (0)
+	{
+		str_.p = s;
+		str_.len = len;
+	}
+
+	FormatArg (const wchar_t* s, size_t len = NPOS) noexcept :
+		type_ (Type::WSTRING),
+		size_ (0)
+	{
+		str_.p = s;
+		str_.len = len;
+	}
+
+	FormatArg (const void* p) noexcept :
+		type_ (Type::POINTER),
+		size_ (0)
+	{
+		str_.p = p;
+		str_.len = 0;
+	}
+
+	/// Object with `to_string ()` method.
+	/// 
+	/// \param obj Object reference.
+	template <class T>
+	static FormatArg object (const T& obj) noexcept
+	{
+		return FormatArg (&obj, &obj_to_string <T>);
+	}
+
+	Type type () const noexcept
+	{
+		return type_;
+	}
+
+private:
+	friend class Formatter;
+
+	typedef void (*ToString) (const void* obj, std::string& s);
+
+	FormatArg (const void* obj, ToString to_string) noexcept :
+		type_ (Type::OBJECT),
+		size_ (0)
+	{
+		obj_.p = obj;
+		obj_.to_string = to_string;
+	}
+
+	template <class T>
+	static void obj_to_string (const void* obj, std::string& s)
+	{
+		s = reinterpret_cast <const T*> (obj)->to_string ();
+	}
+
+	long long int_value () const
+	{
+		if (type_ != Type::SIGNED && type_ != Type::UNSIGNED)
+			throw_BAD_PARAM (make_minor_errno (EINVAL));
+		return i_;
+	}
+
+private:
+	Type type_;
+	uint8_t size_;
+	union
+	{
+		long long i_;
+		unsigned long long u_;
+		double d_;
+		long double ld_;
+		struct
+		{
+			const void* p;
+			size_t len;
+		} str_;
+		struct
+		{
+			const void* p;
+			ToString to_string;
+		} obj_;
+	};
+};
+
 /// Universal formatter for C printf-like functions.
 class Formatter : private Converter
 {
@@ -43,10 +189,97 @@ public:
 	/// @param fmt Format stream.
 	/// @param args Arguments for formatting.
 	/// @param out Output stream for formatted output.
-	/// @param loc `struct lconv` pointer or nullptr.
+	/// @param num Numeric punctuation of the locale.
 	/// @returns The number of characters that would have been written if n had been sufficiently large, not counting the terminating null character.
 	///          If an encoding error occurs, a negative number is returned.
-	static size_t format (WideIn& fmt, va_list args, WideOut& out, const struct lconv* loc = nullptr);
+	static size_t format (WideIn& fmt, va_list args, WideOut& out, const Numpunct& num);
+
+	/// @brief Generalized C-style formatting function.
+	/// 
+	/// @param fmt Format stream.
+	/// @param args Arguments for formatting.
+	/// @param out Output stream for formatted output.
+	/// @param loc `struct lconv` pointer or nullptr.
+	/// @returns The number of characters written.
+	static size_t format (WideIn& fmt, va_list args, WideOut& out, const struct lconv* loc = nullptr)
+	{
+		return format (fmt, args, out, Numpunct (loc));
+	}
+
+	/// @brief Generalized C-style formatting function.
+	/// 
+	/// The UTF-8 format string is scanned directly, literal ASCII runs are copied to the output as is.
+	/// 
+	/// @param fmt Format string.
+	/// @param args Arguments for formatting.
+	/// @param out Output stream for formatted output.
+	/// @param num Numeric punctuation of the locale.
+	/// @returns The number of characters written.
+	static size_t format (const char* fmt, va_list args, WideOut& out, const Numpunct& num);
+
+	/// @brief Generalized C-style formatting function.
+	/// 
+	/// @param fmt Format string.
+	/// @param args Arguments for formatting.
+	/// @param out Output stream for formatted output.
+	/// @param loc `struct lconv` pointer or nullptr.
+	/// @returns The number of characters written.
+	static size_t format (const char* fmt, va_list args, WideOut& out, const struct lconv* loc = nullptr)
+	{
+		return format (fmt, args, out, Numpunct (loc));
+	}
+
+	/// @brief Generalized C-style formatting function.
+	/// 
+	/// @param fmt Format string.
+	/// @param args Arguments for formatting.
+	/// @param out Output stream for formatted output.
+	/// @param num Numeric punctuation of the locale.
+	/// @returns The number of characters written.
+	template <typename C>
+	static size_t format (const C* fmt, va_list args, WideOut& out, const Numpunct& num)
+	{
+		WideInStrT <C> in (fmt);
+		return format (static_cast <WideIn&> (in), args, out, num);
+	}
+
+	/// @brief Generalized C-style formatting function.
+	/// 
+	/// @param fmt Format string.
+	/// @param args Arguments for formatting.
+	/// @param out Output stream for formatted output.
+	/// @param loc `struct lconv` pointer or nullptr.
+	/// @returns The number of characters written.
+	template <typename C>
+	static size_t format (const C* fmt, va_list args, WideOut& out, const struct lconv* loc = nullptr)
+	{
+		return format (fmt, args, out, Numpunct (loc));
+	}
+
+	/// @brief Formatting with the type-erased arguments.
+	/// 
+	/// The argument types are used instead of the length modifiers in the format string.
+	/// 
+	/// @param fmt Format string.
+	/// @param args Arguments for formatting.
+	/// @param arg_cnt Number of arguments.
+	/// @param out Output stream for formatted output.
+	/// @param loc `struct lconv` pointer or nullptr.
+	/// @returns The number of characters written.
+	/// @throws BAD_PARAM The argument does not match the conversion specification.
+	static size_t format (const char* fmt, const FormatArg* args, size_t arg_cnt, WideOut& out,
+		const struct lconv* loc = nullptr);
+
+	class Compiled;
+
+	/// @brief Formatting with the precompiled format string.
+	/// 
+	/// @param fmt Compiled format.
+	/// @param args Arguments for formatting.
+	/// @param out Output stream for formatted output.
+	/// @param loc `struct lconv` pointer or nullptr.
+	/// @returns The number of characters written.
+	static size_t format (const Compiled& fmt, va_list args, WideOut& out, const struct lconv* loc = nullptr);
 
 	template <class Cont>
 	static size_t append_format_v (Cont& cont, const typename Cont::value_type* format, va_list arglist);
@@ -54,7 +287,69 @@ public:
 	template <class Cont>
 	static size_t append_format (Cont& cont, const typename Cont::value_type* format, ...);
 
+	template <class Cont>
+	static size_t append_format_v (Cont& cont, const Compiled& format, va_list arglist);
+
+	template <class Cont>
+	static size_t append_format (Cont& cont, const Compiled& format, ...);
+
+	/// @brief Formatting to the character buffer like `vsnprintf`.
+	/// 
+	/// @param buffer Output buffer.
+	/// @param bufsz Output buffer size.
+	/// @param format Compiled format.
+	/// @param arglist Arguments for formatting.
+	/// @returns The number of characters (not including the terminating null character) which would
+	///          have been written to buffer if bufsz was ignored.
+	template <typename C>
+	static size_t format_buf_v (C* buffer, size_t bufsz, const Compiled& format, va_list arglist);
+
+	template <typename C>
+	static size_t format_buf (C* buffer, size_t bufsz, const Compiled& format, ...);
+
 private:
+	// Conversion specification
+	struct Spec
+	{
+		unsigned flags;
+		unsigned width;
+		unsigned precision;
+		unsigned base; // Integer base or 0
+		int32_t conv;  // Conversion character
+	};
+
+	// Parse conversion specification after '%'.
+	// On return, fmt.cur () is the conversion character.
+	static void parse_spec (WideInEx& fmt, Spec& spec);
+
+	class VaArgs;
+	class PackArgs;
+
+	template <class Args>
+	static size_t format_str (const char* fmt, Args& args, WideOut& out, const Numpunct& num);
+
+	static void convert (Spec spec, VaArgs& args, WideOutEx& out, const Numpunct& num);
+	static void convert (Spec spec, PackArgs& args, WideOutEx& out, const Numpunct& num);
+
+	static void width_arg (Spec& spec, int w) noexcept;
+	static void precision_arg (Spec& spec, int p) noexcept;
+
+	static void put_char (int c, const Spec& spec, WideOutEx& out);
+
+	template <class C>
+	static void put_string (const C* p, const Spec& spec, WideOutEx& out);
+
+	template <class C>
+	static void put_string (const C* p, size_t len, const Spec& spec, WideOutEx& out);
+
+	static void put_pointer (const void* p, const Spec& spec, WideOutEx& out);
+
+	template <typename F>
+	static void put_float (F value, const Spec& spec, WideOutEx& out, const Numpunct& num);
+
+	static size_t str_len (const char* s, size_t max_len) noexcept;
+	static size_t str_len (const wchar_t* s, size_t max_len) noexcept;
+
 	static unsigned int_base (int c, unsigned& flags) noexcept
 	{
 		unsigned base = Converter::int_base (c, flags);
@@ -65,19 +360,39 @@ private:
 
 	static void out_rev (char* buf, size_t len, unsigned width, unsigned flags, WideOutEx& out, unsigned zeros = 0);
 
-	static size_t ntoa_format (char* buf, size_t len, size_t max_len, bool negative, unsigned base,
-		unsigned prec, unsigned width, unsigned flags) noexcept;
-
+	// The num is used for the thousands grouping.
 	template <typename U>
 	static void ntoa (U value, bool negative, unsigned base, unsigned prec, unsigned width,
-		unsigned flags, WideOutEx& out);
+		unsigned flags, WideOutEx& out, const Numpunct* num = nullptr);
 
 	template <typename U>
 	static void ntoa_impl (U value, bool negative, unsigned base, unsigned prec, unsigned width,
-		unsigned flags, WideOutEx& out);
+		unsigned flags, WideOutEx& out, const Numpunct* num);
+
+	// Output the whole part digits with the thousands separators.
+	static void put_grouped (const char* digits, size_t len, unsigned seps, const Numpunct& num,
+		WideOutEx& out);
+
+	/// Write digits of the unsigned value.
+	/// 
+	/// \param value The value.
+	/// \param buf The buffer of at least `sizeof (U) * 8` characters.
+	/// \param base The base.
+	/// \param flags The flags.
+	/// \returns The end of the digits.
+	template <typename U>
+	static char* u_to_buf (U value, char* buf, unsigned base, unsigned flags) noexcept;
 
+	// Number of digits in the unsigned value
 	template <typename U>
-	static char* u_to_buf (U value, char* buf, const char* end, unsigned base, unsigned flags) noexcept;
+	static unsigned u_len (U value, unsigned base) noexcept;
+
+	template <typename U>
+	static char* u_to_buf_div (U value, char* buf, unsigned base, unsigned flags) noexcept;
+
+	// Write digits in reverse order.
+	template <typename U>
+	static char* u_to_buf_rev (U value, char* buf, const char* end, unsigned base, unsigned flags) noexcept;
 
 	static char* whole_to_buf_16 (FloatMax whole, char* buf, const char* end, unsigned flags) noexcept;
 
@@ -94,31 +409,63 @@ private:
 
 	template <unsigned BASE>
 	static char* f_to_buf (const FloatMax& value, char* buf, const char* end, unsigned prec, unsigned flags,
-		const struct lconv* loc) noexcept;
+		const Numpunct& num) noexcept;
 
 	template <typename F>
 	static bool spec_val (const F& value, unsigned int width, unsigned int flags, WideOutEx& out);
 
 	template <typename F>
 	static void ftoa (F value, unsigned int prec, unsigned int width, unsigned int flags,
-		const struct lconv* loc, WideOutEx& out);
+		const Numpunct& num, WideOutEx& out);
 
 	static void ftoa_impl (FloatMax value, unsigned int prec, unsigned int width, unsigned int flags,
-		const struct lconv* loc, WideOutEx& out);
+		const Numpunct& num, WideOutEx& out);
+
+	static bool ftoa_fast (double value, unsigned int prec, unsigned int width, unsigned int flags,
+		const Numpunct& num, WideOutEx& out);
 
 	template <typename F>
 	static void etoa (F value, unsigned int prec, unsigned int width, unsigned int flags,
-		const struct lconv* loc, WideOutEx& out);
+		const Numpunct& num, WideOutEx& out);
 
 	static void etoa_impl (FloatMax value, int exp, unsigned int prec, unsigned int width, unsigned int flags,
-		const struct lconv* loc, WideOutEx& out);
+		const Numpunct& num, WideOutEx& out);
+
+	static bool etoa_fast (double value, unsigned int prec, unsigned int width, unsigned int flags,
+		const Numpunct& num, WideOutEx& out);
+
+	static char* fixed_to_buf (double value, unsigned prec, unsigned flags, const Numpunct& num,
+		char* buf, const char* end) noexcept;
+
+	static char* dec_to_buf (uint64_t significand, int exp, unsigned prec, unsigned flags,
+		const Numpunct& num, char* buf, const char* end) noexcept;
+
+	// whole is the begin of the whole part digits in the reversed buffer
+	// or nullptr for the exponential notation.
+	static void out_float (char* buf, const char* whole, char* p, const char* buf_end, bool negative,
+		unsigned width, unsigned flags, const Numpunct& num, WideOutEx& out, unsigned add_zeros = 0);
+
+	// Begin of the whole part in the reversed fixed notation buffer.
+	static char* whole_begin (char* buf, unsigned prec, unsigned flags, const Numpunct& num) noexcept
+	{
+		return buf + prec + ((prec || (flags & FLAG_HASH)) ? num.decimal_point_len () : 0);
+	}
 
 	template <typename F>
 	static void atoa (F value, unsigned int prec, unsigned int width, unsigned int flags,
-		const struct lconv* loc, WideOutEx& out);
+		const Numpunct& num, WideOutEx& out);
+
+	// Obtain the significand and the binary exponent from the IEEE 754 representation.
+	// The significand is normalized: bit at the returned position is 1 for the non-zero values.
+	// Returns the number of the fraction bits or 0 if the format is not supported.
+	static unsigned float_bits (double value, uint64_t& mant, int& exp) noexcept;
+	static unsigned float_bits (long double value, uint64_t& mant, int& exp) noexcept;
+
+	static void atoa_bits (bool negative, uint64_t mant, unsigned frac_bits, int exp, unsigned prec,
+		unsigned width, unsigned flags, const Numpunct& num, WideOutEx& out);
 
 	static void atoa_impl (FloatMax frac, int exp, unsigned int prec, unsigned int width, unsigned int flags,
-		const struct lconv* loc, WideOutEx& out);
+		const Numpunct& num, WideOutEx& out);
 
 	template <typename F>
 	static int get_exp_10 (const F& value) noexcept;
@@ -147,14 +494,19 @@ private:
 
 	static unsigned get_len (const char* buf, size_t len)
 	{
-		WideInBufUTF8 in (buf, buf + len);
-		unsigned cnt = 0;
-		while (in.get () != EOF)
-			++cnt;
-		return cnt;
+		size_t cnt = ascii_len (buf, len);
+		if (cnt < len) {
+			WideInBufUTF8 in (buf + cnt, buf + len);
+			while (in.get () != EOF)
+				++cnt;
+		}
+		return (unsigned)cnt;
 	}
 
-	static char* dec_pt_to_buf (const struct lconv* loc, char* buf, const char* end, unsigned prec,
+	// Find the end of the literal text: '%' or the terminating zero.
+	static const char* literal_end (const char* p, bool& ascii) noexcept;
+
+	static char* dec_pt_to_buf (const Numpunct& num, char* buf, const char* end, unsigned prec,
 		unsigned flags) noexcept;
 
 	static char* sign_to_buf (char* buf, const char* end, bool negative, unsigned flags) noexcept;
@@ -178,8 +530,14 @@ private:
 	static const unsigned FLAG_HASH = 1 << 12;
 	static const unsigned FLAG_PRECISION = 1 << 13;
 	static const unsigned FLAG_ADAPT_EXP = 1 << 14;
+	static const unsigned FLAG_WIDTH_ARG = 1 << 15;
+	static const unsigned FLAG_PRECISION_ARG = 1 << 16;
+	static const unsigned FLAG_GROUPING = 1 << 17;
 
-	static const Flag flags_ [5];
+	static const Flag flags_ [6];
+
+	// Decimal digit pairs "00" to "99".
+	static const char digit_pairs_ [200];
 
 	// define the default floating point precision
 	// default: 6 digits
@@ -207,13 +565,58 @@ private:
 	static const Special special_values_ [SPEC_VAL_CNT];
 };
 
+/// Format string compiled once for the repeated use.
+/// 
+/// The format string is parsed and validated on construction.
+/// Literal text and conversion specifications are stored as a compact list of operations,
+/// so formatting does not parse the format string anymore.
+class Formatter::Compiled
+{
+public:
+	/// Compile format string.
+	/// 
+	/// @param format The format string.
+	/// @throws BAD_PARAM Invalid conversion specification.
+	template <typename C>
+	explicit Compiled (const C* format)
+	{
+		WideInStrT <C> fmt (format);
+		compile (fmt);
+	}
+
+	/// Compile format stream.
+	/// 
+	/// @param format The format stream.
+	/// @throws BAD_PARAM Invalid conversion specification.
+	explicit Compiled (WideIn& format)
+	{
+		compile (format);
+	}
+
+private:
+	friend class Formatter;
+
+	void compile (WideIn& fmt);
+
+	struct Op
+	{
+		uint32_t literal_len; // Length of the literal text before the conversion
+		bool ascii; // The literal text is in ascii_, otherwise in wide_
+		Spec spec; // spec.conv == 0 for the trailing literal
+	};
+
+	void add_literal (std::vector <int32_t>& literal, Op& op);
+
+	std::string ascii_;
+	std::vector <int32_t> wide_;
+	std::vector <Op> ops_;
+};
+
 template <class Cont>
 size_t Formatter::append_format_v (Cont& cont, const typename Cont::value_type* format, va_list arglist)
 {
-	typedef typename Cont::value_type CType;
-	WideInStrT <CType> fmt (format);
 	WideOutContainerT <Cont> out (cont);
-	return Formatter::format (fmt, arglist, out);
+	return Formatter::format (format, arglist, out);
 }
 
 template <class Cont>
@@ -226,6 +629,43 @@ size_t Formatter::append_format (Cont& cont, const typename Cont::value_type* fo
 	return cnt;
 }
 
+template <class Cont>
+size_t Formatter::append_format_v (Cont& cont, const Compiled& format, va_list arglist)
+{
+	WideOutContainerT <Cont> out (cont);
+	return Formatter::format (format, arglist, out);
+}
+
+template <class Cont>
+size_t Formatter::append_format (Cont& cont, const Compiled& format, ...)
+{
+	va_list arglist;
+	va_start (arglist, format);
+	size_t cnt = append_format_v (cont, format, arglist);
+	va_end (arglist);
+	return cnt;
+}
+
+template <typename C>
+size_t Formatter::format_buf_v (C* buffer, size_t bufsz, const Compiled& format, va_list arglist)
+{
+	WideOutBufT <C> out (buffer, bufsz ? buffer + bufsz - 1 : buffer);
+	Formatter::format (format, arglist, out);
+	if (bufsz)
+		*out.cur_ptr () = 0;
+	return out.count ();
+}
+
+template <typename C>
+size_t Formatter::format_buf (C* buffer, size_t bufsz, const Compiled& format, ...)
+{
+	va_list arglist;
+	va_start (arglist, format);
+	size_t cnt = format_buf_v (buffer, bufsz, format, arglist);
+	va_end (arglist);
+	return cnt;
+}
+
 }
 
 #endif
@@ -105,6 +105,12 @@
 #define NIRVANA_CONSTINIT
 #endif
 
+#ifdef NIRVANA_C20
+#define NIRVANA_CONSTEVAL consteval
+#else
+#define NIRVANA_CONSTEVAL constexpr
+#endif
+
 #ifdef _MSC_VER
 #define NIRVANA_NOINLINE __declspec (noinline)
 #else
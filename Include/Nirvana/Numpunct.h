@@ -0,0 +1,100 @@
+/// \file
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_NUMPUNCT_H_
+#define NIRVANA_NUMPUNCT_H_
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct lconv;
+
+namespace Nirvana {
+
+/// Numeric punctuation of the locale.
+///
+/// The compact copy of the decimal point, thousands separator and grouping from `struct lconv`.
+/// It is obtained once per locale, so the formatting does not query the locale for each conversion.
+class Numpunct
+{
+public:
+	/// Maximal length of the UTF-8 decimal point.
+	static const size_t DECIMAL_POINT_MAX = 4;
+
+	/// Maximal number of the group sizes.
+	static const size_t GROUPING_MAX = 8;
+
+	/// "C" locale punctuation: "." decimal point, no grouping.
+	Numpunct () noexcept;
+
+	/// \param loc `struct lconv` pointer or nullptr for the "C" locale.
+	explicit Numpunct (const struct lconv* loc) noexcept;
+
+	/// \returns Zero-terminated UTF-8 decimal point.
+	const char* decimal_point () const noexcept
+	{
+		return decimal_point_;
+	}
+
+	/// \returns The decimal point length in bytes.
+	size_t decimal_point_len () const noexcept
+	{
+		return decimal_point_len_;
+	}
+
+	/// \returns The thousands separator character.
+	int32_t thousands_sep () const noexcept
+	{
+		return thousands_sep_;
+	}
+
+	/// \returns `true` if the whole part digits are grouped.
+	bool grouping () const noexcept
+	{
+		return group_cnt_ != 0;
+	}
+
+	/// \returns The number of thousands separators in the whole part.
+	/// \param digits The number of digits in the whole part.
+	unsigned separators (unsigned digits) const noexcept;
+
+	/// \returns The number of digits to the right of the separator.
+	/// \param i The separator index, 0 is the rightmost separator.
+	unsigned separator_pos (unsigned i) const noexcept;
+
+private:
+	char decimal_point_ [DECIMAL_POINT_MAX + 1];
+	uint8_t decimal_point_len_;
+	uint8_t group_cnt_;
+	bool repeat_;
+	uint8_t groups_ [GROUPING_MAX];
+	int32_t thousands_sep_;
+};
+
+}
+
+#endif
@@ -30,6 +30,8 @@
 #pragma once
 
 #include "Converter.h"
+#include <vector>
+#include <algorithm>
 
 namespace Nirvana {
 
@@ -45,35 +47,91 @@ public:
 	/// @return `true` if all format specifiers were processed, otherwise `false`.
 	static bool parse (WideIn& in, WideIn& fmt, va_list args, size_t& count, const struct lconv* loc = nullptr);
 
+	class Compiled;
+
+	/// @brief Scan with the precompiled format string.
+	/// @param in    Input stream.
+	/// @param fmt   Compiled format.
+	/// @param args  Arguments to store scanned data.
+	/// @param count [out] Count of scanned fields.
+	/// @param loc   `struct lconv` pointer or nullptr.
+	/// @return `true` if all format specifiers were processed, otherwise `false`.
+	static bool parse (WideIn& in, const Compiled& fmt, va_list args, size_t& count,
+		const struct lconv* loc = nullptr);
+
+	/// @brief Scan the null-terminated string with the precompiled format string.
+	/// The string is read directly by pointer, without the virtual input stream.
+	/// @typeparam C Character type, `char` (UTF-8) or `wchar_t`.
+	/// @param buffer Input string.
+	/// @param fmt   Compiled format.
+	/// @param args  Arguments to store scanned data.
+	/// @param count [out] Count of scanned fields.
+	/// @param loc   `struct lconv` pointer or nullptr.
+	/// @return `true` if all format specifiers were processed, otherwise `false`.
+	template <typename C>
+	static bool parse (const C* buffer, const Compiled& fmt, va_list args, size_t& count,
+		const struct lconv* loc = nullptr);
+
 	template <typename C>
 	static size_t parse (const C* buffer, const C* format, ...);
 
+	template <typename C>
+	static size_t parse (const C* buffer, const Compiled& format, ...);
+
 private:
 	// Flags 0..7 are defined in Converter base class.
 	static const unsigned FLAG_NOASSIGN = 1 << 8;
 	static const unsigned FLAG_MALLOC = 1 << 9;
 
-	static void skip (WideInEx& in, int c);
+	class VaArgs;
+	template <typename C> class Cursor;
 
-	template <typename Int>
-	static void get_int (WideInEx& in, unsigned base, unsigned flags, va_list& args)
+	struct CharSet
 	{
-		Int v;
-		in.get_int (v, base);
-		if (!(flags & FLAG_NOASSIGN))
-			*va_arg (args, Int*) = v;
-	}
+		uint32_t ascii [4]; // Bit map of the ASCII characters
+		std::vector <int32_t> wide; // Sorted non-ASCII characters
+		bool inv;
+
+		bool acceptable (int32_t c) const noexcept
+		{
+			bool found;
+			if ((uint32_t)c < 0x80)
+				found = (ascii [c >> 5] >> (c & 31)) & 1;
+			else
+				found = std::binary_search (wide.begin (), wide.end (), c);
+			return found != inv;
+		}
+	};
+
+	template <class In>
+	static bool scan (In& in, const Compiled& fmt, VaArgs& args, size_t& count,
+		const struct lconv* loc);
+
+	template <class In>
+	static void skip (In& in, int c);
+
+	template <typename Int, class In>
+	static void get_int (In& in, unsigned base, unsigned flags, VaArgs& args);
+
+	template <typename F, class In>
+	static void get_float (In& in, unsigned flags, VaArgs& args, const struct lconv* loc);
 
-	struct CharSet;
+	template <class In>
+	static void get_char (In& in, unsigned width, WideOut& out, const CharSet* set = nullptr);
 
-	static void get_char (WideInEx& in, unsigned width, WideOut& out, const CharSet* set = nullptr);
+	template <typename C, class In>
+	static void get_char (In& in, unsigned width, unsigned flags, VaArgs& args);
 
 	template <typename C>
-	static void get_char (WideInEx& in, unsigned width, unsigned flags, va_list& args);
+	static void get_char (Cursor <C>& in, unsigned width, unsigned flags, VaArgs& args);
+
+	template <typename C, class In>
+	static void get_char (In& in, unsigned width, unsigned flags, const CharSet& set,
+		VaArgs& args);
 
 	template <typename C>
-	static void get_char (WideInEx& in, unsigned width, unsigned flags, const CharSet& set,
-		va_list& args);
+	static void get_char (Cursor <C>& in, unsigned width, unsigned flags, const CharSet& set,
+		VaArgs& args);
 
 	template <typename C> class BufMalloc;
 	static size_t size_alloc (size_t size_req) noexcept;
@@ -88,25 +146,111 @@ private:
 
 	template <typename C> class CharOut;	
 
+	template <typename C, class In>
+	static void get_string (In& in, unsigned width, unsigned flags, VaArgs& args);
+
 	template <typename C>
-	static void get_string (WideInEx& in, unsigned width, unsigned flags, va_list& args);
+	static void get_string (Cursor <C>& in, unsigned width, unsigned flags, VaArgs& args);
 
-	static void get_string (WideInEx& in, unsigned width, WideOut& out);
+	template <class In>
+	static void get_string (In& in, unsigned width, WideOut& out);
 };
 
+/// Scanf format string compiled once for the repeated use.
+/// 
+/// The format string is parsed on construction.
+/// Literal characters, white space and conversion specifications are stored as a list
+/// of operations, so scanning does not parse the format string anymore.
+/// An invalid conversion specification is stored as is and raises BAD_PARAM when the
+/// scanning reaches it, so the preceding conversions are performed and counted.
+class Parser::Compiled
+{
+public:
+	/// Empty format.
+	Compiled () noexcept
+	{}
+
+	/// Compile format string.
+	/// 
+	/// @param format The format string.
+	template <typename C>
+	explicit Compiled (const C* format)
+	{
+		WideInStrT <C> fmt (format);
+		compile (fmt);
+	}
+
+	/// Compile format stream.
+	/// 
+	/// @param format The format stream.
+	explicit Compiled (WideIn& format)
+	{
+		compile (format);
+	}
+
+private:
+	friend class Parser;
+
+	void compile (WideIn& fmt);
+	void add_invalid ();
+
+	enum OpType : uint8_t
+	{
+		LITERAL,  // Literal character
+		SPACE,    // White space
+		INTEGER,  // d i u o x X b B p
+		FLOAT,    // a A e E f F g G
+		COUNT,    // n
+		CHARS,    // c
+		STRING,   // s
+		CHAR_SET, // [
+		INVALID   // Invalid conversion specification
+	};
+
+	struct Op
+	{
+		OpType type;
+		int32_t c; // Literal character
+		unsigned flags;
+		unsigned width;
+		unsigned base; // Integer base or index in sets_ for CHAR_SET
+	};
+
+	std::vector <Op> ops_;
+	std::vector <CharSet> sets_;
+};
+
+extern template
+bool Parser::parse (const char* buffer, const Compiled& fmt, va_list args, size_t& count,
+	const struct lconv* loc);
+
+extern template
+bool Parser::parse (const wchar_t* buffer, const Compiled& fmt, va_list args, size_t& count,
+	const struct lconv* loc);
+
 template <typename C>
 size_t Parser::parse (const C* buffer, const C* format, ...)
 {
-	WideInStrT <C> in (buffer);
-	WideInStrT <C> fmt (format);
+	Compiled fmt (format);
+	va_list arglist;
+	va_start (arglist, format);
+	size_t cnt;
+	parse (buffer, fmt, arglist, cnt);
+	va_end (arglist);
+	return cnt;
+}
+
+template <typename C>
+size_t Parser::parse (const C* buffer, const Compiled& format, ...)
+{
 	va_list arglist;
 	va_start (arglist, format);
 	size_t cnt;
-	parse (in, fmt, arglist, cnt);
+	parse (buffer, format, arglist, cnt);
 	va_end (arglist);
 	return cnt;
 }
 
 }
 
-#endif
\ No newline at end of file
+#endif
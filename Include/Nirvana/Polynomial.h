@@ -62,6 +62,24 @@ public:
 		unsigned num_digits;
 	};
 
+	/// Obtain the leading digits of the decimal polynomial.
+	/// 
+	/// \param [in,out] exp On input, the decimal exponent as for to_float ().
+	///   On output, the decimal exponent of the last significand digit.
+	/// \param [out] significand Up to 19 leading decimal digits.
+	/// \returns `false` if some non-zero digits were truncated.
+	bool significand10 (int& exp, uint64_t& significand) const noexcept;
+
+	/// Correctly rounded conversion of the decimal polynomial.
+	/// Works with all the digits, so it is slow and intended only for the cases
+	/// when the leading digits can not decide the rounding.
+	/// 
+	/// \param exp The decimal exponent as for to_float ().
+	/// \param [out] ret The result.
+	/// \throws DATA_CONVERSION (ERANGE) on overflow.
+	template <typename F>
+	void to_float10 (int exp, F& ret) const;
+
 protected:
 	PolynomialBase () noexcept;
 	void add (const Part& part, const Part* end) noexcept;
@@ -78,8 +96,18 @@ protected:
 	Part* end_;
 	unsigned digits_;
 	bool overflow_;
+	bool truncated_;
 };
 
+extern template
+void PolynomialBase::to_float10 (int exp, float& ret) const;
+
+extern template
+void PolynomialBase::to_float10 (int exp, double& ret) const;
+
+extern template
+void PolynomialBase::to_float10 (int exp, long double& ret) const;
+
 template <unsigned BASE>
 class PolynomialBaseN : public PolynomialBase
 {
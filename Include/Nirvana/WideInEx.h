@@ -54,18 +54,76 @@ public:
 
 	int32_t skip_space ();
 
+	/// Read integer value.
+	/// Throws DATA_CONVERSION with ERANGE on overflow.
+	///
+	/// \tparam Int The integer type.
+	/// \param [out] ret The value.
+	/// \param base The numeric base 2..36 or 0 for the C syntax autodetection.
+	/// \returns The next character.
+	template <typename Int>
+	int32_t get_int (Int& ret, unsigned base)
+	{
+		bool overflow;
+		int32_t c = get_int (ret, base, overflow);
+		if (overflow)
+			throw_DATA_CONVERSION (make_minor_errno (ERANGE));
+		return c;
+	}
+
+	/// Read integer value.
+	/// On overflow the value is saturated like `strtol` does.
+	///
+	/// \tparam Int The integer type.
+	/// \param [out] ret The value.
+	/// \param base The numeric base 2..36 or 0 for the C syntax autodetection.
+	/// \param [out] overflow `true` if the value is out of range.
+	/// \returns The next character.
 	template <typename Int>
 	typename std::enable_if <std::is_signed <Int>::value, int32_t>::type
-		get_int (Int& ret, unsigned base);
+		get_int (Int& ret, unsigned base, bool& overflow);
 
 	template <typename U>
 		typename std::enable_if <std::is_unsigned <U>::value, int32_t>::type
-		get_int (U& ret, unsigned base)
+		get_int (U& ret, unsigned base, bool& overflow)
+	{
+		int32_t c = get_int (reinterpret_cast <typename std::make_signed <U>::type&> (ret), base,
+			overflow);
+		if (overflow)
+			ret = std::numeric_limits <U>::max ();
+		return c;
+	}
+
+	/// Read floating point value.
+	/// The decimal value is correctly rounded to `float` and `double` in most cases,
+	/// the rest is converted through FloatMax.
+	/// Throws DATA_CONVERSION with ERANGE on overflow, \p ret is set to the signed infinity.
+	/// 
+	/// \tparam F The floating point type.
+	/// \param [out] ret The value.
+	/// \param loc The locale or `nullptr` for the "C" locale.
+	/// \returns The next character.
+	template <typename F>
+	int32_t get_float (F& ret, const struct lconv* loc = nullptr)
 	{
-		return get_int (reinterpret_cast <std::make_signed <U>::type&> (ret), base);
+		bool overflow;
+		int32_t c = get_float (ret, loc, overflow);
+		if (overflow)
+			throw_DATA_CONVERSION (make_minor_errno (ERANGE));
+		return c;
 	}
 
-	int32_t get_float (FloatMax& ret, const struct lconv* loc = nullptr);
+	/// Read floating point value.
+	/// On overflow the value is saturated to the signed infinity like `strtod` does.
+	/// The whole number is consumed in any case.
+	/// 
+	/// \tparam F The floating point type.
+	/// \param [out] ret The value.
+	/// \param loc The locale or `nullptr` for the "C" locale.
+	/// \param [out] overflow `true` if the value is out of range.
+	/// \returns The next character.
+	template <typename F>
+	int32_t get_float (F& ret, const struct lconv* loc, bool& overflow);
 
 	bool get_digit (unsigned base, unsigned& d) const noexcept;
 
@@ -73,8 +131,8 @@ private:
 	template <typename Int>
 	Int get_int (unsigned base, Int min, typename std::make_unsigned <Int>::type max, int& result);
 
-	template <unsigned BASE>
-	int32_t get_float (FloatMax& ret, int32_t dec_pt, bool no_check);
+	template <unsigned BASE, typename F>
+	int32_t get_float (F& ret, int32_t dec_pt, bool no_check, bool& overflow);
 
 	static int32_t decimal_point (const struct lconv* loc);
 	bool is_inf ();
@@ -87,9 +145,18 @@ private:
 	int32_t cur_;
 };
 
+extern template
+int32_t WideInEx::get_float (float& ret, const struct lconv* loc, bool& overflow);
+
+extern template
+int32_t WideInEx::get_float (double& ret, const struct lconv* loc, bool& overflow);
+
+extern template
+int32_t WideInEx::get_float (long double& ret, const struct lconv* loc, bool& overflow);
+
 template <typename Int>
 typename std::enable_if <std::is_signed <Int>::value, int32_t>::type
-WideInEx::get_int (Int& ret, unsigned base)
+WideInEx::get_int (Int& ret, unsigned base, bool& overflow)
 {
 	using U = typename std::make_unsigned <Int>::type;
 	using W = typename std::conditional <(sizeof (Int) >= sizeof (Word)), Int, Word>::type;
@@ -99,11 +166,13 @@ WideInEx::get_int (Int& ret, unsigned base)
 	ret = 0;
 	int any;
 	ret = (Int)get_int <W> (base, min, max, any);
-	if (any < 0)
-		throw_DATA_CONVERSION (make_minor_errno (ERANGE));
-	else if (any == 0)
+	if (any == 0)
 		throw_DATA_CONVERSION (make_minor_errno (EINVAL));
 
+	overflow = any < 0;
+	if (overflow && ret != min)
+		ret = std::numeric_limits <Int>::max ();
+
 	return cur ();
 }
 
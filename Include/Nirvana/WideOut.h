@@ -31,6 +31,7 @@
 #include "ByteOut.h"
 #include <stdint.h>
 #include <limits>
+#include <algorithm>
 #include <Nirvana/nls.h>
 
 namespace Nirvana {
@@ -40,6 +41,21 @@ class NIRVANA_NOVTABLE WideOut
 public:
 	virtual void put (uint32_t wc) = 0;
 
+	/// Put ASCII characters.
+	/// The default implementation calls put () for each character.
+	/// 
+	/// \param s The characters. All characters must be less than 0x80.
+	/// \param len The number of characters.
+	virtual void put_ascii (const char* s, size_t len);
+
+	/// \returns `true` if the output is only counted and discarded.
+	/// The count-only stream accepts put_ascii (nullptr, len), so the formatter
+	/// may skip generation of the ASCII characters if it knows their count.
+	virtual bool count_only () const noexcept
+	{
+		return false;
+	}
+
 	virtual ~WideOut ()
 	{}
 };
@@ -57,6 +73,11 @@ public:
 		*(p_++) = (WC)c;
 	}
 
+	void put_ascii (const char* s, size_t len) override
+	{
+		p_ = std::copy (s, s + len, p_);
+	}
+
 	WC* cur_ptr () const noexcept
 	{
 		return p_;
@@ -89,6 +110,13 @@ public:
 		++count_;
 	}
 
+	void put_ascii (const char* s, size_t len) override
+	{
+		size_t room = end_ - p_;
+		p_ = std::copy (s, s + (len < room ? len : room), p_);
+		count_ += len;
+	}
+
 	size_t count () const noexcept
 	{
 		return count_;
@@ -122,6 +150,11 @@ public:
 		container_.push_back ((WC)wc);
 	}
 
+	void put_ascii (const char* s, size_t len) override
+	{
+		container_.insert (container_.end (), s, s + len);
+	}
+
 private:
 	Cont& container_;
 };
@@ -135,6 +168,11 @@ public:
 
 	void put (uint32_t wc) override;
 
+	void put_ascii (const char* s, size_t len) override
+	{
+		bytes_.write (s, len);
+	}
+
 protected:
 	ByteOut& bytes_;
 };
@@ -151,6 +189,7 @@ public:
 	{}
 
 	using WideOutUTF8::put;
+	using WideOutUTF8::put_ascii;
 };
 
 template <class Cont>
@@ -168,6 +207,7 @@ public:
 	{}
 
 	using WideOutUTF8::put;
+	using WideOutUTF8::put_ascii;
 };
 
 template <typename C>
@@ -185,6 +225,7 @@ public:
 	{}
 
 	using WideOutUTF8::put;
+	using WideOutUTF8::put_ascii;
 };
 
 template <typename C>
@@ -197,6 +238,7 @@ public:
 	WideOutCP (ByteOut& bytes, CodePage::_ptr_type cp) noexcept;
 
 	void put (uint32_t wc) override;
+	void put_ascii (const char* s, size_t len) override;
 
 private:
 	CodePage::_ref_type code_page_;
@@ -207,6 +249,54 @@ class WideOutNull : public WideOut
 public:
 	void put (uint32_t wc) override
 	{}
+
+	void put_ascii (const char* s, size_t len) override
+	{}
+
+	bool count_only () const noexcept override
+	{
+		return true;
+	}
+};
+
+/// Counts the output code units of type WC, UTF-8 bytes for `char`.
+/// 
+/// \tparam WC Character type.
+template <typename WC>
+class WideOutCount : public WideOut
+{
+public:
+	WideOutCount () noexcept :
+		count_ (0)
+	{}
+
+	void put (uint32_t wc) override
+	{
+		if (std::is_same <char, WC>::value)
+			count_ += wc < 0x80 ? 1 : (wc < 0x800 ? 2 : (wc < 0x10000 ? 3 : 4));
+		else if (std::numeric_limits <WC>::max () < wc)
+			throw_CODESET_INCOMPATIBLE (make_minor_errno (EILSEQ));
+		else
+			++count_;
+	}
+
+	void put_ascii (const char* s, size_t len) override
+	{
+		count_ += len;
+	}
+
+	bool count_only () const noexcept override
+	{
+		return true;
+	}
+
+	size_t count () const noexcept
+	{
+		return count_;
+	}
+
+private:
+	size_t count_;
 };
 
 class WideOutEx
@@ -216,6 +306,35 @@ public:
 
 	void put (uint32_t wc);
 
+	void put_ascii (const char* s, size_t len)
+	{
+		out_.put_ascii (s, len);
+		pos_ += len;
+	}
+
+	/// \returns `true` if the output is only counted.
+	bool count_only () const noexcept
+	{
+		return count_only_;
+	}
+
+	/// Count ASCII characters without output.
+	/// May be called only if count_only () returns `true`.
+	/// 
+	/// \param len The number of characters.
+	void skip_ascii (size_t len)
+	{
+		assert (count_only_);
+		out_.put_ascii (nullptr, len);
+		pos_ += len;
+	}
+
+	/// Put the ASCII character repeatedly.
+	/// 
+	/// \param c The character.
+	/// \param count The repeat count.
+	void fill (char c, size_t count);
+
 	size_t pos () const noexcept
 	{
 		return pos_;
@@ -224,6 +343,7 @@ public:
 private:
 	WideOut& out_;
 	size_t pos_;
+	bool count_only_;
 };
 
 class WideIn;
@@ -0,0 +1,218 @@
+/// \file
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_CHARCONV_H_
+#define NIRVANA_CHARCONV_H_
+#pragma once
+
+#include "strtoi.h"
+#include <assert.h>
+#include <system_error>
+
+namespace Nirvana {
+
+// Non-throwing, locale-independent conversions between numbers and strings.
+// The semantics are the same as for `std::from_chars` and `std::to_chars`.
+
+/// Floating point format.
+enum class chars_format
+{
+	scientific = 1,
+	fixed = 2,
+	hex = 4,
+	general = fixed | scientific
+};
+
+/// The result of from_chars ().
+struct from_chars_result
+{
+	/// Pointer past the last parsed character or the string begin if no conversion performed.
+	const char* ptr;
+
+	/// `std::errc::invalid_argument` if no conversion performed,
+	/// `std::errc::result_out_of_range` if the value is out of range.
+	std::errc ec;
+};
+
+/// The result of to_chars ().
+struct to_chars_result
+{
+	/// Pointer past the last written character or the buffer end on error.
+	char* ptr;
+
+	/// `std::errc::value_too_large` if the buffer is too small.
+	std::errc ec;
+};
+
+/// Parse integer.
+/// The white space, plus sign and base prefix are not allowed.
+/// The minus sign is allowed for the signed types only.
+///
+/// \tparam Int Integer type.
+/// \param first The string begin.
+/// \param last The string end.
+/// \param [out] value The value. Not changed on error.
+/// \param base The numeric base 2..36.
+/// \returns from_chars_result.
+template <typename Int>
+typename std::enable_if <std::is_integral <Int>::value && !std::is_same <Int, bool>::value,
+	from_chars_result>::type from_chars (const char* first, const char* last, Int& value,
+	int base = 10) noexcept
+{
+	using U = typename std::make_unsigned <Int>::type;
+
+	assert (2 <= base && base <= 36);
+
+	const char* p = first;
+	bool neg = false;
+	if (std::is_signed <Int>::value && p != last && *p == '-') {
+		neg = true;
+		++p;
+	}
+
+	uint64_t limit = (uint64_t)std::numeric_limits <Int>::max () + neg;
+	uint64_t u;
+	bool overflow;
+	const char* end = IntParser <char>::parse_unsigned (p, last, (unsigned)base, limit, u, overflow);
+	if (end == p)
+		return { first, std::errc::invalid_argument };
+	if (overflow)
+		return { end, std::errc::result_out_of_range };
+
+	value = (Int)(U)(neg ? 0 - u : u);
+	return { end, std::errc () };
+}
+
+/// Write unsigned integer.
+///
+/// \param first The buffer begin.
+/// \param last The buffer end.
+/// \param value The absolute value.
+/// \param neg Write the minus sign.
+/// \param base The numeric base 2..36.
+/// \returns to_chars_result.
+to_chars_result to_chars_unsigned (char* first, char* last, uint64_t value, bool neg,
+	unsigned base) noexcept;
+
+/// Write integer.
+/// The digits above 9 are written in lowercase.
+///
+/// \tparam Int Integer type.
+/// \param first The buffer begin.
+/// \param last The buffer end.
+/// \param value The value.
+/// \param base The numeric base 2..36.
+/// \returns to_chars_result.
+template <typename Int>
+typename std::enable_if <std::is_integral <Int>::value && !std::is_same <Int, bool>::value,
+	to_chars_result>::type to_chars (char* first, char* last, Int value, int base = 10) noexcept
+{
+	using U = typename std::make_unsigned <Int>::type;
+
+	assert (2 <= base && base <= 36);
+
+	bool neg = value < (Int)0;
+	// The magnitude is truncated to U, as the promotion of the short types makes it negative
+	return to_chars_unsigned (first, last, (uint64_t)(U)(neg ? (U)0 - (U)value : (U)value), neg,
+		(unsigned)base);
+}
+
+/// Parse floating point value.
+/// The white space, plus sign and hexadecimal prefix are not allowed.
+/// The `double` and `float` values are correctly rounded.
+///
+/// \param first The string begin.
+/// \param last The string end.
+/// \param [out] value The value. Not changed on error.
+/// \param fmt The allowed format.
+/// \returns from_chars_result. If the value overflows or underflows to zero,
+///          `ec` is `std::errc::result_out_of_range`.
+from_chars_result from_chars (const char* first, const char* last, double& value,
+	chars_format fmt = chars_format::general) noexcept;
+
+/// \copydoc from_chars(const char*,const char*,double&,chars_format)
+from_chars_result from_chars (const char* first, const char* last, float& value,
+	chars_format fmt = chars_format::general) noexcept;
+
+/// \copydoc from_chars(const char*,const char*,double&,chars_format)
+from_chars_result from_chars (const char* first, const char* last, long double& value,
+	chars_format fmt = chars_format::general) noexcept;
+
+/// Write the shortest representation which is read back to the same value,
+/// in the fixed or scientific notation, whichever is shorter.
+///
+/// `long double` values wider than `double` are written with
+/// `std::numeric_limits <long double>::max_digits10` significant digits.
+///
+/// \param first The buffer begin.
+/// \param last The buffer end.
+/// \param value The value.
+/// \returns to_chars_result.
+to_chars_result to_chars (char* first, char* last, double value) noexcept;
+
+/// \copydoc to_chars(char*,char*,double)
+to_chars_result to_chars (char* first, char* last, float value) noexcept;
+
+/// \copydoc to_chars(char*,char*,double)
+to_chars_result to_chars (char* first, char* last, long double value) noexcept;
+
+/// Write the shortest representation in the format.
+///
+/// \param first The buffer begin.
+/// \param last The buffer end.
+/// \param value The value.
+/// \param fmt The format. The hexadecimal format is written without "0x" prefix.
+/// \returns to_chars_result.
+to_chars_result to_chars (char* first, char* last, double value, chars_format fmt) noexcept;
+
+/// \copydoc to_chars(char*,char*,double,chars_format)
+to_chars_result to_chars (char* first, char* last, float value, chars_format fmt) noexcept;
+
+/// \copydoc to_chars(char*,char*,double,chars_format)
+to_chars_result to_chars (char* first, char* last, long double value, chars_format fmt) noexcept;
+
+/// Write the value with precision as `printf` does in the "C" locale.
+///
+/// \param first The buffer begin.
+/// \param last The buffer end.
+/// \param value The value.
+/// \param fmt The format. The hexadecimal format is written without "0x" prefix.
+/// \param precision The precision.
+/// \returns to_chars_result.
+to_chars_result to_chars (char* first, char* last, double value, chars_format fmt,
+	int precision) noexcept;
+
+/// \copydoc to_chars(char*,char*,double,chars_format,int)
+to_chars_result to_chars (char* first, char* last, float value, chars_format fmt,
+	int precision) noexcept;
+
+/// \copydoc to_chars(char*,char*,double,chars_format,int)
+to_chars_result to_chars (char* first, char* last, long double value, chars_format fmt,
+	int precision) noexcept;
+
+}
+
+#endif
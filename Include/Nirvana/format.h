@@ -0,0 +1,320 @@
+/// \file
+/// Type-safe formatting.
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#ifndef NIRVANA_FORMAT_H_
+#define NIRVANA_FORMAT_H_
+#pragma once
+
+#include "Formatter.h"
+#include <string>
+#include <utility>
+#ifdef NIRVANA_C17
+#include <string_view>
+#endif
+
+namespace Nirvana {
+
+/// Argument kinds for the format string checking.
+struct FormatArgKind
+{
+	static constexpr unsigned INTEGER = 1;
+	static constexpr unsigned FLOAT = 2;
+	static constexpr unsigned STRING = 4;
+	static constexpr unsigned POINTER = 8;
+};
+
+/// Formatting argument traits.
+/// 
+/// Specializations define the argument kind `KIND` and the `make ()` function
+/// returning the FormatArg.
+/// 
+/// \tparam T The decayed argument type.
+template <class T, class Enable = void>
+struct FormatArgTraits
+{
+	static constexpr unsigned KIND = 0; // Not supported
+};
+
+template <class T>
+struct FormatArgTraits <T, typename std::enable_if <std::is_integral <T>::value>::type>
+{
+	static constexpr unsigned KIND = FormatArgKind::INTEGER;
+
+	static FormatArg make (T v) noexcept
+	{
+		return FormatArg (v);
+	}
+};
+
+template <class T>
+struct FormatArgTraits <T, typename std::enable_if <std::is_floating_point <T>::value>::type>
+{
+	static constexpr unsigned KIND = FormatArgKind::FLOAT;
+
+	static FormatArg make (T v) noexcept
+	{
+		return FormatArg (v);
+	}
+};
+
+template <class T>
+struct FormatArgTraits <T*, void>
+{
+	using C = typename std::remove_cv <T>::type;
+
+	static constexpr unsigned KIND = (std::is_same <C, char>::value || std::is_same <C, wchar_t>::value) ?
+		(FormatArgKind::STRING | FormatArgKind::POINTER) : FormatArgKind::POINTER;
+
+	static FormatArg make (const T* p) noexcept
+	{
+		return FormatArg (p);
+	}
+};
+
+template <>
+struct FormatArgTraits <std::nullptr_t, void>
+{
+	static constexpr unsigned KIND = FormatArgKind::POINTER;
+
+	static FormatArg make (std::nullptr_t) noexcept
+	{
+		return FormatArg ((const void*)nullptr);
+	}
+};
+
+template <class C, class Tr, class A>
+struct FormatArgTraits <std::basic_string <C, Tr, A>, void>
+{
+	static constexpr unsigned KIND = (std::is_same <C, char>::value || std::is_same <C, wchar_t>::value) ?
+		FormatArgKind::STRING : 0;
+
+	static FormatArg make (const std::basic_string <C, Tr, A>& s) noexcept
+	{
+		return FormatArg (s.data (), s.size ());
+	}
+};
+
+#ifdef NIRVANA_C17
+
+template <class C, class Tr>
+struct FormatArgTraits <std::basic_string_view <C, Tr>, void>
+{
+	static constexpr unsigned KIND = (std::is_same <C, char>::value || std::is_same <C, wchar_t>::value) ?
+		FormatArgKind::STRING : 0;
+
+	static FormatArg make (std::basic_string_view <C, Tr> s) noexcept
+	{
+		return FormatArg (s.data (), s.size ());
+	}
+};
+
+#endif
+
+template <class T, class Enable = void>
+struct HasToString : std::false_type
+{};
+
+template <class T>
+struct HasToString <T, decltype ((void)std::declval <const T&> ().to_string ())> : std::true_type
+{};
+
+/// Objects with `std::string to_string () const` method, like Fixed and Decimal, are formatted as strings.
+template <class T>
+struct FormatArgTraits <T, typename std::enable_if <std::is_class <T>::value && HasToString <T>::value>::type>
+{
+	static constexpr unsigned KIND = FormatArgKind::STRING;
+
+	static FormatArg make (const T& obj) noexcept
+	{
+		return FormatArg::object (obj);
+	}
+};
+
+/// Format string checked against the argument types.
+/// 
+/// The format string uses the printf conversion specifications.
+/// Length modifiers are allowed but ignored, the argument types are used instead.
+/// `%n` is not supported.
+/// 
+/// In C++20 the format string is checked at compile time.
+/// In the earlier standards, the check is performed at run time and BAD_PARAM is thrown on error.
+/// 
+/// \tparam Args The decayed argument types.
+template <typename... Args>
+class FormatString
+{
+public:
+	template <size_t N>
+	NIRVANA_CONSTEVAL FormatString (const char (&fmt) [N]) :
+		str_ (fmt)
+	{
+		check (fmt);
+	}
+
+	const char* c_str () const noexcept
+	{
+		return str_;
+	}
+
+private:
+	static constexpr size_t ARG_CNT = sizeof... (Args);
+
+	static constexpr void check (const char* p)
+	{
+		size_t arg = 0;
+		while (*p) {
+			if (*(p++) != '%')
+				continue;
+			if (*p == '%') {
+				++p;
+				continue;
+			}
+
+			// flags
+			while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0' || *p == '\'')
+				++p;
+
+			// width
+			if (*p == '*') {
+				arg = next_arg (arg, FormatArgKind::INTEGER);
+				++p;
+			} else {
+				while ('0' <= *p && *p <= '9')
+					++p;
+			}
+
+			// precision
+			if (*p == '.') {
+				++p;
+				if (*p == '*') {
+					arg = next_arg (arg, FormatArgKind::INTEGER);
+					++p;
+				} else {
+					while ('0' <= *p && *p <= '9')
+						++p;
+				}
+			}
+
+			// length
+			while (*p == 'h' || *p == 'l' || *p == 'L' || *p == 'j' || *p == 'z' || *p == 't')
+				++p;
+
+			unsigned kind = 0;
+			switch (*(p++)) {
+				case 'd': case 'i': case 'u': case 'x': case 'X': case 'o': case 'b': case 'B': case 'c':
+					kind = FormatArgKind::INTEGER;
+					break;
+				case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+					kind = FormatArgKind::FLOAT;
+					break;
+				case 's':
+					kind = FormatArgKind::STRING;
+					break;
+				case 'p':
+					kind = FormatArgKind::POINTER;
+					break;
+				default:
+					invalid_format ();
+			}
+			arg = next_arg (arg, kind);
+		}
+		if (arg != ARG_CNT)
+			invalid_format (); // Too many arguments
+	}
+
+	static constexpr size_t next_arg (size_t arg, unsigned kind)
+	{
+		if (arg >= ARG_CNT) // Too few arguments
+			invalid_format ();
+		if (!(kinds_ [arg] & kind)) // The argument type does not match the conversion
+			invalid_format ();
+		return arg + 1;
+	}
+
+	// Not constexpr, so the call breaks the compile time evaluation.
+	NIRVANA_NORETURN static void invalid_format ()
+	{
+		throw_BAD_PARAM (make_minor_errno (EINVAL));
+	}
+
+	static constexpr unsigned kinds_ [ARG_CNT + 1] = { FormatArgTraits <Args>::KIND..., 0 };
+
+private:
+	const char* str_;
+};
+
+template <typename... Args>
+constexpr unsigned FormatString <Args...>::kinds_ [];
+
+/// Format string type for the argument types.
+template <typename... Args>
+using FormatStringT = FormatString <typename std::decay <Args>::type...>;
+
+/// Format to the WideOut stream.
+/// 
+/// \param out Output stream.
+/// \param fmt Format string.
+/// \param args Arguments.
+/// \returns The number of characters written.
+template <typename... Args>
+size_t format_to (WideOut& out, FormatStringT <Args...> fmt, const Args&... args)
+{
+	const FormatArg pack [sizeof... (Args) + 1] = {
+		FormatArgTraits <typename std::decay <Args>::type>::make (args)..., FormatArg (0) };
+	return Formatter::format (fmt.c_str (), pack, sizeof... (Args), out);
+}
+
+/// Append formatted output to the container.
+/// 
+/// \param cont The container: `std::basic_string` or `std::vector` of `char` or `wchar_t`.
+/// \param fmt Format string.
+/// \param args Arguments.
+/// \returns The number of characters written.
+template <class Cont, typename... Args>
+typename std::enable_if <!std::is_base_of <WideOut, Cont>::value, size_t>::type
+format_to (Cont& cont, FormatStringT <Args...> fmt, const Args&... args)
+{
+	WideOutContainerT <Cont> out (cont);
+	return format_to (static_cast <WideOut&> (out), fmt, args...);
+}
+
+/// Format to a string.
+/// 
+/// \param fmt Format string.
+/// \param args Arguments.
+/// \returns The formatted string.
+template <typename... Args>
+std::string format (FormatStringT <Args...> fmt, const Args&... args)
+{
+	std::string s;
+	format_to (s, fmt, args...);
+	return s;
+}
+
+}
+
+#endif
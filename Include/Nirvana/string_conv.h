@@ -32,23 +32,35 @@
 #include "WideOut.h"
 #include "basic_string.h"
 #include "throw_exception.h"
+#include "utf8.h"
 
 namespace Nirvana {
 
+/// Size of the intermediate buffer for the string conversions, in characters.
+const size_t STRING_CONV_BUF_SIZE = 256;
+
 /// Append UTF-8 to wide character container.
 /// 
+/// The wide characters are UTF-16 or UTF-32 depending on the character size.
+/// 
 /// \typeparam WCont Wide character container type.
 /// \param begin UTF-8 string begin.
 /// \param end UTF-8 string end.
 /// \param append_to Wide character container to append converted data.
+/// \throws CODESET_INCOMPATIBLE if the source is not valid UTF-8.
 template <class WCont>
 void append_wide (const char* begin, const char* end, WCont& append_to)
 {
+	using WC = typename WCont::value_type;
+
 	append_to.reserve (append_to.size () + (end - begin));
-	ByteInBuf bytes (begin, end);
-	WideInUTF8 in (bytes);
-	WideOutContainer <WCont> out (append_to);
-	copy (in, out);
+	WC buf [STRING_CONV_BUF_SIZE];
+	while (begin != end) {
+		WC* dst = buf;
+		if (!utf8_to_wide (begin, end, dst, buf + STRING_CONV_BUF_SIZE) || dst == buf)
+			throw_CODESET_INCOMPATIBLE (make_minor_errno (EILSEQ)); // Invalid or incomplete
+		append_to.insert (append_to.end (), buf, dst);
+	}
 }
 
 /// Append wide string to an UTF-8 container.
@@ -58,14 +70,18 @@ void append_wide (const char* begin, const char* end, WCont& append_to)
 /// \param begin Wide string begin.
 /// \param end Wide string end.
 /// \param append_to UTF-8 container to append converted data.
+/// \throws CODESET_INCOMPATIBLE if the wide string is not valid UTF-16 or UTF-32.
 template <typename WC, class U8Cont>
 void append_utf8 (const WC* begin, const WC* end, U8Cont& append_to)
 {
 	append_to.reserve (append_to.size () + (end - begin));
-	ByteOutContainer <U8Cont> bytes (append_to);
-	WideInBuf <WC> in (begin, end);
-	WideOutUTF8 out (bytes);
-	copy (in, out);
+	char buf [STRING_CONV_BUF_SIZE];
+	while (begin != end) {
+		char* dst = buf;
+		if (!wide_to_utf8 (begin, end, dst, buf + STRING_CONV_BUF_SIZE) || dst == buf)
+			throw_CODESET_INCOMPATIBLE (make_minor_errno (EILSEQ)); // Invalid or incomplete
+		append_to.insert (append_to.end (), buf, dst);
+	}
 }
 
 /// Append UTF-8 to wide container.
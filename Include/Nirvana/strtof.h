@@ -43,9 +43,7 @@ int strtof (const C* s, C** endptr, F& ret, const struct lconv* lconv =  nullptr
 	try {
 		WideInStrT <C> in_s (s);
 		WideInEx in (in_s);
-		FloatMax f;
-		in.get_float (f, lconv);
-		ret = (F)f;
+		in.get_float (ret, lconv);
 		pos = in.pos ();
 	} catch (const CORBA::SystemException& ex) {
 		ret = std::numeric_limits <F>::max ();
@@ -28,46 +28,144 @@
 #define NIRVANA_STRTOI_H_
 #pragma once
 
-#include "WideInEx.h"
+#include "NirvanaBase.h"
 #include "errors.h"
+#include <stdint.h>
+#include <type_traits>
+#include <limits>
 
 namespace Nirvana {
 
+/// Integer parser working directly on the character range.
+///
+/// The syntax is the same as for `strtol`: leading white space, optional sign,
+/// optional base prefix and digits. The parser does not throw exceptions,
+/// the overflow is reported by the flag.
+///
+/// \tparam C Character type. Instantiated for `char` and `wchar_t`.
+template <typename C>
+class IntParser
+{
+public:
+	/// Parse integer.
+	///
+	/// The semantics match WideInEx::get_int ().
+	/// Negative values are allowed for the unsigned types and are negated in the unsigned type.
+	/// The positive values of the signed types are limited by the maximal value of the
+	/// corresponding unsigned type, so "0xFFFFFFFF" is parsed to `int32_t` as -1.
+	///
+	/// \tparam Int Integer type.
+	/// \param begin The string begin.
+	/// \param end The string end or `nullptr` for the zero-terminated string.
+	/// \param base The numeric base 2..36 or 0 for the C syntax autodetection.
+	/// \param [out] ret The result. On overflow the result is saturated.
+	/// \param [out] overflow `true` if the value is out of range.
+	/// \returns Pointer past the last parsed character or \p begin if no digits found.
+	template <typename Int>
+	static const C* parse (const C* begin, const C* end, unsigned base, Int& ret, bool& overflow)
+		noexcept
+	{
+		using U = typename std::make_unsigned <Int>::type;
+		using S = typename std::make_signed <Int>::type;
+
+		bool neg;
+		uint64_t u;
+		const C* p = parse (begin, end, base,
+			(uint64_t)std::numeric_limits <S>::max () + 1,
+			(uint64_t)std::numeric_limits <U>::max (), neg, u, overflow);
+
+		if (overflow) {
+			if (std::is_signed <Int>::value)
+				ret = neg ? std::numeric_limits <Int>::min () : std::numeric_limits <Int>::max ();
+			else
+				ret = std::numeric_limits <Int>::max ();
+		} else
+			ret = (Int)(U)(neg ? 0 - u : u);
+
+		return p;
+	}
+
+	/// Parse integer.
+	///
+	/// \param begin The string begin.
+	/// \param end The string end or `nullptr` for the zero-terminated string.
+	/// \param base The numeric base 2..36 or 0 for the C syntax autodetection.
+	/// \param neg_limit The maximal absolute value of the negative number.
+	/// \param pos_limit The maximal value of the positive number.
+	/// \param [out] neg `true` if the minus sign is present.
+	/// \param [out] ret The absolute value.
+	/// \param [out] overflow `true` if the value exceeds the limit.
+	/// \returns Pointer past the last parsed character or \p begin if no digits found.
+	static const C* parse (const C* begin, const C* end, unsigned base,
+		uint64_t neg_limit, uint64_t pos_limit, bool& neg, uint64_t& ret, bool& overflow) noexcept;
+
+	/// Parse digits without white space, sign and base prefix.
+	///
+	/// \param begin The string begin.
+	/// \param end The string end or `nullptr` for the zero-terminated string.
+	/// \param base The numeric base 2..36.
+	/// \param limit The maximal value.
+	/// \param [out] ret The value.
+	/// \param [out] overflow `true` if the value exceeds the limit.
+	/// \returns Pointer past the last digit or \p begin if no digits found.
+	static const C* parse_unsigned (const C* begin, const C* end, unsigned base, uint64_t limit,
+		uint64_t& ret, bool& overflow) noexcept;
+
+private:
+	static unsigned digit (const C* p, const C* end) noexcept
+	{
+		if (p == end)
+			return 36;
+		auto c = *p;
+		if ('0' <= c && c <= '9')
+			return (unsigned)(c - '0');
+		else if ('a' <= c && c <= 'z')
+			return (unsigned)(c - 'a' + 10);
+		else if ('A' <= c && c <= 'Z')
+			return (unsigned)(c - 'A' + 10);
+		else
+			return 36;
+	}
+
+	static const C* parse_decimal (const C* p, const C* end, uint64_t limit, uint64_t& ret,
+		bool& overflow) noexcept;
+
+	static const C* parse_digits (const C* p, const C* end, unsigned base, uint64_t limit,
+		uint64_t& ret, bool& overflow) noexcept;
+};
+
+extern template class IntParser <char>;
+extern template class IntParser <wchar_t>;
+
+/// Convert string to integer.
+///
+/// \tparam C Character type.
+/// \tparam Int Integer type.
+/// \param s The zero-terminated string.
+/// \param [out] endptr Pointer past the last parsed character or \p s on error.
+/// \param base The numeric base 2..36 or 0 for the C syntax autodetection.
+/// \param [out] ret The result.
+/// \returns Zero on success, `EINVAL` if no conversion performed or `ERANGE` on overflow.
 template <typename C, typename Int> inline
 int strtoi (const C* s, C** endptr, int base, Int& ret) noexcept
 {
 	ret = 0;
 
-	WideInStrT <C> in_s (s);
-	int32_t last = EOF;
 	int err = 0;
-
-	try {
-		WideInEx in (in_s);
-		in.get_int (ret, base);
-		last = in.cur ();
-	} catch (const CORBA::SystemException& ex) {
-		err = get_minor_errno (ex.minor ());
-		if (ERANGE == err) {
-			if (std::is_signed <Int>::value) {
-				if (ret != std::numeric_limits <Int>::min ())
-					ret = std::numeric_limits <Int>::max ();
-			} else
-				ret = std::numeric_limits <Int>::max ();
-		}
+	const C* end = s;
+	if (base == 1 || base < 0 || base > 36)
+		err = EINVAL;
+	else {
+		bool overflow;
+		end = IntParser <C>::parse (s, nullptr, (unsigned)base, ret, overflow);
+		if (end == s)
+			err = EINVAL;
+		else if (overflow)
+			err = ERANGE;
 	}
 
-	if (endptr) {
-		const C* end;
-		if (err != 0 && err != ERANGE)
-			end = s;
-		else {
-			end = in_s.cur_ptr ();
-			if (last != EOF && end > s)
-				--end;
-		}
+	if (endptr)
 		*endptr = const_cast <C*> (end);
-	}
 
 	return err;
 }
@@ -34,11 +34,70 @@ namespace Nirvana {
 
 /// Check that UTF-8 string is valid.
 /// 
+/// Overlong sequences, surrogates and code points above U+10FFFF are invalid.
+/// 
 /// \param p String pointer.
 /// \param size String size.
 /// \returns `true` if \p p is valid UTF-8 string, `false` if not.
 bool is_valid_utf8 (const char* p, size_t size) noexcept;
 
+/// Convert UTF-8 to wide characters.
+/// 
+/// 2-byte characters are UTF-16, 4-byte characters are UTF-32.
+/// The conversion stops at the end of the source, before the character which does not fit
+/// into the destination, before an incomplete sequence at the end of the source,
+/// or at an invalid sequence.
+/// 
+/// \typeparam WC Wide character type.
+/// \param [in,out] src Source pointer. On return, points to the first unconverted octet.
+/// \param end Source end.
+/// \param [in,out] dst Destination pointer. On return, points after the last written character.
+/// \param dst_end Destination end.
+/// \returns `false` if \p src points to an invalid sequence.
+template <typename WC>
+bool utf8_to_wide (const char*& src, const char* end, WC*& dst, WC* dst_end) noexcept;
+
+extern template
+bool utf8_to_wide (const char*& src, const char* end, char16_t*& dst, char16_t* dst_end) noexcept;
+
+extern template
+bool utf8_to_wide (const char*& src, const char* end, char32_t*& dst, char32_t* dst_end) noexcept;
+
+extern template
+bool utf8_to_wide (const char*& src, const char* end, wchar_t*& dst, wchar_t* dst_end) noexcept;
+
+/// Convert wide characters to UTF-8.
+/// 
+/// 2-byte characters are UTF-16, 4-byte characters are UTF-32.
+/// The conversion stops at the end of the source, before the character which does not fit
+/// into the destination, before a high surrogate at the end of the source,
+/// or at an invalid character.
+/// 
+/// \typeparam WC Wide character type.
+/// \param [in,out] src Source pointer. On return, points to the first unconverted character.
+/// \param end Source end.
+/// \param [in,out] dst Destination pointer. On return, points after the last written octet.
+/// \param dst_end Destination end.
+/// \returns `false` if \p src points to an invalid character.
+template <typename WC>
+bool wide_to_utf8 (const WC*& src, const WC* end, char*& dst, char* dst_end) noexcept;
+
+extern template
+bool wide_to_utf8 (const char16_t*& src, const char16_t* end, char*& dst, char* dst_end) noexcept;
+
+extern template
+bool wide_to_utf8 (const char32_t*& src, const char32_t* end, char*& dst, char* dst_end) noexcept;
+
+extern template
+bool wide_to_utf8 (const wchar_t*& src, const wchar_t* end, char*& dst, char* dst_end) noexcept;
+
+/// Get length of the leading ASCII characters.
+/// 
+/// \param p String pointer.
+/// \param size String size.
+/// \returns The number of leading bytes less than 0x80.
+size_t ascii_len (const char* p, size_t size) noexcept;
+
 bool push_first (__Mbstate& mbs, int b) noexcept;
 bool push_next (__Mbstate& mbs, int b) noexcept;
 
@@ -0,0 +1,190 @@
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include <Nirvana/ArrayParser.h>
+#include <Nirvana/strtoi.h>
+#include <Nirvana/charconv.h>
+#include <type_traits>
+
+namespace Nirvana {
+
+namespace {
+
+inline bool is_space (char c) noexcept
+{
+	return c == ' ' || ('\t' <= c && c <= '\r');
+}
+
+inline bool is_separator (char c, char delim) noexcept
+{
+	return c == delim || is_space (c);
+}
+
+// Skip separators.
+// Returns `false` if more than one delimiter found, p points to the second delimiter.
+
+inline bool skip_separators (const char*& p, const char* end, char delim) noexcept
+{
+	bool delim_found = false;
+	for (; p != end; ++p) {
+		char c = *p;
+		if (c == delim) {
+			if (delim_found)
+				return false;
+			delim_found = true;
+		} else if (!is_space (c))
+			break;
+	}
+	return true;
+}
+
+template <typename T> inline
+const char* parse_number (const char* p, const char* end, T& v, int& err, std::true_type) noexcept
+{
+	bool overflow;
+	const char* num_end = IntParser <char>::parse (p, end, 10, v, overflow);
+	if (num_end == p)
+		err = EINVAL;
+	else if (overflow)
+		err = ERANGE;
+	return num_end;
+}
+
+template <typename T> inline
+const char* parse_number (const char* p, const char* end, T& v, int& err, std::false_type) noexcept
+{
+	// from_chars does not accept the plus sign
+	const char* s = p;
+	if ('+' == *s && end - s > 1 && '-' != s [1])
+		++s;
+
+	from_chars_result res = from_chars (s, end, v);
+	if (res.ec == std::errc::invalid_argument) {
+		err = EINVAL;
+		return p;
+	} else if (res.ec == std::errc::result_out_of_range)
+		err = ERANGE;
+	return res.ptr;
+}
+
+}
+
+void ArrayParser::split (const char* begin, const char* end, char delim, size_t max_cnt,
+	std::vector <Chunk>& chunks)
+{
+	size_t size = end - begin;
+	size_t cnt = std::min (max_cnt, size / MIN_CHUNK_SIZE);
+	if (!cnt)
+		cnt = 1;
+
+	chunks.clear ();
+	chunks.reserve (cnt);
+	const char* chunk_begin = begin;
+	for (size_t i = 1; i < cnt; ++i) {
+		const char* p = begin + size / cnt * i;
+		if (p <= chunk_begin)
+			continue;
+
+		// The chunk boundary is placed before the number, after the separators.
+		while (p != end && !is_separator (*p, delim)) {
+			++p;
+		}
+		while (p != end && is_separator (*p, delim)) {
+			++p;
+		}
+		if (p == end)
+			break;
+
+		chunks.push_back ({ chunk_begin, p, nullptr, 0 });
+		chunk_begin = p;
+	}
+	chunks.push_back ({ chunk_begin, end, nullptr, 0 });
+}
+
+template <typename T>
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <T>& out) noexcept
+{
+	const char* end = chunk.end;
+	const char* p = chunk.begin;
+	const size_t size = out.size ();
+	int err = 0;
+	try {
+		if (!skip_separators (p, end, delim))
+			err = EINVAL; // Empty field
+		while (!err && p != end) {
+			T v;
+			const char* num_end = parse_number (p, end, v, err, std::is_integral <T> ());
+			if (err)
+				break;
+			if (num_end != end && !is_separator (*num_end, delim)) {
+				err = EINVAL;
+				break;
+			}
+			out.push_back (v);
+			p = num_end;
+			if (!skip_separators (p, end, delim))
+				err = EINVAL;
+		}
+	} catch (...) {
+		err = ENOMEM;
+	}
+
+	// Do not leave a part of the array, as the concurrent parse does.
+	if (err)
+		out.resize (size);
+
+	chunk.error = err;
+	chunk.error_pos = err ? p : nullptr;
+	return err;
+}
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <int>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <unsigned int>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <long>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <unsigned long>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <long long>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <unsigned long long>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <float>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <double>& out) noexcept;
+
+template
+int ArrayParser::parse (Chunk& chunk, char delim, std::vector <long double>& out) noexcept;
+
+}
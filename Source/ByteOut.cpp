@@ -27,6 +27,13 @@
 
 namespace Nirvana {
 
+void ByteOut::write (const char* s, size_t len)
+{
+	for (const char* end = s + len; s != end; ++s) {
+		put ((unsigned char)*s);
+	}
+}
+
 void ByteOutBuf::put (unsigned c)
 {
 	assert (c <= 255);
@@ -35,4 +42,13 @@ void ByteOutBuf::put (unsigned c)
 	++count_;
 }
 
+void ByteOutBuf::write (const char* s, size_t len)
+{
+	size_t room = end_ - p_;
+	size_t cb = len < room ? len : room;
+	memcpy (p_, s, cb);
+	p_ += cb;
+	count_ += len;
+}
+
 }
@@ -30,19 +30,21 @@
 #include <cmath>
 #include <cfenv>
 #include <type_traits>
-#include <Nirvana/locale_defs.h>
 #include <Nirvana/FloatToBCD.h>
+#include <Nirvana/FloatToDecimal.h>
+#include <Nirvana/bitutils.h>
 
 #pragma float_control (precise, on)
 
 namespace Nirvana {
 
-const Formatter::Flag Formatter::flags_ [5] = {
+const Formatter::Flag Formatter::flags_ [6] = {
 	{ '-', FLAG_LEFT },
 	{ '+', FLAG_PLUS },
 	{ ' ', FLAG_SPACE },
 	{ '#', FLAG_HASH },
-	{ '0', FLAG_ZEROPAD }
+	{ '0', FLAG_ZEROPAD },
+	{ '\'', FLAG_GROUPING }
 };
 
 const Formatter::Special Formatter::special_values_ [SPEC_VAL_CNT] = {
@@ -52,10 +54,47 @@ const Formatter::Special Formatter::special_values_ [SPEC_VAL_CNT] = {
 	{ "-inf", "-INF", 4 }
 };
 
-size_t Formatter::format (WideIn& fmt0, va_list args, WideOut& out0, const struct lconv* loc)
+class Formatter::VaArgs
+{
+public:
+	VaArgs (va_list args) noexcept
+	{
+		va_copy (ap, args);
+	}
+
+	~VaArgs ()
+	{
+		va_end (ap);
+	}
+
+	va_list ap;
+};
+
+class Formatter::PackArgs
+{
+public:
+	PackArgs (const FormatArg* args, size_t cnt) noexcept :
+		p_ (args),
+		end_ (args + cnt)
+	{}
+
+	const FormatArg& next ()
+	{
+		if (p_ == end_)
+			throw_BAD_PARAM (make_minor_errno (EINVAL));
+		return *(p_++);
+	}
+
+private:
+	const FormatArg* p_;
+	const FormatArg* end_;
+};
+
+size_t Formatter::format (WideIn& fmt0, va_list args, WideOut& out0, const Numpunct& num)
 {
 	WideInEx fmt (fmt0);
 	WideOutEx out (out0);
+	VaArgs ap (args);
 
 	for (int32_t c; (c = fmt.cur ()) != EOF;) {
 		if (c != '%') {
@@ -67,266 +106,738 @@ size_t Formatter::format (WideIn& fmt0, va_list args, WideOut& out0, const struc
 				fmt.next ();
 				out.put (c);
 			} else {
-				// flags
-				unsigned flags = 0;
-				for (;;) {
-					const Flag* p = flags_;
-					for (; p != std::end (flags_); ++p) {
-						if (p->cflag == c)
-							break;
-					}
-					if (p != std::end (flags_)) {
-						flags |= p->uflag;
-						c = fmt.next ();
-					} else
-						break;
-				}
+				Spec spec;
+				parse_spec (fmt, spec);
+				convert (spec, ap, out, num);
+				fmt.next ();
+			}
+		}
+	}
+	return out.pos ();
+}
 
-				// width
-				unsigned width = 0;
-				if (is_digit (c)) {
-					c = fmt.get_int (width, 10);
-				} else if (c == '*') {
-					width = va_arg (args, int);
-					c = fmt.next ();
-				}
+size_t Formatter::format (const char* fmt, va_list args, WideOut& out, const Numpunct& num)
+{
+	VaArgs ap (args);
+	return format_str (fmt, ap, out, num);
+}
 
-				// precision
-				unsigned precision = 0;
-				if (c == '.') {
-					flags |= FLAG_PRECISION;
-					c = fmt.next ();
-					if (is_digit (c)) {
-						c = fmt.get_int (precision, 10);
-					} else if (c == '*') {
-						precision = va_arg (args, int);
-						c = fmt.next ();
-					}
-				}
+size_t Formatter::format (const char* fmt, const FormatArg* args, size_t arg_cnt, WideOut& out,
+	const struct lconv* loc)
+{
+	PackArgs pack (args, arg_cnt);
+	return format_str (fmt, pack, out, Numpunct (loc));
+}
 
-				// length
-				flags |= length_flags (fmt);
-				c = fmt.cur ();
-
-				if (strchr (int_formats_, c)) {
-					// Integer format
-
-					unsigned base = int_base (c, flags);
-
-					// No plus or space flag for unsigned
-					if (!(flags & FLAG_SIGNED)) {
-						flags &= ~(FLAG_PLUS | FLAG_SPACE);
-					}
-
-					// ignore '0' flag when precision is given
-					if (flags & FLAG_PRECISION) {
-						flags &= ~FLAG_ZEROPAD;
-					}
-
-					if (flags & FLAG_SIGNED) {
-						// signed
-						if (flags & FLAG_LONG_LONG) {
-							const long long value = va_arg (args, long long);
-							ntoa ((unsigned long long)(value > 0 ? value : -value), value < 0, base, precision, width,
-								flags, out);
-						} else if (flags & FLAG_LONG) {
-							const long value = va_arg (args, long);
-							ntoa ((unsigned long)(value > 0 ? value : -value), value < 0, base, precision, width,
-								flags, out);
-						} else {
-							int value = va_arg (args, int);
-							if (flags & FLAG_CHAR)
-								value = (char)value;
-							else if (flags & FLAG_SHORT)
-								value = (short)value;
-							ntoa ((unsigned)(value > 0 ? value : -value), value < 0, base, precision, width,
-								flags, out);
-						}
-					} else {
-						// unsigned
-						if (flags & FLAG_LONG_LONG)
-							ntoa (va_arg (args, unsigned long long), false, base, precision, width, flags, out);
-						else if (flags & FLAG_LONG)
-							ntoa (va_arg (args, unsigned long), false, base, precision, width, flags, out);
-						else {
-							unsigned int value = va_arg (args, unsigned int);
-							if (flags & FLAG_CHAR)
-								value = (unsigned char)value;
-							else if (flags & FLAG_SHORT)
-								value = (unsigned short)value;
-							ntoa (value, false, base, precision, width, flags, out);
+template <class Args>
+size_t Formatter::format_str (const char* fmt, Args& args, WideOut& out0, const Numpunct& num)
+{
+	WideOutEx out (out0);
+
+	for (;;) {
+		bool ascii;
+		const char* end = literal_end (fmt, ascii);
+		if (ascii)
+			out.put_ascii (fmt, end - fmt);
+		else {
+			WideInBufUTF8 in (fmt, end);
+			for (int32_t c; (c = in.get ()) != EOF;) {
+				out.put (c);
+			}
+		}
+		fmt = end;
+		if (!*fmt)
+			break;
+
+		if (*++fmt == '%') {
+			out.put ('%');
+			++fmt;
+		} else {
+			WideInStrUTF8 in (fmt);
+			WideInEx spec_in (in);
+			Spec spec;
+			parse_spec (spec_in, spec);
+			// All characters of the valid conversion specification are ASCII
+			fmt += spec_in.pos () + 1;
+			convert (spec, args, out, num);
+		}
+	}
+	return out.pos ();
+}
+
+const char* Formatter::literal_end (const char* p, bool& ascii) noexcept
+{
+	const UWord ONES = ~(UWord)0 / 0xFF;
+	const UWord HIGH_BITS = ONES * 0x80;
+
+	unsigned high = 0;
+	for (; (uintptr_t)p % sizeof (UWord); ++p) {
+		char c = *p;
+		if (!c || c == '%') {
+			ascii = !(high & 0x80);
+			return p;
+		}
+		high |= (unsigned char)c;
+	}
+
+	// Skip words without zero, '%' and non-ASCII bytes.
+	// Aligned word never crosses the page boundary, so reading beyond the terminating zero is safe.
+	for (;;) {
+		UWord w = *(const UWord*)p;
+		if (((w - ONES) | ((w ^ (ONES * '%')) - ONES) | w) & HIGH_BITS)
+			break;
+		p += sizeof (UWord);
+	}
+
+	for (char c; (c = *p) && c != '%'; ++p) {
+		high |= (unsigned char)c;
+	}
+	ascii = !(high & 0x80);
+	return p;
+}
+
+size_t Formatter::format (const Compiled& fmt, va_list args, WideOut& out0, const struct lconv* loc)
+{
+	WideOutEx out (out0);
+	VaArgs ap (args);
+	const Numpunct num (loc);
+
+	const char* ascii = fmt.ascii_.data ();
+	const int32_t* wide = fmt.wide_.data ();
+	for (const Compiled::Op& op : fmt.ops_) {
+		if (op.ascii) {
+			out.put_ascii (ascii, op.literal_len);
+			ascii += op.literal_len;
+		} else {
+			for (const int32_t* end = wide + op.literal_len; wide != end; ++wide) {
+				out.put (*wide);
+			}
+		}
+		if (op.spec.conv)
+			convert (op.spec, ap, out, num);
+	}
+	return out.pos ();
+}
+
+void Formatter::parse_spec (WideInEx& fmt, Spec& spec)
+{
+	int32_t c = fmt.cur ();
+
+	// flags
+	unsigned flags = 0;
+	for (;;) {
+		const Flag* p = flags_;
+		for (; p != std::end (flags_); ++p) {
+			if (p->cflag == c)
+				break;
+		}
+		if (p != std::end (flags_)) {
+			flags |= p->uflag;
+			c = fmt.next ();
+		} else
+			break;
+	}
+
+	// width
+	spec.width = 0;
+	if (is_digit (c)) {
+		c = fmt.get_int (spec.width, 10);
+	} else if (c == '*') {
+		flags |= FLAG_WIDTH_ARG;
+		c = fmt.next ();
+	}
+
+	// precision
+	spec.precision = 0;
+	if (c == '.') {
+		flags |= FLAG_PRECISION;
+		c = fmt.next ();
+		if (is_digit (c)) {
+			c = fmt.get_int (spec.precision, 10);
+		} else if (c == '*') {
+			flags |= FLAG_PRECISION_ARG;
+			c = fmt.next ();
+		}
+	}
+
+	// length
+	flags |= length_flags (fmt);
+	c = fmt.cur ();
+
+	spec.base = 0;
+	if (c != EOF && strchr (int_formats_, c)) {
+		// Integer format
+
+		spec.base = int_base (c, flags);
+
+		// No plus or space flag for unsigned
+		if (!(flags & FLAG_SIGNED)) {
+			flags &= ~(FLAG_PLUS | FLAG_SPACE);
+		}
+
+		// ignore '0' flag when precision is given
+		if (flags & FLAG_PRECISION) {
+			flags &= ~FLAG_ZEROPAD;
+		}
+
+		// Thousands grouping is applied to the decimal conversions only
+		if (spec.base != 10)
+			flags &= ~FLAG_GROUPING;
+	} else {
+		switch (c) {
+			case 'F':
+			case 'A':
+				flags |= FLAG_UPPERCASE;
+				break;
+			case 'g':
+				flags |= FLAG_ADAPT_EXP;
+				break;
+			case 'G':
+				flags |= FLAG_ADAPT_EXP | FLAG_UPPERCASE;
+				break;
+			case 'E':
+				flags |= FLAG_UPPERCASE;
+				break;
+			case 'f':
+			case 'e':
+			case 'a':
+			case 'c':
+			case 's':
+			case 'n':
+			case 'p':
+				break;
+			default:
+				throw_BAD_PARAM (make_minor_errno (EILSEQ));
+		}
+
+		// Thousands grouping is applied to the fixed notation only
+		if (c != 'f' && c != 'F' && c != 'g' && c != 'G')
+			flags &= ~FLAG_GROUPING;
+	}
+
+	spec.flags = flags;
+	spec.conv = c;
+}
+
+void Formatter::width_arg (Spec& spec, int w) noexcept
+{
+	if (w < 0) {
+		// A negative width is taken as a '-' flag followed by a positive width
+		spec.flags |= FLAG_LEFT;
+		w = -w;
+	}
+	spec.width = w;
+}
+
+void Formatter::precision_arg (Spec& spec, int p) noexcept
+{
+	if (p < 0) {
+		// A negative precision is taken as if the precision were omitted
+		spec.flags &= ~FLAG_PRECISION;
+		p = 0;
+	} else if (spec.base)
+		spec.flags &= ~FLAG_ZEROPAD;
+	spec.precision = p;
+}
+
+void Formatter::convert (Spec spec, VaArgs& va, WideOutEx& out, const Numpunct& num)
+{
+	va_list& args = va.ap;
+
+	if (spec.flags & FLAG_WIDTH_ARG)
+		width_arg (spec, va_arg (args, int));
+
+	if (spec.flags & FLAG_PRECISION_ARG)
+		precision_arg (spec, va_arg (args, int));
+
+	unsigned flags = spec.flags;
+	unsigned width = spec.width;
+	unsigned precision = spec.precision;
+
+	if (spec.base) {
+		// Integer format
+		unsigned base = spec.base;
+		if (flags & FLAG_SIGNED) {
+			// signed
+			if (flags & FLAG_LONG_LONG) {
+				const long long value = va_arg (args, long long);
+				ntoa ((unsigned long long)(value > 0 ? value : -value), value < 0, base, precision, width,
+					flags, out, &num);
+			} else if (flags & FLAG_LONG) {
+				const long value = va_arg (args, long);
+				ntoa ((unsigned long)(value > 0 ? value : -value), value < 0, base, precision, width,
+					flags, out, &num);
+			} else {
+				int value = va_arg (args, int);
+				if (flags & FLAG_CHAR)
+					value = (char)value;
+				else if (flags & FLAG_SHORT)
+					value = (short)value;
+				ntoa ((unsigned)(value > 0 ? value : -value), value < 0, base, precision, width,
+					flags, out, &num);
+			}
+		} else {
+			// unsigned
+			if (flags & FLAG_LONG_LONG)
+				ntoa (va_arg (args, unsigned long long), false, base, precision, width, flags, out, &num);
+			else if (flags & FLAG_LONG)
+				ntoa (va_arg (args, unsigned long), false, base, precision, width, flags, out, &num);
+			else {
+				unsigned int value = va_arg (args, unsigned int);
+				if (flags & FLAG_CHAR)
+					value = (unsigned char)value;
+				else if (flags & FLAG_SHORT)
+					value = (unsigned short)value;
+				ntoa (value, false, base, precision, width, flags, out, &num);
+			}
+		}
+	} else {
+		switch (spec.conv) {
+			case 'c':
+				put_char (va_arg (args, int), spec, out);
+				break;
+			case 's':
+				if (flags & FLAG_LONG)
+					put_string (va_arg (args, wchar_t*), spec, out);
+				else
+					put_string (va_arg (args, char*), spec, out);
+				break;
+			case 'n':
+				*va_arg (args, int*) = (int)out.pos ();
+				break;
+			case 'p':
+				put_pointer (va_arg (args, void*), spec, out);
+				break;
+			default:
+				if (sizeof (long double) > sizeof (double) && (flags & FLAG_LONG_DOUBLE))
+					put_float (va_arg (args, long double), spec, out, num);
+				else
+					put_float (va_arg (args, double), spec, out, num);
+		}
+	}
+}
+
+void Formatter::convert (Spec spec, PackArgs& args, WideOutEx& out, const Numpunct& num)
+{
+	if (spec.flags & FLAG_WIDTH_ARG)
+		width_arg (spec, (int)args.next ().int_value ());
+
+	if (spec.flags & FLAG_PRECISION_ARG)
+		precision_arg (spec, (int)args.next ().int_value ());
+
+	const FormatArg& arg = args.next ();
+	bool ok = true;
+	switch (arg.type ()) {
+		case FormatArg::Type::SIGNED:
+		case FormatArg::Type::UNSIGNED:
+			if (spec.base) {
+				// The argument type defines the integer size, length modifiers are ignored.
+				unsigned long long u = arg.u_;
+				bool negative = false;
+				if (arg.type () == FormatArg::Type::SIGNED) {
+					if (spec.flags & FLAG_SIGNED) {
+						if (arg.i_ < 0) {
+							negative = true;
+							u = 0 - u;
 						}
-					}
-				} else {
-					switch (c) {
-						case 'F':
-							flags |= FLAG_UPPERCASE;
-#ifdef NIRVANA_C17
-							[[fallthrough]];
-#endif
-						case 'f':
-							if (sizeof (long double) > sizeof (double) && (flags & FLAG_LONG_DOUBLE))
-								ftoa (va_arg (args, long double), precision, width, flags, loc, out);
-							else
-								ftoa (va_arg (args, double), precision, width, flags, loc, out);
-							break;
-						case 'g':
-						case 'G':
-						case 'E':
-						case 'e':
-							if ((c == 'g') || (c == 'G'))
-								flags |= FLAG_ADAPT_EXP;
-							if ((c == 'E') || (c == 'G'))
-								flags |= FLAG_UPPERCASE;
-							if (sizeof (long double) > sizeof (double) && (flags & FLAG_LONG_DOUBLE))
-								etoa (va_arg (args, long double), precision, width, flags, loc, out);
-							else
-								etoa (va_arg (args, double), precision, width, flags, loc, out);
-							break;
-						case 'A':
-							flags |= FLAG_UPPERCASE;
-#ifdef NIRVANA_C17
-							[[fallthrough]];
-#endif
-						case 'a':
-							if (sizeof (long double) > sizeof (double) && (flags & FLAG_LONG_DOUBLE))
-								atoa (va_arg (args, long double), precision, width, flags, loc, out);
-							else
-								atoa (va_arg (args, double), precision, width, flags, loc, out);
-							break;
-						case 'c': {
-							// pre padding
-							if (!(flags & FLAG_LEFT)) {
-								for (unsigned l = 1; l < width; ++l) {
-									out.put (' ');
-								}
-							}
-							// char output
-							out.put (va_arg (args, int));
-
-							// post padding
-							if (flags & FLAG_LEFT) {
-								for (unsigned l = 1; l < width; ++l) {
-									out.put (' ');
-								}
-							}
-						} break;
-						case 's': {
-							if (flags & FLAG_LONG) {
-								const wchar_t* p = va_arg (args, wchar_t*);
-								unsigned l = (unsigned)wcsnlen (p, precision ?
-									precision : std::numeric_limits <size_t>::max ());
-								out_string (p, l, width, precision, flags, out);
-							} else {
-								const char* p = va_arg (args, char*);
-								unsigned l = (unsigned)strnlen (p, precision ?
-									precision : std::numeric_limits <size_t>::max ());
-								out_string (p, l, width, precision, flags, out);
-							}
-						} break;
-						case 'n':
-							*va_arg (args, int*) = (int)out.pos ();
-							break;
-						case 'p':
-							ntoa ((uintptr_t)va_arg (args, void*), false, 16, 2 + sizeof (void*) * 2, width,
-								FLAG_ZEROPAD | FLAG_HASH, out);
-							break;
-
-						default:
-							throw_BAD_PARAM (make_minor_errno (EILSEQ));
-					}
+					} else if (arg.size_ < sizeof (u))
+						u &= ((unsigned long long)1 << (arg.size_ * 8)) - 1;
 				}
+				ntoa (u, negative, spec.base, spec.precision, spec.width, spec.flags, out, &num);
+			} else if (spec.conv == 'c')
+				put_char ((int)arg.i_, spec, out);
+			else
+				ok = false;
+			break;
+
+		case FormatArg::Type::DOUBLE:
+		case FormatArg::Type::LONG_DOUBLE:
+			switch (spec.conv) {
+				case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+					if (arg.type () == FormatArg::Type::DOUBLE)
+						put_float (arg.d_, spec, out, num);
+					else
+						put_float (arg.ld_, spec, out, num);
+					break;
+				default:
+					ok = false;
+			}
+			break;
+
+		case FormatArg::Type::STRING:
+			if (spec.conv == 's') {
+				if (arg.str_.len == FormatArg::NPOS)
+					put_string ((const char*)arg.str_.p, spec, out);
+				else
+					put_string ((const char*)arg.str_.p, arg.str_.len, spec, out);
+			} else if (spec.conv == 'p')
+				put_pointer (arg.str_.p, spec, out);
+			else
+				ok = false;
+			break;
+
+		case FormatArg::Type::WSTRING:
+			if (spec.conv == 's') {
+				if (arg.str_.len == FormatArg::NPOS)
+					put_string ((const wchar_t*)arg.str_.p, spec, out);
+				else
+					put_string ((const wchar_t*)arg.str_.p, arg.str_.len, spec, out);
+			} else if (spec.conv == 'p')
+				put_pointer (arg.str_.p, spec, out);
+			else
+				ok = false;
+			break;
+
+		case FormatArg::Type::POINTER:
+			if (spec.conv == 'p')
+				put_pointer (arg.str_.p, spec, out);
+			else
+				ok = false;
+			break;
+
+		case FormatArg::Type::OBJECT:
+			if (spec.conv == 's') {
+				std::string s;
+				arg.obj_.to_string (arg.obj_.p, s);
+				put_string (s.data (), s.size (), spec, out);
+			} else
+				ok = false;
+			break;
+	}
+
+	if (!ok)
+		throw_BAD_PARAM (make_minor_errno (EINVAL));
+}
+
+void Formatter::put_char (int c, const Spec& spec, WideOutEx& out)
+{
+	out_buf_pre (1, spec.width, spec.flags & ~FLAG_ZEROPAD, out);
+	out.put (c);
+	out_buf_post (1, spec.width, spec.flags, out);
+}
+
+template <class C>
+void Formatter::put_string (const C* p, const Spec& spec, WideOutEx& out)
+{
+	// The string may be not null-terminated if the precision is specified
+	put_string (p, str_len (p, (spec.flags & FLAG_PRECISION) ?
+		spec.precision : std::numeric_limits <size_t>::max ()), spec, out);
+}
+
+template <class C>
+void Formatter::put_string (const C* p, size_t len, const Spec& spec, WideOutEx& out)
+{
+	out_string (p, (unsigned)len, spec.width, spec.precision, spec.flags, out);
+}
+
+size_t Formatter::str_len (const char* s, size_t max_len) noexcept
+{
+	return strnlen (s, max_len);
+}
+
+size_t Formatter::str_len (const wchar_t* s, size_t max_len) noexcept
+{
+	return wcsnlen (s, max_len);
+}
+
+void Formatter::put_pointer (const void* p, const Spec& spec, WideOutEx& out)
+{
+	ntoa ((uintptr_t)p, false, 16, sizeof (void*) * 2, spec.width, FLAG_HASH, out);
+}
+
+template <typename F>
+void Formatter::put_float (F value, const Spec& spec, WideOutEx& out, const Numpunct& num)
+{
+	switch (spec.conv) {
+		case 'f':
+		case 'F':
+			ftoa (value, spec.precision, spec.width, spec.flags, num, out);
+			break;
+		case 'a':
+		case 'A':
+			atoa (value, spec.precision, spec.width, spec.flags, num, out);
+			break;
+		default:
+			etoa (value, spec.precision, spec.width, spec.flags, num, out);
+	}
+}
+
+void Formatter::Compiled::compile (WideIn& fmt0)
+{
+	WideInEx fmt (fmt0);
+	std::vector <int32_t> literal;
+
+	for (int32_t c; (c = fmt.cur ()) != EOF;) {
+		if (c != '%') {
+			fmt.next ();
+			literal.push_back (c);
+		} else {
+			c = fmt.next ();
+			if (c == '%') {
+				fmt.next ();
+				literal.push_back (c);
+			} else {
+				Op op;
+				add_literal (literal, op);
+				parse_spec (fmt, op.spec);
+				ops_.push_back (op);
 				fmt.next ();
 			}
 		}
 	}
-	return (int)out.pos ();
+
+	if (!literal.empty ()) {
+		Op op;
+		add_literal (literal, op);
+		op.spec.conv = 0;
+		ops_.push_back (op);
+	}
+
+	ascii_.shrink_to_fit ();
+	wide_.shrink_to_fit ();
+	ops_.shrink_to_fit ();
+}
+
+void Formatter::Compiled::add_literal (std::vector <int32_t>& literal, Op& op)
+{
+	op.literal_len = (uint32_t)literal.size ();
+	op.ascii = std::all_of (literal.begin (), literal.end (), [] (int32_t c) { return 0 <= c && c < 0x80; });
+	if (op.ascii)
+		ascii_.insert (ascii_.end (), literal.begin (), literal.end ());
+	else
+		wide_.insert (wide_.end (), literal.begin (), literal.end ());
+	literal.clear ();
 }
 
 template <typename U> inline
 void Formatter::ntoa (U value, bool negative, unsigned base, unsigned prec, unsigned width,
-	unsigned flags, WideOutEx& out)
+	unsigned flags, WideOutEx& out, const Numpunct* num)
 {
 	ntoa_impl <typename std::conditional <(sizeof (U) >= sizeof (UWord)), U, UWord>::type> (value,
-		negative, base, prec, width, flags, out);
+		negative, base, prec, width, flags, out, num);
 }
 
 template <typename U>
 void Formatter::ntoa_impl (U value, bool negative, unsigned base, unsigned prec, unsigned width,
-	unsigned flags, WideOutEx& out)
+	unsigned flags, WideOutEx& out, const Numpunct* num)
 {
-	char buf [sizeof (value) * 8 + 4];
-	char* p = buf;
-
-	// no hash for 0 values
-	if (!value)
-		flags &= ~FLAG_HASH;
+	char digits [sizeof (value) * 8];
+	unsigned digits_len = 0;
 
 	// write if value is != 0 or precision is not specified
-	if (value || !(flags & FLAG_PRECISION))
-		p = u_to_buf (value, p, buf + sizeof (buf), base, flags);
+	if (value || !(flags & FLAG_PRECISION)) {
+		if (out.count_only ())
+			digits_len = u_len (value, base);
+		else
+			digits_len = (unsigned)(u_to_buf (value, digits, base, flags) - digits);
+	}
+
+	// Thousands separators
+	unsigned seps = 0;
+	if ((flags & FLAG_GROUPING) && num)
+		seps = num->separators (digits_len);
 
-	if (!value)
-		flags &= ~FLAG_HASH;
-	size_t len = p - buf;
-	len = ntoa_format (buf, len, sizeof (buf), negative, base, prec, width, flags);
-	out_rev (buf, len, width, flags, out);
+	// Sign and prefix
+	char prefix [3];
+	unsigned prefix_len = 0;
+	if (negative)
+		prefix [prefix_len++] = '-';
+	else if (flags & FLAG_PLUS)
+		prefix [prefix_len++] = '+';  // ignore the space if the '+' exists
+	else if (flags & FLAG_SPACE)
+		prefix [prefix_len++] = ' ';
+
+	// Leading zeros for the precision
+	unsigned zeros = prec > digits_len ? prec - digits_len : 0;
+
+	if (flags & FLAG_HASH) {
+		switch (base) {
+			case 16:
+				if (value) { // no prefix for 0 values
+					prefix [prefix_len++] = '0';
+					prefix [prefix_len++] = flags & FLAG_UPPERCASE ? 'X' : 'x';
+				}
+				break;
+			case 2:
+				if (value) {
+					prefix [prefix_len++] = '0';
+					prefix [prefix_len++] = flags & FLAG_UPPERCASE ? 'B' : 'b';
+				}
+				break;
+			case 8:
+				// Increase the precision to force the first digit to be zero
+				if (!zeros && (value || !digits_len))
+					zeros = 1;
+				break;
+		}
+	}
+
+	// Zero padding up to the width
+	unsigned len = prefix_len + zeros + digits_len + seps;
+	if ((flags & (FLAG_LEFT | FLAG_ZEROPAD)) == FLAG_ZEROPAD && len < width) {
+		zeros += width - len;
+		len = width;
+	}
+
+	if (out.count_only ()) {
+		// The separator may be not ASCII
+		out.skip_ascii ((len < width ? width : len) - seps);
+		for (unsigned i = 0; i < seps; ++i) {
+			out.put (num->thousands_sep ());
+		}
+		return;
+	}
+
+	out_buf_pre (len, width, flags & ~FLAG_ZEROPAD, out);
+	out.put_ascii (prefix, prefix_len);
+	out.fill ('0', zeros);
+	if (seps)
+		put_grouped (digits, digits_len, seps, *num, out);
+	else
+		out.put_ascii (digits, digits_len);
+	out_buf_post (len, width, flags, out);
+}
+
+void Formatter::put_grouped (const char* digits, size_t len, unsigned seps, const Numpunct& num,
+	WideOutEx& out)
+{
+	const char* p = digits;
+	for (unsigned i = seps; i > 0; --i) {
+		const char* sep = digits + len - num.separator_pos (i - 1);
+		out.put_ascii (p, sep - p);
+		out.put (num.thousands_sep ());
+		p = sep;
+	}
+	out.put_ascii (p, digits + len - p);
 }
 
+const char Formatter::digit_pairs_ [200] = {
+	'0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+	'1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+	'2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+	'3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+	'4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+	'5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+	'6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+	'7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+	'8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+	'9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
 template <typename U>
-char* Formatter::u_to_buf (U value, char* buf, const char* end, unsigned base, unsigned flags) noexcept
+char* Formatter::u_to_buf (U value, char* buf, unsigned base, unsigned flags) noexcept
 {
-	do {
-		assert (buf < end);
-		if (buf >= end)
+	// The digit count is calculated first, then the digits are written from the end.
+	char* end;
+	if (base == 10) {
+		end = buf + FloatToDecimal::digits (value);
+		char* p = end;
+		while (value >= 100) {
+			const char* pair = digit_pairs_ + (value % 100) * 2;
+			value /= 100;
+			*--p = pair [1];
+			*--p = pair [0];
+		}
+		if (value >= 10) {
+			const char* pair = digit_pairs_ + value * 2;
+			*--p = pair [1];
+			*--p = pair [0];
+		} else
+			*--p = (char)('0' + value);
+	} else {
+		unsigned shift;
+		switch (base) {
+			case 16:
+				shift = 4;
+				break;
+			case 8:
+				shift = 3;
+				break;
+			case 2:
+				shift = 1;
+				break;
+			default:
+				return u_to_buf_div (value, buf, base, flags);
+		}
+		const char* hex = flags & FLAG_UPPERCASE ? "0123456789ABCDEF" : "0123456789abcdef";
+		const unsigned bits = 64 - nlz ((uint64_t)value | 1);
+		end = buf + (bits + shift - 1) / shift;
+		const unsigned mask = base - 1;
+		for (char* p = end; p != buf;) {
+			*--p = hex [(unsigned)value & mask];
+			value >>= shift;
+		}
+	}
+	return end;
+}
+
+template <typename U>
+unsigned Formatter::u_len (U value, unsigned base) noexcept
+{
+	unsigned shift;
+	switch (base) {
+		case 10:
+			return FloatToDecimal::digits (value);
+		case 16:
+			shift = 4;
+			break;
+		case 8:
+			shift = 3;
+			break;
+		case 2:
+			shift = 1;
 			break;
+		default: {
+			unsigned len = 0;
+			do {
+				++len;
+				value /= base;
+			} while (value);
+			return len;
+		}
+	}
+	return (64 - nlz ((uint64_t)value | 1) + shift - 1) / shift;
+}
+
+template <typename U>
+char* Formatter::u_to_buf_div (U value, char* buf, unsigned base, unsigned flags) noexcept
+{
+	char* p = buf;
+	do {
 		unsigned digit = value % base;
-		*(buf++) = digit < 10 ? '0' + digit : (flags & FLAG_UPPERCASE ? 'A' : 'a') + digit - 10;
+		*(p++) = digit < 10 ? '0' + digit : (flags & FLAG_UPPERCASE ? 'A' : 'a') + digit - 10;
 		value /= base;
 	} while (value);
-
-	return buf;
+	std::reverse (buf, p);
+	return p;
 }
 
-size_t Formatter::ntoa_format (char* buf, size_t len, size_t max_len, bool negative, unsigned base,
-	unsigned prec, unsigned width, unsigned flags) noexcept
+template <typename U>
+char* Formatter::u_to_buf_rev (U value, char* buf, const char* end, unsigned base, unsigned flags) noexcept
 {
-  // Reserve place for sign
-  if (width && (negative || (flags & (FLAG_PLUS | FLAG_SPACE))))
-    width--;
-
-	// pad leading zeros
-  while ((len < prec) && (len < max_len)) {
-    buf [len++] = '0';
-  }
-	if ((flags & (FLAG_LEFT | FLAG_ZEROPAD)) == FLAG_ZEROPAD) {
-		while ((len < width) && (len < max_len)) {
-			buf [len++] = '0';
-		}
-	}
-
-	// handle hash
-	if ((flags & FLAG_HASH) && (base == 2U || base == 8U || base == 16U)) {
-		if (!(flags & FLAG_PRECISION) && len && ((len == prec) || (len == width))) {
-			len--;
-			if (len && (base == 16U)) {
-				len--;
-			}
-		}
-		if (len < max_len) {
-			if (base == 16U) {
-				buf [len++] = flags & FLAG_UPPERCASE ? 'X' : 'x';
-			} else if (base == 2U) {
-				buf [len++] = flags & FLAG_UPPERCASE ? 'B' : 'b';
-			}
-			if (len < max_len) {
-				buf [len++] = '0';
-			}
+	assert (buf + (base == 16 ? sizeof (U) * 2 : sizeof (U) * 8 / 3 + 1) <= end);
+	if (base == 10) {
+		while (value >= 100) {
+			const char* pair = digit_pairs_ + (value % 100) * 2;
+			value /= 100;
+			*(buf++) = pair [1];
+			*(buf++) = pair [0];
 		}
+		if (value >= 10) {
+			const char* pair = digit_pairs_ + value * 2;
+			*(buf++) = pair [1];
+			*(buf++) = pair [0];
+		} else
+			*(buf++) = (char)('0' + value);
+	} else {
+		assert (base == 16);
+		const char* hex = flags & FLAG_UPPERCASE ? "0123456789ABCDEF" : "0123456789abcdef";
+		do {
+			*(buf++) = hex [(unsigned)value & 0xF];
+			value >>= 4;
+		} while (value);
 	}
-
-	char* p = sign_to_buf (buf + len, buf + max_len, negative, flags);
-	return p - buf;
+	return buf;
 }
 
 char* Formatter::sign_to_buf (char* buf, const char* end, bool negative, unsigned flags) noexcept
@@ -363,7 +874,7 @@ bool Formatter::spec_val (const F& value, unsigned int width, unsigned int flags
 
 template <unsigned base> inline
 char* Formatter::f_to_buf (const FloatMax& value, char* p, const char* buf_end, unsigned prec, unsigned flags,
-	const struct lconv* loc) noexcept
+	const Numpunct& num) noexcept
 {
 	int rm = std::fegetround ();
 	std::fesetround (FE_TONEAREST);
@@ -391,7 +902,7 @@ char* Formatter::f_to_buf (const FloatMax& value, char* p, const char* buf_end,
 	}
 
 	// add decimal
-	p = dec_pt_to_buf (loc, p, buf_end, prec, flags);
+	p = dec_pt_to_buf (num, p, buf_end, prec, flags);
 
 	// Whole part
 	if (whole)
@@ -409,15 +920,196 @@ char* Formatter::f_to_buf (const FloatMax& value, char* p, const char* buf_end,
 
 template <typename F> inline
 void Formatter::ftoa (F value, unsigned int prec, unsigned int width, unsigned int flags,
-	const struct lconv* loc, WideOutEx& out)
+	const Numpunct& num, WideOutEx& out)
 {
 	// test for special values
-	if (!spec_val (value, width, flags, out))
-		ftoa_impl (value, prec, width, flags, loc, out);
+	if (!spec_val (value, width, flags, out)) {
+		// Use the integer conversion if the type is not wider than double
+		if (std::numeric_limits <F>::digits > std::numeric_limits <double>::digits
+			|| !ftoa_fast ((double)value, prec, width, flags, num, out))
+			ftoa_impl (value, prec, width, flags, num, out);
+	}
+}
+
+bool Formatter::ftoa_fast (double value, unsigned prec, unsigned width, unsigned flags,
+	const Numpunct& num, WideOutEx& out)
+{
+	if (!(flags & FLAG_PRECISION))
+		prec = PRINTF_DEFAULT_FLOAT_PRECISION;
+	else if (prec > FloatToBCD::MAX_PRECISION)
+		return false;
+
+	const size_t BUFFER_SIZE = 2 + FloatToBCD::MAX_DIGITS;
+	char buf [BUFFER_SIZE];
+	const char* const buf_end = buf + BUFFER_SIZE;
+
+	char* p = fixed_to_buf (value, prec, flags, num, buf, buf_end);
+	if (!p) {
+		FloatToDecimal dec (value);
+		if (!dec.round (-(int)prec))
+			return false;
+		p = dec_to_buf (dec.significand (), dec.exponent (), prec, flags, num, buf, buf_end);
+	}
+	out_float (buf, whole_begin (buf, prec, flags, num), p, buf_end, std::signbit (value), width, flags,
+		num, out);
+	return true;
+}
+
+char* Formatter::fixed_to_buf (double value, unsigned prec, unsigned flags, const Numpunct& num,
+	char* p, const char* end) noexcept
+{
+	// Exact conversion for the values with up to 60 fractional bits and the whole part in 64 bits.
+	static const int FRAC_BITS_MAX = 60;
+
+	uint64_t bits;
+	memcpy (&bits, &value, sizeof (bits));
+	int e2 = (int)((bits >> 52) & 0x7FF);
+	uint64_t m2 = bits & (((uint64_t)1 << 52) - 1);
+	if (e2) {
+		m2 |= (uint64_t)1 << 52;
+		e2 -= 1075;
+	} else
+		e2 = -1074;
+
+	uint64_t whole, frac;
+	unsigned frac_bits;
+	if (e2 >= 0) {
+		if (e2 > 11)
+			return nullptr;
+		whole = m2 << e2;
+		frac = 0;
+		frac_bits = 0;
+	} else if (-e2 <= FRAC_BITS_MAX) {
+		frac_bits = -e2;
+		whole = m2 >> frac_bits;
+		frac = m2 & (((uint64_t)1 << frac_bits) - 1);
+	} else
+		return nullptr;
+
+	// Fractional digits
+	char digits [FloatToBCD::MAX_PRECISION];
+	assert (prec <= std::size (digits));
+	const uint64_t frac_mask = ((uint64_t)1 << frac_bits) - 1;
+	for (unsigned i = 0; i < prec; ++i) {
+		frac *= 10;
+		digits [i] = (char)('0' + (frac >> frac_bits));
+		frac &= frac_mask;
+	}
+
+	// Round half to even
+	if (frac_bits) {
+		const uint64_t half = (uint64_t)1 << (frac_bits - 1);
+		bool odd = prec ? (digits [prec - 1] & 1) : (whole & 1);
+		if (frac > half || (frac == half && odd)) {
+			unsigned i = prec;
+			for (; i > 0; --i) {
+				if (digits [i - 1] != '9') {
+					++digits [i - 1];
+					break;
+				}
+				digits [i - 1] = '0';
+			}
+			if (!i)
+				++whole;
+		}
+	}
+
+	// Digits are written in reverse order.
+	assert (p + prec < end);
+	for (unsigned i = prec; i > 0; --i) {
+		*(p++) = digits [i - 1];
+	}
+
+	// add decimal
+	p = dec_pt_to_buf (num, p, end, prec, flags);
+
+	// Whole part
+	return u_to_buf_rev (whole, p, end, 10, 0);
+}
+
+char* Formatter::dec_to_buf (uint64_t significand, int exp, unsigned prec, unsigned flags,
+	const Numpunct& num, char* p, const char* end) noexcept
+{
+	// Value is significand * 10^exp, digits are written in reverse order.
+	assert (exp >= -(int)prec);
+
+	// Fractional part
+	if (prec > 0) {
+		unsigned zeros = exp >= 0 ? prec : prec + exp;
+		assert (p + prec <= end);
+		while (zeros--) {
+			*(p++) = '0';
+		}
+		for (int i = exp; i < 0; ++i) {
+			*(p++) = (char)('0' + significand % 10);
+			significand /= 10;
+		}
+	}
+
+	// add decimal
+	p = dec_pt_to_buf (num, p, end, prec, flags);
+
+	// Whole part
+	if (significand) {
+		for (int i = 0; i < exp && p < end; ++i) {
+			*(p++) = '0';
+		}
+		p = u_to_buf_rev (significand, p, end, 10, 0);
+	} else {
+		assert (p < end);
+		if (p < end)
+			*(p++) = '0';
+	}
+
+	return p;
+}
+
+void Formatter::out_float (char* buf, const char* whole, char* p, const char* buf_end, bool negative,
+	unsigned width, unsigned flags, const Numpunct& num, WideOutEx& out, unsigned add_zeros)
+{
+	// Thousands separators in the whole part
+	unsigned seps = 0;
+	if (whole && (flags & FLAG_GROUPING))
+		seps = num.separators ((unsigned)(p - whole));
+	const size_t whole_end = p - buf;
+
+	// pad leading zeros
+	if (!(flags & FLAG_LEFT) && (flags & FLAG_ZEROPAD)) {
+		if (width && (negative || (flags & (FLAG_PLUS | FLAG_SPACE)))) {
+			width--;
+		}
+		const char* pad_end = buf + (width > seps ? width - seps : 0);
+		assert (pad_end <= buf_end);
+		if (pad_end > buf_end)
+			pad_end = buf_end;
+		while (p < pad_end) {
+			*(p++) = '0';
+		}
+	}
+
+	p = sign_to_buf (p, buf_end, negative, flags);
+
+	if (!seps) {
+		out_rev (buf, p - buf, width, flags, out, add_zeros);
+		return;
+	}
+
+	// Sign and zeros, the grouped whole part, then the decimal point and the fractional part.
+	const size_t len = p - buf;
+	std::reverse (buf, p);
+	const char* digits = buf + len - whole_end;
+	const char* frac = buf + len - (whole - buf);
+	unsigned cnt = get_len (buf, len) + seps + add_zeros;
+
+	out_buf_pre (cnt, width, flags, out);
+	out.put_ascii (buf, digits - buf);
+	put_grouped (digits, frac - digits, seps, num, out);
+	out_buf (frac, p - frac, 0, flags, out, add_zeros);
+	out_buf_post (cnt, width, flags, out);
 }
 
 void Formatter::ftoa_impl (FloatMax value, unsigned prec, unsigned width, unsigned flags,
-	const struct lconv* loc, WideOutEx& out)
+	const Numpunct& num, WideOutEx& out)
 {
 	static const size_t MAX_PRECISION = FloatToBCD::MAX_PRECISION;
 
@@ -440,46 +1132,178 @@ void Formatter::ftoa_impl (FloatMax value, unsigned prec, unsigned width, unsign
 
 	// test for negative
 	bool negative = false;
-	if (value < 0) {
+	if (std::signbit (value)) {
 		negative = true;
 		value = -value;
 	}
 
-	p = f_to_buf <10> (value, p, buf_end, prec, flags, loc);
-
-	// pad leading zeros
-	if (!(flags & FLAG_LEFT) && (flags & FLAG_ZEROPAD)) {
-		if (width && (negative || (flags & (FLAG_PLUS | FLAG_SPACE)))) {
-			width--;
-		}
-		const char* pad_end = buf + width;
-		assert (pad_end <= buf_end);
-		if (pad_end > buf_end)
-			pad_end = buf_end;
-		while (p < pad_end) {
-			*(p++) = '0';
-		}
-	}
-
-	p = sign_to_buf (p, buf_end, negative, flags);
+	p = f_to_buf <10> (value, p, buf_end, prec, flags, num);
 
-	out_rev (buf, p - buf, width, flags, out, add_zeros);
+	out_float (buf, whole_begin (buf, prec, flags, num), p, buf_end, negative, width, flags, num, out,
+		add_zeros);
 }
 
 template <typename F> inline
 void Formatter::atoa (F value, unsigned int prec, unsigned int width, unsigned int flags,
-	const struct lconv* loc, WideOutEx& out)
+	const Numpunct& num, WideOutEx& out)
 {
 	// test for special values
 	if (!spec_val (value, width, flags, out)) {
+		uint64_t mant;
 		int exp;
-		F frac = std::frexp (value, &exp) * 2;
-		atoa_impl (frac, exp, prec, width, flags, loc, out);
+		unsigned frac_bits = float_bits (value, mant, exp);
+		if (frac_bits)
+			atoa_bits (std::signbit (value), mant, frac_bits, exp, prec, width, flags, num, out);
+		else {
+			F frac = std::frexp (value, &exp) * 2;
+			atoa_impl (frac, exp, prec, width, flags, num, out);
+		}
+	}
+}
+
+unsigned Formatter::float_bits (double value, uint64_t& mant, int& exp) noexcept
+{
+	static const unsigned FRAC_BITS = 52;
+
+	uint64_t bits;
+	memcpy (&bits, &value, sizeof (bits));
+	int e = (int)((bits >> FRAC_BITS) & 0x7FF);
+	mant = bits & (((uint64_t)1 << FRAC_BITS) - 1);
+	if (e) {
+		mant |= (uint64_t)1 << FRAC_BITS;
+		exp = e - 1023;
+	} else if (mant) {
+		// Subnormal, normalize
+		unsigned shift = nlz (mant) - (63 - FRAC_BITS);
+		mant <<= shift;
+		exp = -1022 - (int)shift;
+	} else
+		exp = 0;
+	return FRAC_BITS;
+}
+
+unsigned Formatter::float_bits (long double value, uint64_t& mant, int& exp) noexcept
+{
+	if (std::numeric_limits <long double>::digits == std::numeric_limits <double>::digits)
+		return float_bits ((double)value, mant, exp);
+
+	if (std::numeric_limits <long double>::digits == 64 && sizeof (long double) >= 10) {
+		// x87 extended precision, the integer bit is explicit
+		static const unsigned FRAC_BITS = 63;
+
+		uint16_t se;
+		memcpy (&mant, &value, sizeof (mant));
+		memcpy (&se, (const char*)&value + sizeof (mant), sizeof (se));
+		int e = se & 0x7FFF;
+		if (!mant)
+			exp = 0;
+		else if (e && (mant >> FRAC_BITS))
+			exp = e - 16383;
+		else {
+			// Subnormal, normalize
+			unsigned shift = nlz (mant);
+			mant <<= shift;
+			exp = (e ? e : 1) - 16383 - (int)shift;
+		}
+		return FRAC_BITS;
+	}
+
+	// Not supported, use frexp ()
+	return 0;
+}
+
+void Formatter::atoa_bits (bool negative, uint64_t mant, unsigned frac_bits, int exp, unsigned prec,
+	unsigned width, unsigned flags, const Numpunct& num, WideOutEx& out)
+{
+	// The leading digit is 1 for the normalized value and 0 for zero.
+	unsigned lead = (unsigned)(mant >> frac_bits);
+
+	// Fraction aligned to the hexadecimal digits
+	const unsigned frac_digits = (frac_bits + 3) / 4;
+	uint64_t frac = (mant & (((uint64_t)1 << frac_bits) - 1)) << (frac_digits * 4 - frac_bits);
+
+	// set default precision, if not set explicitly
+	unsigned add_zeros = 0;
+	if (!(flags & FLAG_PRECISION)) {
+		// The precision is sufficient for the exact representation
+		prec = frac_digits;
+		for (; prec && !(frac & 0xF); --prec) {
+			frac >>= 4;
+		}
+	} else if (prec > frac_digits) {
+		add_zeros = prec - frac_digits;
+		prec = frac_digits;
+	} else if (prec < frac_digits) {
+		// Round half to even
+		const unsigned drop = (frac_digits - prec) * 4;
+		uint64_t rem;
+		if (drop < 64) {
+			rem = frac & (((uint64_t)1 << drop) - 1);
+			frac >>= drop;
+		} else {
+			rem = frac;
+			frac = 0;
+		}
+		const uint64_t half = (uint64_t)1 << (drop - 1);
+		bool odd = prec ? (frac & 1) : (lead & 1);
+		if (rem > half || (rem == half && odd)) {
+			if (prec && (++frac >> (prec * 4)) == 0) {
+				// No carry to the leading digit
+			} else {
+				frac = 0;
+				++lead;
+			}
+		}
 	}
+
+	const char* hex = flags & FLAG_UPPERCASE ? "0123456789ABCDEF" : "0123456789abcdef";
+
+	char digits [16];
+	assert (prec <= std::size (digits));
+	for (unsigned i = prec; i > 0; --i) {
+		digits [i - 1] = hex [(unsigned)frac & 0xF];
+		frac >>= 4;
+	}
+
+	// Sign and prefix
+	char prefix [3];
+	unsigned prefix_len = 0;
+	if (negative)
+		prefix [prefix_len++] = '-';
+	else if (flags & FLAG_PLUS)
+		prefix [prefix_len++] = '+';
+	else if (flags & FLAG_SPACE)
+		prefix [prefix_len++] = ' ';
+	prefix [prefix_len++] = '0';
+	prefix [prefix_len++] = (flags & FLAG_UPPERCASE) ? 'X' : 'x';
+
+	// The exponent is written for the leading digit, without zero padding.
+	// WideInEx::get_float () reads it back with the same convention.
+	int pexp = mant ? exp : 0;
+	unsigned expwidth = 2 + u_len ((unsigned)(pexp < 0 ? -pexp : pexp), 10);
+
+	const bool dec_pt = prec || add_zeros || (flags & FLAG_HASH);
+	const unsigned len = prefix_len + 1 + (dec_pt ? 1 + prec + add_zeros : 0) + expwidth;
+	const bool zero_pad = (flags & (FLAG_LEFT | FLAG_ZEROPAD)) == FLAG_ZEROPAD;
+
+	if (!zero_pad)
+		out_buf_pre (len, width, flags, out);
+	out.put_ascii (prefix, prefix_len);
+	if (zero_pad && len < width)
+		out.fill ('0', width - len);
+	out.put_ascii (hex + lead, 1);
+	if (dec_pt) {
+		out_buf (num.decimal_point (), num.decimal_point_len (), 0, 0, out);
+		out.put_ascii (digits, prec);
+		out.fill ('0', add_zeros);
+	}
+	out.put ((flags & FLAG_UPPERCASE) ? 'P' : 'p');
+	out_exp (pexp, expwidth, out);
+	out_buf_post (len, width, flags, out);
 }
 
 void Formatter::atoa_impl (FloatMax frac, int exp, unsigned prec, unsigned width, unsigned flags,
-	const struct lconv* loc, WideOutEx& out)
+	const Numpunct& num, WideOutEx& out)
 {
 	static_assert (std::numeric_limits <FloatMax>::radix == 2, "Unexpected radix");
 	static const size_t MAX_PRECISION = (std::numeric_limits <FloatMax>::digits - 1 + 3) / 4;
@@ -512,7 +1336,7 @@ void Formatter::atoa_impl (FloatMax frac, int exp, unsigned prec, unsigned width
 
 	size_t begin = out.pos ();
 
-	p = f_to_buf <16> (frac, p, buf_end, prec, flags, loc);
+	p = f_to_buf <16> (frac, p, buf_end, prec, flags, num);
 
 	assert (p < buf_end);
 	if (p < buf_end)
@@ -523,10 +1347,12 @@ void Formatter::atoa_impl (FloatMax frac, int exp, unsigned prec, unsigned width
 
 	p = sign_to_buf (p, buf_end, negative, flags);
 
-	// Binary exponent may contain up to 4 digits
-	// expwidth is width of the exponent part: "p+00"
-	unsigned int expwidth = (-100 < exp && exp < 100) ? 4U :
-		((-1000 < exp && exp < 1000) ? 5U : 6U);
+	// std::frexp () returns the exponent for the fraction in range [0.5, 1)
+	if (frac)
+		--exp;
+
+	// expwidth is width of the exponent part: "p+0"
+	unsigned int expwidth = 2 + u_len ((unsigned)(exp < 0 ? -exp : exp), 10);
 
 	unsigned int fwidth = f_width (width, expwidth, flags);
 
@@ -541,24 +1367,17 @@ void Formatter::atoa_impl (FloatMax frac, int exp, unsigned prec, unsigned width
 		unsigned count = (unsigned)(out.pos () - begin);
 		while (count < width) {
 			out.put (' ');
+			++count;
 		}
 	}
 }
 
-char* Formatter::dec_pt_to_buf (const struct lconv* loc, char* buf, const char* end,
+char* Formatter::dec_pt_to_buf (const Numpunct& num, char* buf, const char* end,
 	unsigned prec, unsigned flags) noexcept
 {
 	if (prec > 0 || (flags & FLAG_HASH)) {
-		const char* dec_pt;
-		size_t dec_pt_len;
-		if (loc) {
-			dec_pt = loc->decimal_point;
-			dec_pt_len = strlen (dec_pt);
-		} else {
-			dec_pt = ".";
-			dec_pt_len = 1;
-		}
-
+		const char* dec_pt = num.decimal_point ();
+		size_t dec_pt_len = num.decimal_point_len ();
 		if ((buf + dec_pt_len) <= end)
 			buf = std::reverse_copy (dec_pt, dec_pt + dec_pt_len, buf);
 	}
@@ -581,22 +1400,113 @@ int Formatter::get_exp_10 (const F& value) noexcept
 
 template <typename F> inline
 void Formatter::etoa (F value, unsigned int prec, unsigned int width, unsigned int flags,
-	const struct lconv* loc, WideOutEx& out)
+	const Numpunct& num, WideOutEx& out)
 {
 	// test for special values
 	if (!spec_val (value, width, flags, out)) {
+		// Use the integer conversion if the type is not wider than double
+		if (std::numeric_limits <F>::digits <= std::numeric_limits <double>::digits
+			&& etoa_fast ((double)value, prec, width, flags, num, out))
+			return;
+
 		int exp = 0;
 		if (value)
 			exp = get_exp_10 (value);
-		etoa_impl (value, exp, prec, width, flags, loc, out);
+		etoa_impl (value, exp, prec, width, flags, num, out);
 	}
 }
 
+bool Formatter::etoa_fast (double value, unsigned prec, unsigned width, unsigned flags,
+	const Numpunct& num, WideOutEx& out)
+{
+	// default precision
+	if (!(flags & FLAG_PRECISION))
+		prec = PRINTF_DEFAULT_FLOAT_PRECISION;
+
+	// Number of significant digits
+	unsigned digits;
+	if (flags & FLAG_ADAPT_EXP)
+		digits = prec ? prec : 1;
+	else
+		digits = prec + 1;
+
+	if (digits > std::numeric_limits <double>::max_digits10)
+		return false;
+
+	FloatToDecimal dec (value);
+	int exp = 0;
+	if (value) {
+		if (!dec.round (dec.magnitude () - (int)digits + 1))
+			return false;
+		exp = dec.magnitude ();
+	}
+
+	uint64_t significand = dec.significand ();
+	int sig_exp = dec.exponent ();
+
+	// in "%g" mode, "prec" is the number of *significant figures* not decimals
+	bool fixed = false;
+	if (flags & FLAG_ADAPT_EXP) {
+		// do we want to fall-back to "%f" mode?
+		if ((int)digits > exp && exp >= -4) {
+			fixed = true;
+			prec = digits - 1 - exp;
+		} else
+			prec = digits - 1;
+
+		// Remove trailing zeros unless '#' is specified
+		if (!(flags & FLAG_HASH)) {
+			if (significand) {
+				while (!(significand % 10)) {
+					significand /= 10;
+					++sig_exp;
+				}
+				int last = fixed ? sig_exp : sig_exp - exp;
+				prec = last < 0 ? -last : 0;
+			} else {
+				sig_exp = 0;
+				prec = 0;
+			}
+		}
+	}
+
+	const size_t BUFFER_SIZE = 2 + FloatToBCD::MAX_DIGITS;
+	char buf [BUFFER_SIZE];
+	const char* const buf_end = buf + BUFFER_SIZE;
+	const bool negative = std::signbit (value);
+
+	if (fixed) {
+		char* p = dec_to_buf (significand, sig_exp, prec, flags, num, buf, buf_end);
+		out_float (buf, whole_begin (buf, prec, flags, num), p, buf_end, negative, width, flags, num, out);
+	} else {
+		// The exponent contains at least two digits, more digits are used only if necessary.
+		// expwidth is width of the exponent part: "e+00"
+		unsigned int expwidth = (-100 < exp && exp < 100) ? 4U : 5U;
+		unsigned int fwidth = f_width (width, expwidth, flags);
+
+		size_t begin = out.pos ();
+		char* p = dec_to_buf (significand, sig_exp - exp, prec, flags, num, buf, buf_end);
+		out_float (buf, nullptr, p, buf_end, negative, fwidth, flags, num, out);
+
+		// output the exponential symbol
+		out.put ((flags & FLAG_UPPERCASE) ? 'E' : 'e');
+		// output the exponent value
+		out_exp (exp, expwidth, out);
+		// might need to right-pad spaces
+		if (flags & FLAG_LEFT) {
+			for (unsigned count = (unsigned)(out.pos () - begin); count < width; ++count) {
+				out.put (' ');
+			}
+		}
+	}
+	return true;
+}
+
 void Formatter::etoa_impl (FloatMax value, int exp, unsigned prec, unsigned width, unsigned flags,
-	const struct lconv* loc, WideOutEx& out)
+	const Numpunct& num, WideOutEx& out)
 {
 	// determine the sign
-	const bool negative = value < 0;
+	const bool negative = std::signbit (value);
 	if (negative)
 		value = -value;
 
@@ -632,7 +1542,7 @@ void Formatter::etoa_impl (FloatMax value, int exp, unsigned prec, unsigned widt
 			exp = 0;
 		} else {
 			// we use one sigfig for the whole part
-			if ((prec > 0) && (flags & FLAG_PRECISION))
+			if (prec > 0)
 				--prec;
 		}
 	}
@@ -645,7 +1555,7 @@ void Formatter::etoa_impl (FloatMax value, int exp, unsigned prec, unsigned widt
 
 	// output the floating part
 	size_t begin = out.pos ();
-	ftoa_impl (negative ? -value : value, prec, fwidth, (flags & ~FLAG_ADAPT_EXP) | FLAG_PRECISION, loc, out);
+	ftoa_impl (negative ? -value : value, prec, fwidth, (flags & ~FLAG_ADAPT_EXP) | FLAG_PRECISION, num, out);
 
 	// output the exponent part
 	if (expwidth) {
@@ -658,6 +1568,7 @@ void Formatter::etoa_impl (FloatMax value, int exp, unsigned prec, unsigned widt
 			unsigned count = (unsigned)(out.pos () - begin);
 			while (count < width) {
 				out.put (' ');
+				++count;
 			}
 		}
 	}
@@ -698,7 +1609,7 @@ char* Formatter::whole_to_buf_16 (FloatMax whole, char* buf, const char* end, un
 			whole /= DIV;
 			UWord u = (UWord)part;
 			const char* end = buf + PART_LEN;
-			buf = u_to_buf (u, buf, end, 16, flags);
+			buf = u_to_buf_rev (u, buf, end, 16, flags);
 			if (whole) {
 				while (buf < end)
 					*(buf++) = '0';
@@ -740,22 +1651,37 @@ void Formatter::out_buf (const C* buf, size_t size, unsigned width, unsigned fla
 {
 	unsigned len = get_len (buf, size);
 
+	if (std::is_same <C, char>::value && len == size && out.count_only ()) {
+		// All characters are ASCII, calculate the output length
+		size_t cnt = len;
+		if (!(flags & FLAG_LEFT) && cnt < width)
+			cnt = width;
+		cnt += add_zeros;
+		if ((flags & FLAG_LEFT) && cnt < width)
+			cnt = width;
+		out.skip_ascii (cnt);
+		return;
+	}
+
 	// Pad up to given width
 	auto begin = out.pos ();
 	out_buf_pre (len, width, flags, out);
 
-	// Out narrow string as UTF8 in case of UTF8 decimal point in lconv.
-	WideInBufT <C> in (buf, buf + len);
-	for (;;) {
-		auto c = in.get ();
-		if (c == EOF)
-			break;
-		out.put (c);
+	if (std::is_same <C, char>::value && len == size) {
+		// All characters are ASCII
+		out.put_ascii ((const char*)buf, size);
+	} else {
+		// Out narrow string as UTF8 in case of UTF8 decimal point in lconv.
+		WideInBufT <C> in (buf, buf + size);
+		for (;;) {
+			auto c = in.get ();
+			if (c == EOF)
+				break;
+			out.put (c);
+		}
 	}
 
-	while (add_zeros--) {
-		out.put ('0');
-	}
+	out.fill ('0', add_zeros);
 
 	// Pad spaces up to given width
 	out_buf_post ((unsigned)(out.pos () - begin), width, flags, out);
@@ -764,24 +1690,15 @@ void Formatter::out_buf (const C* buf, size_t size, unsigned width, unsigned fla
 void Formatter::out_buf_pre (unsigned len, unsigned width, unsigned flags, WideOutEx& out)
 {
 	// pad spaces up to given width
-	if (!(flags & FLAG_LEFT)) {
-    int c = (flags & FLAG_ZEROPAD) ? '0' : ' ';
-		while (len < width) {
-			out.put (c);
-			++len;
-		}
-	}
+	if (!(flags & FLAG_LEFT) && len < width)
+		out.fill ((flags & FLAG_ZEROPAD) ? '0' : ' ', width - len);
 }
 
 void Formatter::out_buf_post (unsigned len, unsigned width, unsigned flags, WideOutEx& out)
 {
 	// append pad spaces up to given width
-	if (flags & FLAG_LEFT) {
-		while (len < width) {
-			out.put (' ');
-			++len;
-		}
-	}
+	if ((flags & FLAG_LEFT) && len < width)
+		out.fill (' ', width - len);
 }
 
 }
@@ -0,0 +1,111 @@
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include <Nirvana/Numpunct.h>
+#include <Nirvana/locale_defs.h>
+#include <Nirvana/utf8.h>
+#include <limits.h>
+#include <string.h>
+
+namespace Nirvana {
+
+// Decode the single UTF-8 character.
+// Returns 0 if the string is empty, invalid or contains more than one character.
+static int32_t single_char (const char* s) noexcept
+{
+	__Mbstate mbs { 0 };
+	if (!*s || !push_first (mbs, (unsigned char)*(s++)))
+		return 0;
+	while (mbs.__octets) {
+		if (!push_next (mbs, (unsigned char)*(s++)))
+			return 0;
+	}
+	return *s ? 0 : mbs.__wchar;
+}
+
+Numpunct::Numpunct () noexcept :
+	decimal_point_ { '.', 0 },
+	decimal_point_len_ (1),
+	group_cnt_ (0),
+	repeat_ (false),
+	groups_ { 0 },
+	thousands_sep_ (0)
+{}
+
+Numpunct::Numpunct (const struct lconv* loc) noexcept :
+	Numpunct ()
+{
+	if (!loc)
+		return;
+
+	if (loc->decimal_point && single_char (loc->decimal_point)) {
+		size_t len = strlen (loc->decimal_point);
+		memcpy (decimal_point_, loc->decimal_point, len + 1);
+		decimal_point_len_ = (uint8_t)len;
+	}
+
+	if (loc->thousands_sep && loc->grouping) {
+		thousands_sep_ = single_char (loc->thousands_sep);
+		if (thousands_sep_) {
+			const char* g = loc->grouping;
+			for (; group_cnt_ < GROUPING_MAX; ++g) {
+				if (*g <= 0 || *g == CHAR_MAX)
+					break;
+				groups_ [group_cnt_++] = (uint8_t)*g;
+			}
+			// The terminating zero means that the last group size is repeated.
+			repeat_ = !*g;
+		}
+	}
+}
+
+unsigned Numpunct::separators (unsigned digits) const noexcept
+{
+	unsigned cnt = 0;
+	unsigned pos = 0;
+	for (unsigned i = 0; i < group_cnt_; ++i) {
+		pos += groups_ [i];
+		if (pos >= digits)
+			return cnt;
+		++cnt;
+	}
+	if (repeat_ && group_cnt_)
+		cnt += (digits - pos - 1) / groups_ [group_cnt_ - 1];
+	return cnt;
+}
+
+unsigned Numpunct::separator_pos (unsigned i) const noexcept
+{
+	unsigned pos = 0;
+	unsigned g = 0;
+	for (; g < group_cnt_ && g <= i; ++g) {
+		pos += groups_ [g];
+	}
+	if (g <= i)
+		pos += (i - g + 1) * groups_ [group_cnt_ - 1];
+	return pos;
+}
+
+}
@@ -24,22 +24,212 @@
 *  popov.nirvana@gmail.com
 */
 #include <Nirvana/Parser.h>
+#include <Nirvana/strtoi.h>
+#include <Nirvana/charconv.h>
+#include <Nirvana/utf8.h>
+#include <Nirvana/locale_defs.h>
 #include <wctype.h>
-#include <unordered_set>
+#include <string.h>
+#include <string>
 #include <Nirvana/c_heap_dbg.h>
 
 namespace Nirvana {
 
-struct Parser::CharSet
+namespace {
+
+// Decode the character at p.
+// Returns EOF at the end of the string.
+
+inline int32_t decode (const char* p, const char* end, unsigned& len)
+{
+	if (p == end) {
+		len = 0;
+		return EOF;
+	}
+
+	int b = (unsigned char)*p;
+	if (b < 0x80) {
+		len = 1;
+		return b;
+	}
+
+	__Mbstate mbs { 0 };
+	const char* s = p;
+	if (!push_first (mbs, b))
+		throw_CODESET_INCOMPATIBLE (make_minor_errno (EILSEQ));
+	while (mbs.__octets) {
+		if (++s == end || !push_next (mbs, (unsigned char)*s))
+			throw_CODESET_INCOMPATIBLE (make_minor_errno (EILSEQ));
+	}
+	len = (unsigned)(s + 1 - p);
+	return mbs.__wchar;
+}
+
+inline int32_t decode (const wchar_t* p, const wchar_t* end, unsigned& len) noexcept
 {
-	std::unordered_set <int32_t> chars;
-	bool inv;
+	if (p == end) {
+		len = 0;
+		return EOF;
+	}
+	len = 1;
+	return *p;
+}
+
+// Skip cnt characters.
+
+inline const char* advance (const char* p, size_t cnt) noexcept
+{
+	for (; cnt; --cnt) {
+		p += octet_cnt ((unsigned char)*p);
+	}
+	return p;
+}
+
+inline const wchar_t* advance (const wchar_t* p, size_t cnt) noexcept
+{
+	return p + cnt;
+}
 
-	bool acceptable (int32_t c) const noexcept
+// Scan the decimal floating point number in the "C" locale.
+// Returns `nullptr` if the number must be scanned by WideInEx.
+
+template <typename F> inline
+const char* scan_float (const char* p, const char* end, F& ret, const struct lconv* loc) noexcept
+{
+	if (loc && strcmp (loc->decimal_point, ".") != 0)
+		return nullptr;
+
+	bool neg = false;
+	if (p != end && ('-' == *p || '+' == *p)) {
+		neg = '-' == *p;
+		++p;
+		// from_chars accepts '-', so the second sign must be rejected here
+		if (p != end && ('-' == *p || '+' == *p))
+			return nullptr;
+	}
+
+	// Hexadecimal
+	if (end - p > 1 && '0' == p [0] && ('x' == p [1] || 'X' == p [1]))
+		return nullptr;
+
+	F v;
+	from_chars_result res = from_chars (p, end, v);
+	if (res.ec != std::errc ())
+		return nullptr;
+
+	ret = neg ? -v : v;
+	return res.ptr;
+}
+
+template <typename F> inline
+const wchar_t* scan_float (const wchar_t*, const wchar_t*, F&, const struct lconv*) noexcept
+{
+	return nullptr;
+}
+
+}
+
+class Parser::VaArgs
+{
+public:
+	VaArgs (va_list args) noexcept
 	{
-		return ((chars.find (c) != chars.end ()) ^ inv);
+		va_copy (ap, args);
 	}
 
+	~VaArgs ()
+	{
+		va_end (ap);
+	}
+
+	va_list ap;
+};
+
+/// Input cursor on the null-terminated string.
+/// Provides the same input interface as WideInEx, but reads the string directly.
+/// 
+/// \typeparam C Character type.
+template <typename C>
+class Parser::Cursor
+{
+public:
+	Cursor (const C* s) :
+		begin_ (s),
+		end_ (s + std::char_traits <C>::length (s))
+	{
+		set (s);
+	}
+
+	int32_t cur () const noexcept
+	{
+		return cur_;
+	}
+
+	/// \returns Count of the code units read.
+	size_t pos () const noexcept
+	{
+		return p_ - begin_;
+	}
+
+	int32_t next ()
+	{
+		if (EOF != cur_)
+			set (p_ + len_);
+		return cur_;
+	}
+
+	int32_t skip_space ()
+	{
+		while (iswspace (cur_)) {
+			set (p_ + len_);
+		}
+		return cur_;
+	}
+
+	template <typename Int>
+	void get_int (Int& ret, unsigned base, bool& overflow)
+	{
+		const C* end = IntParser <C>::parse (p_, end_, base, ret, overflow);
+		if (end == p_)
+			throw_DATA_CONVERSION (make_minor_errno (EINVAL));
+		set (end);
+	}
+
+	template <typename F>
+	void get_float (F& ret, const struct lconv* loc, bool& overflow)
+	{
+		skip_space ();
+		overflow = false;
+		const C* end = scan_float (p_, end_, ret, loc);
+		if (!end) {
+			// Hexadecimal, localized and out of range values
+			WideInBufT <C> buf (p_, end_);
+			WideInEx in (buf);
+			in.get_float (ret, loc, overflow);
+			end = advance (p_, in.pos ());
+		}
+		set (end);
+	}
+
+	/// Copy the current character code units.
+	C* copy (C* dst) const noexcept
+	{
+		return std::copy (p_, p_ + len_, dst);
+	}
+
+private:
+	void set (const C* p)
+	{
+		p_ = p;
+		cur_ = decode (p, end_, len_);
+	}
+
+private:
+	const C* begin_;
+	const C* end_;
+	const C* p_;
+	int32_t cur_;
+	unsigned len_;
 };
 
 size_t Parser::size_alloc (size_t size_req) noexcept
@@ -152,7 +342,7 @@ template <typename C>
 class Parser::CharOut
 {
 public:
-	CharOut (unsigned width, unsigned flags, va_list& args);
+	CharOut (unsigned width, unsigned flags, VaArgs& args);
 	
 	~CharOut ()
 	{
@@ -177,24 +367,24 @@ private:
 };
 
 template <typename C>
-Parser::CharOut <C>::CharOut (unsigned width, unsigned flags, va_list& args)
+Parser::CharOut <C>::CharOut (unsigned width, unsigned flags, VaArgs& args)
 {
 	if (flags & FLAG_NOASSIGN) {
 		new (&u_.dummy) WideOutNull ();
 		out_ = &u_.dummy;
 	} else if (flags & FLAG_MALLOC) {
-		C** pp = va_arg (args, C**);
+		C** pp = va_arg (args.ap, C**);
 		new (&u_.allocate) WideOutMallocT <C> (*pp, width);
 		out_ = &u_.allocate;
 	} else {
-		C* p = va_arg (args, C*);
+		C* p = va_arg (args.ap, C*);
 		new (&u_.buffer) WideOutStrT <C> (p);
 		out_ = &u_.buffer;
 	}
 }
 
-template <typename C>
-inline void Parser::get_char (WideInEx& in, unsigned width, unsigned flags, va_list& args)
+template <typename C, class In>
+inline void Parser::get_char (In& in, unsigned width, unsigned flags, VaArgs& args)
 {
 	if (!width)
 		width = 1;
@@ -204,8 +394,24 @@ inline void Parser::get_char (WideInEx& in, unsigned width, unsigned flags, va_l
 }
 
 template <typename C>
-inline void Parser::get_char (WideInEx& in, unsigned width, unsigned flags, const CharSet& set,
-	va_list& args)
+inline void Parser::get_char (Cursor <C>& in, unsigned width, unsigned flags, VaArgs& args)
+{
+	if (flags & (FLAG_NOASSIGN | FLAG_MALLOC))
+		get_char <C, Cursor <C> > (in, width, flags, args);
+	else {
+		if (!width)
+			width = 1;
+
+		C* p = va_arg (args.ap, C*);
+		for (int32_t c = in.cur (); c != EOF && width--; c = in.next ()) {
+			p = in.copy (p);
+		}
+	}
+}
+
+template <typename C, class In>
+inline void Parser::get_char (In& in, unsigned width, unsigned flags, const CharSet& set,
+	VaArgs& args)
 {
 	CharOut <C> out (width, flags, args);
 	if (!width)
@@ -215,13 +421,49 @@ inline void Parser::get_char (WideInEx& in, unsigned width, unsigned flags, cons
 }
 
 template <typename C>
-inline void Parser::get_string (WideInEx& in, unsigned width, unsigned flags, va_list& args)
+inline void Parser::get_char (Cursor <C>& in, unsigned width, unsigned flags, const CharSet& set,
+	VaArgs& args)
+{
+	if (flags & (FLAG_NOASSIGN | FLAG_MALLOC))
+		get_char <C, Cursor <C> > (in, width, flags, set, args);
+	else {
+		if (!width)
+			width = std::numeric_limits <unsigned>::max ();
+
+		C* p = va_arg (args.ap, C*);
+		for (int32_t c = in.cur (); c != EOF && set.acceptable (c) && width--; c = in.next ()) {
+			p = in.copy (p);
+		}
+		*p = 0;
+	}
+}
+
+template <typename C, class In>
+inline void Parser::get_string (In& in, unsigned width, unsigned flags, VaArgs& args)
 {
 	CharOut <C> out (width, flags, args);
 	get_string (in, width, out);
 }
 
-void Parser::get_char (WideInEx& in, unsigned width, WideOut& out, const CharSet* set)
+template <typename C>
+inline void Parser::get_string (Cursor <C>& in, unsigned width, unsigned flags, VaArgs& args)
+{
+	if (flags & (FLAG_NOASSIGN | FLAG_MALLOC))
+		get_string <C, Cursor <C> > (in, width, flags, args);
+	else {
+		if (!width)
+			width = std::numeric_limits <unsigned>::max ();
+
+		C* p = va_arg (args.ap, C*);
+		for (int32_t c = in.cur (); c != EOF && !iswspace (c) && width--; c = in.next ()) {
+			p = in.copy (p);
+		}
+		*p = 0;
+	}
+}
+
+template <class In>
+void Parser::get_char (In& in, unsigned width, WideOut& out, const CharSet* set)
 {
 	assert (width);
 	int32_t c = in.cur ();
@@ -231,7 +473,8 @@ void Parser::get_char (WideInEx& in, unsigned width, WideOut& out, const CharSet
 	}
 }
 
-void Parser::get_string (WideInEx& in, unsigned width, WideOut& out)
+template <class In>
+void Parser::get_string (In& in, unsigned width, WideOut& out)
 {
 	if (!width)
 		width = std::numeric_limits <unsigned>::max ();
@@ -243,76 +486,210 @@ void Parser::get_string (WideInEx& in, unsigned width, WideOut& out)
 	out.put (0);
 }
 
-bool Parser::parse (WideIn& in0, WideIn& fmt0, va_list args, size_t& count, const struct lconv* loc)
+template <typename Int, class In>
+inline void Parser::get_int (In& in, unsigned base, unsigned flags, VaArgs& args)
 {
-	WideInEx fmt (fmt0);
-	WideInEx in (in0);
+	// Out of range value is saturated like strtol does.
+	Int v;
+	bool overflow;
+	in.get_int (v, base, overflow);
+	if (!(flags & FLAG_NOASSIGN))
+		*va_arg (args.ap, Int*) = v;
+}
+
+template <typename F, class In>
+inline void Parser::get_float (In& in, unsigned flags, VaArgs& args, const struct lconv* loc)
+{
+	// Out of range value is saturated to infinity like strtod does.
+	F v;
+	bool overflow;
+	in.get_float (v, loc, overflow);
+	if (!(flags & FLAG_NOASSIGN))
+		*va_arg (args.ap, F*) = v;
+}
+
+template <class In>
+void Parser::skip (In& in, int c)
+{
+	if (in.cur () != c)
+		throw CORBA::BAD_PARAM (make_minor_errno (EILSEQ));
+	in.next ();
+}
 
+template <class In>
+bool Parser::scan (In& in, const Compiled& fmt, VaArgs& args, size_t& count,
+	const struct lconv* loc)
+{
 	count = 0;
-	for (int32_t c; (c = fmt.cur ()) != EOF;) {
+	for (const Compiled::Op& op : fmt.ops_) {
 
 		if (in.cur () == EOF)
 			return false;
 
+		const unsigned flags = op.flags;
+		switch (op.type) {
+			case Compiled::LITERAL:
+				skip (in, op.c);
+				continue;
+
+			case Compiled::SPACE:
+				in.skip_space ();
+				continue;
+
+			case Compiled::INTEGER:
+				if ('p' == op.c)
+					get_int <uintptr_t> (in, op.base, flags, args);
+				else if (flags & FLAG_SIGNED) {
+					// signed
+					if (flags & FLAG_LONG_LONG)
+						get_int <long long> (in, op.base, flags, args);
+					else if (flags & FLAG_LONG)
+						get_int <long> (in, op.base, flags, args);
+					else if (flags & FLAG_CHAR)
+						get_int <signed char> (in, op.base, flags, args);
+					else if (flags & FLAG_SHORT)
+						get_int <short> (in, op.base, flags, args);
+					else
+						get_int <int> (in, op.base, flags, args);
+				} else {
+					// unsigned
+					if (flags & FLAG_LONG_LONG)
+						get_int <unsigned long long> (in, op.base, flags, args);
+					else if (flags & FLAG_LONG)
+						get_int <unsigned long> (in, op.base, flags, args);
+					else if (flags & FLAG_CHAR)
+						get_int <unsigned char> (in, op.base, flags, args);
+					else if (flags & FLAG_SHORT)
+						get_int <unsigned short> (in, op.base, flags, args);
+					else
+						get_int <unsigned int> (in, op.base, flags, args);
+				}
+				break;
+
+			case Compiled::FLOAT:
+				// The value is scanned directly to the destination type, so it is rounded once.
+				if (flags & FLAG_LONG_DOUBLE)
+					get_float <long double> (in, flags, args, loc);
+				else if (flags & FLAG_LONG)
+					get_float <double> (in, flags, args, loc);
+				else
+					get_float <float> (in, flags, args, loc);
+				break;
+
+			case Compiled::COUNT:
+				if (!(flags & FLAG_NOASSIGN))
+					*va_arg (args.ap, int*) = (int)in.pos ();
+				break;
+
+			case Compiled::CHARS:
+				if (flags & FLAG_LONG)
+					get_char <wchar_t> (in, op.width, flags, args);
+				else
+					get_char <char> (in, op.width, flags, args);
+				break;
+
+			case Compiled::STRING:
+				if (flags & FLAG_LONG)
+					get_string <wchar_t> (in, op.width, flags, args);
+				else
+					get_string <char> (in, op.width, flags, args);
+				break;
+
+			case Compiled::CHAR_SET: {
+				const CharSet& set = fmt.sets_ [op.base];
+				if (flags & FLAG_LONG)
+					get_char <wchar_t> (in, op.width, flags, set, args);
+				else
+					get_char <char> (in, op.width, flags, set, args);
+			} break;
+
+			case Compiled::INVALID:
+				throw_BAD_PARAM (make_minor_errno (EILSEQ));
+		}
+
+		if (!(flags & FLAG_NOASSIGN))
+			++count;
+	}
+
+	return true;
+}
+
+bool Parser::parse (WideIn& in, WideIn& fmt, va_list args, size_t& count, const struct lconv* loc)
+{
+	count = 0;
+	Compiled compiled (fmt);
+	return parse (in, compiled, args, count, loc);
+}
+
+bool Parser::parse (WideIn& in0, const Compiled& fmt, va_list args, size_t& count,
+	const struct lconv* loc)
+{
+	count = 0;
+	WideInEx in (in0);
+	VaArgs va (args);
+	return scan (in, fmt, va, count, loc);
+}
+
+template <typename C>
+bool Parser::parse (const C* buffer, const Compiled& fmt, va_list args, size_t& count,
+	const struct lconv* loc)
+{
+	count = 0;
+	Cursor <C> in (buffer);
+	VaArgs va (args);
+	return scan (in, fmt, va, count, loc);
+}
+
+template
+bool Parser::parse (const char* buffer, const Compiled& fmt, va_list args, size_t& count,
+	const struct lconv* loc);
+
+template
+bool Parser::parse (const wchar_t* buffer, const Compiled& fmt, va_list args, size_t& count,
+	const struct lconv* loc);
+
+void Parser::Compiled::compile (WideIn& fmt0)
+{
+	WideInEx fmt (fmt0);
+
+	for (int32_t c; (c = fmt.cur ()) != EOF;) {
+		Op op;
+		op.c = c;
+		op.flags = 0;
+		op.width = 0;
+		op.base = 0;
+
 		if (c != '%') {
 			if (iswspace (c)) {
-				in.skip_space ();
-				c = fmt.skip_space ();
+				op.type = SPACE;
+				fmt.skip_space ();
 			} else {
-				skip (in, c);
-				c = fmt.next ();
+				op.type = LITERAL;
+				fmt.next ();
 			}
 		} else {
 			c = fmt.next ();
 			if (c == '%') {
-				skip (in, '%');
-				c = fmt.next ();
+				op.type = LITERAL;
+				fmt.next ();
 			} else {
 
 				// flags
-				unsigned flags = 0;
 				if (c == '*') {
-					flags |= FLAG_NOASSIGN;
+					op.flags |= FLAG_NOASSIGN;
 					c = fmt.next ();
 				}
 
 				// width
-				unsigned width = 0;
 				if (is_digit (c))
-					c = fmt.get_int (width, 10);
+					c = fmt.get_int (op.width, 10);
 
-				flags |= length_flags (fmt);
+				op.flags |= length_flags (fmt);
 				c = fmt.cur ();
 
-				if (strchr (int_formats_, c)) {
-					// Integer format
-
-					unsigned base = int_base (c, flags);
-					if (flags & FLAG_SIGNED) {
-						// signed
-						if (flags & FLAG_LONG_LONG)
-							get_int <long long> (in, base, flags, args);
-						else if (flags & FLAG_LONG)
-							get_int <long> (in, base, flags, args);
-						else if (flags & FLAG_SHORT)
-							get_int <short> (in, base, flags, args);
-						else if (flags & FLAG_CHAR)
-							get_int <signed char> (in, base, flags, args);
-						else
-							get_int <int> (in, base, flags, args);
-					} else {
-						// unsigned
-						if (flags & FLAG_LONG_LONG)
-							get_int <unsigned long long> (in, base, flags, args);
-						else if (flags & FLAG_LONG)
-							get_int <unsigned long> (in, base, flags, args);
-						else if (flags & FLAG_SHORT)
-							get_int <unsigned short> (in, base, flags, args);
-						else if (flags & FLAG_CHAR)
-							get_int <unsigned char> (in, base, flags, args);
-						else
-							get_int <unsigned int> (in, base, flags, args);
-					}
+				if (c != EOF && strchr (int_formats_, c)) {
+					op.type = INTEGER;
+					op.base = int_base (c, op.flags);
 				} else {
 					switch (c) {
 						case 'a':
@@ -323,30 +700,20 @@ bool Parser::parse (WideIn& in0, WideIn& fmt0, va_list args, size_t& count, cons
 						case 'F':
 						case 'g':
 						case 'G':
-						{
-							FloatMax f;
-							in.get_float (f, loc);
-							if (!(flags & FLAG_NOASSIGN)) {
-								if (sizeof (long double) > sizeof (double) && (flags & FLAG_LONG_DOUBLE))
-									*va_arg (args, long double*) = f;
-								else if (sizeof (double) > sizeof (float) && (flags & FLAG_LONG))
-									*va_arg (args, double*) = (double)f;
-								else
-									*va_arg (args, float*) = (float)f;
-							}
-						} break;
+							op.type = FLOAT;
+							break;
 
 						case 'n':
-							if (!(flags & FLAG_NOASSIGN))
-								*va_arg (args, int*) = (int)in.pos ();
+							op.type = COUNT;
 							break;
 
 						case 'p':
-							get_int <uintptr_t> (in, 16, flags, args);
+							op.type = INTEGER;
+							op.base = 16;
 							break;
 
 						case 'm':
-							flags |= FLAG_MALLOC;
+							op.flags |= FLAG_MALLOC;
 							c = fmt.next ();
 #ifdef NIRVANA_C17
 							[[fallthrough]];
@@ -355,62 +722,72 @@ bool Parser::parse (WideIn& in0, WideIn& fmt0, va_list args, size_t& count, cons
 							switch (c) {
 
 								case 'c':
-									if (flags & FLAG_LONG)
-										get_char <wchar_t> (in, width, flags, args);
-									else
-										get_char <char> (in, width, flags, args);
+									op.type = CHARS;
 									break;
 
 								case 's':
-									if (flags & FLAG_LONG)
-										get_string <wchar_t> (in, width, flags, args);
-									else
-										get_string <char> (in, width, flags, args);
+									op.type = STRING;
 									break;
 
 								case '[': {
-									c = fmt.next ();
 									CharSet set;
+									std::fill_n (set.ascii, std::size (set.ascii), 0);
 									set.inv = false;
+									c = fmt.next ();
 									if ('^' == c) {
 										set.inv = true;
 										c = fmt.next ();
 									}
 									while (']' != c && EOF != c) {
-										set.chars.insert (c);
+										if ((uint32_t)c < 0x80)
+											set.ascii [c >> 5] |= 1u << (c & 31);
+										else
+											set.wide.push_back (c);
 										c = fmt.next ();
 									}
-									if (']' != c)
-										throw_BAD_PARAM (make_minor_errno (EILSEQ));
-									
-									if (flags & FLAG_LONG)
-										get_char <wchar_t> (in, width, flags, set, args);
-									else
-										get_char <char> (in, width, flags, set, args);
+									if (']' != c) {
+										add_invalid ();
+										return;
+									}
+
+									std::sort (set.wide.begin (), set.wide.end ());
+									set.wide.shrink_to_fit ();
+									op.type = CHAR_SET;
+									op.base = (unsigned)sets_.size ();
+									sets_.push_back (std::move (set));
 								} break;
 
 								default:
-									throw_BAD_PARAM (make_minor_errno (EILSEQ));
-									break;
+									add_invalid ();
+									return;
 							}
 					}
 				}
 
-				if (!(flags & FLAG_NOASSIGN))
-					++count;
-				c = fmt.next ();
+				op.c = c;
+				fmt.next ();
 			}
 		}
+
+		ops_.push_back (op);
 	}
 
-	return true;
+	ops_.shrink_to_fit ();
+	sets_.shrink_to_fit ();
 }
 
-void Parser::skip (WideInEx& in, int c)
+void Parser::Compiled::add_invalid ()
 {
-	if (in.cur () != c)
-		throw CORBA::BAD_PARAM (make_minor_errno (EILSEQ));
-	in.next ();
+	// Scanning stops on this operation, so the rest of the format is not compiled.
+	Op op;
+	op.type = INVALID;
+	op.c = 0;
+	op.flags = 0;
+	op.width = 0;
+	op.base = 0;
+	ops_.push_back (op);
+	ops_.shrink_to_fit ();
+	sets_.shrink_to_fit ();
 }
 
 }
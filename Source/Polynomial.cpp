@@ -27,7 +27,11 @@
 #include <float.h>
 #include <cmath>
 #include <cfenv>
+#include <iterator>
+#include <algorithm>
 #include <Nirvana/WideInEx.h>
+#include <Nirvana/FloatToDecimal.h>
+#include <Nirvana/DecimalToFloat.h>
 
 #pragma float_control (precise, on)
 
@@ -49,7 +53,8 @@ namespace Nirvana {
 PolynomialBase::PolynomialBase () noexcept :
 	end_ (parts ()),
 	digits_ (0),
-	overflow_ (false)
+	overflow_ (false),
+	truncated_ (false)
 {}
 
 void PolynomialBase::add (const Part& part, const Part* end) noexcept
@@ -63,6 +68,8 @@ void PolynomialBase::add (const Part& part, const Part* end) noexcept
 			return;
 	} else if (end_ >= end) {
 		overflow_ = true;
+		if (part.u)
+			truncated_ = true;
 		return;
 	}
 	*(end_++) = part;
@@ -126,6 +133,330 @@ unsigned PolynomialBase::get_parts (WideInEx& in, bool drop_tz, unsigned base, c
 	return digs;
 }
 
+bool PolynomialBase::significand10 (int& exp, uint64_t& significand) const noexcept
+{
+	const unsigned MAX_DIGITS = DecimalToFloat::SIGNIFICAND_DIGITS;
+	const uint64_t* pow10 = FloatToDecimal::pow10_;
+
+	uint64_t w = 0;
+	unsigned w_digits = 0;
+	int power = digits_ + exp;
+	for (const Part* p = parts (); p < end_; ++p) {
+		unsigned nd = p->num_digits;
+		if (!w) {
+			// Skip the leading zeros
+			unsigned sig = p->u ? FloatToDecimal::digits (p->u) : 0;
+			power -= nd - sig;
+			nd = sig;
+		}
+		if (w_digits + nd <= MAX_DIGITS) {
+			w = w * pow10 [nd] + p->u;
+			w_digits += nd;
+			power -= nd;
+		} else {
+			// Take the leading digits of the part, the rest is truncated
+			unsigned take = MAX_DIGITS - w_digits;
+			unsigned drop = nd - take;
+			uint64_t head = 0;
+			bool truncated = p->u != 0;
+			if (drop < std::size (FloatToDecimal::pow10_)) {
+				head = p->u / pow10 [drop];
+				truncated = p->u % pow10 [drop] != 0;
+			}
+			w = w * pow10 [take] + head;
+			power -= take;
+			for (++p; !truncated && p < end_; ++p)
+				truncated = p->u != 0;
+			exp = power;
+			significand = w;
+			return !truncated;
+		}
+	}
+	exp = power;
+	significand = w;
+	return true;
+}
+
+namespace {
+
+/// Decimal number with the binary shift operations.
+/// 
+/// The value is 0.d[0]d[1]...d[nd-1] * 10 ^ dp, without leading and trailing zeros.
+/// The digits beyond MAX_DIGITS are dropped, the `truncated` flag remembers that
+/// the exact value is a bit greater. MAX_DIGITS is enough to hold the exact decimal
+/// representation of any halfway point between the adjacent values of F,
+/// so the rounding is always decided correctly.
+/// 
+/// \typeparam F Floating point type.
+template <typename F>
+class BigDecimal
+{
+	static const int MANT_DIGITS = std::numeric_limits <F>::digits;
+	static const int MIN_EXP = std::numeric_limits <F>::min_exponent;
+	static const int MAX_EXP = std::numeric_limits <F>::max_exponent;
+
+	static_assert (std::numeric_limits <F>::radix == 2, "Unexpected radix");
+	static_assert (MANT_DIGITS <= 64, "The significand must fit into uint64_t");
+
+	// Number of the significand bits of the smallest halfway point
+	static const int HALFWAY_BITS = MANT_DIGITS - MIN_EXP + 1;
+
+	static const unsigned MAX_DIGITS = HALFWAY_BITS - HALFWAY_BITS * 30103 / 100000
+		+ std::numeric_limits <F>::max_digits10;
+
+	// Maximal shift in one pass. (9 << MAX_SHIFT) + carry must fit into uint64_t.
+	static const unsigned MAX_SHIFT = 60;
+
+	// Maximal count of the leading digits added by the left shift.
+	static const unsigned SHIFT_DIGITS = 19;
+
+public:
+	BigDecimal (const PolynomialBase::Part* begin, const PolynomialBase::Part* end, int dp,
+		bool truncated) noexcept;
+
+	void convert (F& ret);
+
+private:
+	void append (unsigned digit) noexcept
+	{
+		if (nd_ < MAX_DIGITS)
+			d_ [nd_++] = (uint8_t)digit;
+		else if (digit)
+			truncated_ = true;
+	}
+
+	void trim () noexcept
+	{
+		while (nd_ && !d_ [nd_ - 1])
+			--nd_;
+	}
+
+	void shift_left (unsigned k) noexcept;
+	void shift_right (unsigned k) noexcept;
+
+	void shift (int k) noexcept
+	{
+		if (k > 0) {
+			for (; k > (int)MAX_SHIFT; k -= MAX_SHIFT)
+				shift_left (MAX_SHIFT);
+			shift_left (k);
+		} else if (k < 0) {
+			for (; k < -(int)MAX_SHIFT; k += MAX_SHIFT)
+				shift_right (MAX_SHIFT);
+			shift_right (-k);
+		}
+	}
+
+	// Binary shift which keeps the value in range for the decimal point position.
+	static unsigned pow2_shift (unsigned dp) noexcept
+	{
+		// floor (dp * log2 (10)) but at least 1, so 2 ^ shift <= 10 ^ dp
+		static const uint8_t shifts [] = { 1, 3, 6, 9, 13, 16, 19, 23, 26, 29, 33, 36, 39, 43, 46,
+			49, 53, 56, 59 };
+		return dp < std::size (shifts) ? shifts [dp] : MAX_SHIFT;
+	}
+
+	uint64_t rounded_integer (bool& carry) const noexcept;
+
+private:
+	unsigned nd_;
+	int dp_;
+	bool truncated_;
+	uint8_t d_ [MAX_DIGITS + SHIFT_DIGITS];
+};
+
+template <typename F>
+BigDecimal <F>::BigDecimal (const PolynomialBase::Part* begin, const PolynomialBase::Part* end,
+	int dp, bool truncated) noexcept :
+	nd_ (0),
+	dp_ (dp),
+	truncated_ (truncated)
+{
+	for (const PolynomialBase::Part* p = begin; p != end; ++p) {
+		// The part may have any count of the leading zeros
+		unsigned sig = p->u ? FloatToDecimal::digits (p->u) : 0;
+		unsigned zeros = p->num_digits - sig;
+		if (nd_) {
+			for (; zeros; --zeros) {
+				append (0);
+			}
+		} else
+			dp_ -= zeros;
+
+		uint8_t part [std::numeric_limits <PolynomialBase::UWord>::digits10 + 1];
+		PolynomialBase::UWord u = p->u;
+		for (unsigned i = sig; i;) {
+			part [--i] = (uint8_t)(u % 10);
+			u /= 10;
+		}
+		for (unsigned i = 0; i < sig; ++i) {
+			append (part [i]);
+		}
+	}
+	trim ();
+}
+
+template <typename F>
+void BigDecimal <F>::shift_left (unsigned k) noexcept
+{
+	// Write the digits from the end of the reserve, then move them to the begin.
+	unsigned w = nd_ + SHIFT_DIGITS;
+	uint64_t n = 0;
+	for (unsigned r = nd_; r;) {
+		n += (uint64_t)d_ [--r] << k;
+		d_ [--w] = (uint8_t)(n % 10);
+		n /= 10;
+	}
+	for (; n; n /= 10) {
+		d_ [--w] = (uint8_t)(n % 10);
+	}
+
+	unsigned cnt = nd_ + SHIFT_DIGITS - w;
+	dp_ += cnt - nd_;
+	if (w)
+		std::copy (d_ + w, d_ + w + cnt, d_);
+	if (cnt > MAX_DIGITS) {
+		for (unsigned i = MAX_DIGITS; i < cnt; ++i) {
+			if (d_ [i])
+				truncated_ = true;
+		}
+		cnt = MAX_DIGITS;
+	}
+	nd_ = cnt;
+	trim ();
+}
+
+template <typename F>
+void BigDecimal <F>::shift_right (unsigned k) noexcept
+{
+	unsigned r = 0;
+	uint64_t n = 0;
+
+	// Pick up enough leading digits to cover the first shift
+	for (; !(n >> k); ++r) {
+		if (r < nd_)
+			n = n * 10 + d_ [r];
+		else if (n)
+			n *= 10;
+		else {
+			nd_ = 0;
+			return;
+		}
+	}
+	dp_ -= (int)r - 1;
+
+	const uint64_t mask = ((uint64_t)1 << k) - 1;
+
+	// Pick up a digit, put down a digit
+	unsigned w = 0;
+	for (; r < nd_; ++r) {
+		d_ [w++] = (uint8_t)(n >> k);
+		n = (n & mask) * 10 + d_ [r];
+	}
+
+	// Put down the extra digits
+	nd_ = w;
+	for (; n; n = (n & mask) * 10) {
+		append ((unsigned)(n >> k));
+	}
+	trim ();
+}
+
+template <typename F>
+uint64_t BigDecimal <F>::rounded_integer (bool& carry) const noexcept
+{
+	// The value is less than 2 ^ 64, so dp_ <= 20.
+	assert (dp_ <= 20);
+	uint64_t n = 0;
+	int i = 0;
+	for (; i < dp_ && i < (int)nd_; ++i) {
+		n = n * 10 + d_ [i];
+	}
+	for (; i < dp_; ++i) {
+		n *= 10;
+	}
+
+	bool round_up = false;
+	if (0 <= dp_ && dp_ < (int)nd_) {
+		unsigned digit = d_ [dp_];
+		if (digit == 5 && dp_ + 1 == (int)nd_)
+			round_up = truncated_ || (n & 1); // Exactly halfway, round to even
+		else
+			round_up = digit >= 5;
+	}
+
+	carry = false;
+	if (round_up && !++n)
+		carry = true;
+	return n;
+}
+
+template <typename F>
+void BigDecimal <F>::convert (F& ret)
+{
+	ret = 0;
+	if (!nd_)
+		return;
+
+	// The value is less than 10 ^ dp_ and not less than 10 ^ (dp_ - 1).
+	if (dp_ > std::numeric_limits <F>::max_exponent10 + 1)
+		throw_DATA_CONVERSION (make_minor_errno (ERANGE));
+	if (dp_ < (MIN_EXP - MANT_DIGITS - 1) * 30103 / 100000 - 1)
+		return;
+
+	// Scale to [0.5, 1)
+	int exp = 0;
+	while (dp_ > 0) {
+		unsigned n = pow2_shift (dp_);
+		shift_right (n);
+		exp += n;
+	}
+	while (dp_ < 0 || (dp_ == 0 && d_ [0] < 5)) {
+		unsigned n = pow2_shift (-dp_);
+		shift_left (n);
+		exp -= n;
+	}
+
+	// Denormalized
+	if (exp < MIN_EXP) {
+		shift (exp - MIN_EXP);
+		exp = MIN_EXP;
+	}
+
+	if (exp > MAX_EXP)
+		throw_DATA_CONVERSION (make_minor_errno (ERANGE));
+
+	shift (MANT_DIGITS);
+	bool carry;
+	uint64_t mant = rounded_integer (carry);
+
+	// Rounding might add a bit
+	if (carry || (MANT_DIGITS < 64 && mant == (uint64_t)1 << (MANT_DIGITS % 64))) {
+		mant = (uint64_t)1 << (MANT_DIGITS - 1);
+		if (++exp > MAX_EXP)
+			throw_DATA_CONVERSION (make_minor_errno (ERANGE));
+	}
+
+	ret = std::ldexp ((F)mant, exp - MANT_DIGITS);
+}
+
+}
+
+template <typename F>
+void PolynomialBase::to_float10 (int exp, F& ret) const
+{
+	BigDecimal <F> (parts (), end_, digits_ + exp, truncated_).convert (ret);
+}
+
+template
+void PolynomialBase::to_float10 (int exp, float& ret) const;
+
+template
+void PolynomialBase::to_float10 (int exp, double& ret) const;
+
+template
+void PolynomialBase::to_float10 (int exp, long double& ret) const;
+
 namespace {
 
 template <size_t COUNT> struct Exp10Positive
@@ -28,6 +28,8 @@
 #include <cfenv>
 #include <Nirvana/locale_defs.h>
 #include <Nirvana/Polynomial.h>
+#include <Nirvana/DecimalToFloat.h>
+#include <Nirvana/FloatToDecimal.h>
 
 namespace Nirvana {
 
@@ -134,8 +136,74 @@ bool WideInEx::is_nan ()
 	return skip (nan, std::size (nan));
 }
 
-int32_t WideInEx::get_float (FloatMax& ret, const struct lconv* loc)
+namespace {
+
+template <typename F> inline
+bool to_float_fast (const PolynomialBase&, int, F&) noexcept
+{
+	return false;
+}
+
+template <typename F> inline
+bool to_float_ieee (const PolynomialBase& poly, int exp, F& ret) noexcept
+{
+	uint64_t significand;
+	if (poly.significand10 (exp, significand)) {
+		DecimalToFloat::convert (significand, exp, ret);
+		return true;
+	} else
+		return DecimalToFloat::convert_truncated (significand, exp, ret);
+}
+
+// Correctly rounded conversion of the decimal polynomial.
+// Returns `false` if the rounding can not be decided by the leading digits.
+
+inline
+bool to_float_fast (const PolynomialBase& poly, int exp, double& ret) noexcept
+{
+	return to_float_ieee (poly, exp, ret);
+}
+
+inline
+bool to_float_fast (const PolynomialBase& poly, int exp, float& ret) noexcept
+{
+	return to_float_ieee (poly, exp, ret);
+}
+
+inline
+bool to_float_fast (const PolynomialBase& poly, int exp, long double& ret) noexcept
+{
+	// If the significand and the power of ten are exact,
+	// a single multiplication or division is rounded correctly.
+	const unsigned MAX_EXACT_POW10 = 27; // 5 ^ 27 < 2 ^ 64
+	uint64_t significand;
+	if (std::numeric_limits <long double>::digits < 64
+		|| !poly.significand10 (exp, significand)
+		|| exp > (int)MAX_EXACT_POW10 || exp < -(int)MAX_EXACT_POW10)
+		return false;
+
+	const uint64_t* pow10 = FloatToDecimal::pow10_;
+	unsigned uexp = exp < 0 ? -exp : exp;
+	long double p = 1;
+	for (; uexp >= 19; uexp -= 19) {
+		p *= (long double)pow10 [19];
+	}
+	p *= (long double)pow10 [uexp];
+
+	ret = (long double)significand;
+	if (exp < 0)
+		ret /= p;
+	else
+		ret *= p;
+	return true;
+}
+
+}
+
+template <typename F>
+int32_t WideInEx::get_float (F& ret, const struct lconv* loc, bool& overflow)
 {
+	overflow = false;
 	bool sign = false;
 	auto c = skip_space ();
 	switch (c) {
@@ -150,62 +218,37 @@ int32_t WideInEx::get_float (FloatMax& ret, const struct lconv* loc)
 
 	const int32_t dp = decimal_point (loc);
 
-	FloatMax num;
+	F num;
 	bool some_digits = false;
 	if (c == '0') {
 		c = next ();
 		if ('x' == c || 'X' == c) {
 			next ();
-			c = get_float <16> (num, dp, false);
-			switch (c) {
-				case 'P':
-				case 'p':
-					next ();
-					int exp;
-					c = get_int (exp, 10);
-					if (num != std::numeric_limits <FloatMax>::infinity ())
-						num = std::ldexp (num, exp - 1);
-					break;
-			}
-
+			c = get_float <16> (num, dp, false, overflow);
 			goto end;
 		} else
 			some_digits = true;
 
 	} else if (is_inf ()) {
-		ret = sign ? -std::numeric_limits <FloatMax>::infinity () :
-			std::numeric_limits <FloatMax>::infinity ();
+		ret = sign ? -std::numeric_limits <F>::infinity () :
+			std::numeric_limits <F>::infinity ();
 		return cur ();
 	} else if (is_nan ()) {
-		ret = std::numeric_limits <FloatMax>::signaling_NaN ();
+		ret = std::numeric_limits <F>::signaling_NaN ();
 		return cur ();
 	}
 
-	c = get_float <10> (num, dp, some_digits);
-	switch (c) {
-		case 'E':
-		case 'e':
-			next ();
-			int exp;
-			c = get_int (exp, 10);
-			if (num != std::numeric_limits <FloatMax>::infinity ()) {
-				if (std::numeric_limits <FloatMax>::radix == 10)
-					num = std::scalbn (num, exp);
-				else
-					num = num * std::pow ((FloatMax)10, exp);
-			}
-			break;
-	}
+	c = get_float <10> (num, dp, some_digits, overflow);
 
 end:
+	if (num == std::numeric_limits <F>::infinity ())
+		overflow = true;
 	ret = sign ? -num : num;
-	if (num == std::numeric_limits <FloatMax>::infinity ())
-		throw_DATA_CONVERSION (make_minor_errno (ERANGE));
 	return c;
 }
 
-template <unsigned BASE> inline
-int32_t WideInEx::get_float (FloatMax& num, int32_t dec_pt, bool no_check)
+template <unsigned BASE, typename F> inline
+int32_t WideInEx::get_float (F& num, int32_t dec_pt, bool no_check, bool& overflow)
 {
 	num = 0;
 
@@ -222,8 +265,8 @@ int32_t WideInEx::get_float (FloatMax& num, int32_t dec_pt, bool no_check)
 
 	unsigned all_digits = poly.get_parts (*this, false);
 
-	bool overflow = poly.overflow ();
-	
+	overflow = poly.overflow ();
+
 	int exp = 0;
 	if (cur () == dec_pt) {
 		next ();
@@ -235,19 +278,52 @@ int32_t WideInEx::get_float (FloatMax& num, int32_t dec_pt, bool no_check)
 	if (!all_digits && !no_check)
 		throw_DATA_CONVERSION (make_minor_errno (EINVAL));
 
+	// The exponent is obtained before the conversion, so the decimal value is rounded once.
+	// It is consumed even if the value is out of range, as strtod does.
+	int32_t c = cur ();
+	int exp_val = 0;
+	bool has_exp = (BASE == 10) ? (c == 'e' || c == 'E') : (c == 'p' || c == 'P');
+	if (has_exp) {
+		next ();
+		bool exp_overflow;
+		c = get_int (exp_val, 10, exp_overflow);
+	}
+
 	if (overflow) {
-		num = std::numeric_limits <FloatMax>::infinity ();
-		throw_DATA_CONVERSION (make_minor_errno (ERANGE));
-	} else {
-		try {
-			num = poly.to_float (exp);
-		} catch (const CORBA::DATA_CONVERSION&) {
-			num = std::numeric_limits <FloatMax>::infinity ();
-			throw;
+		num = std::numeric_limits <F>::infinity ();
+		return c;
+	}
+
+	try {
+		if (BASE == 16) {
+			// The binary exponent scales the value as written, with the point after the leading
+			// digit. Formatter::atoa_bits () writes "%a" with the same convention.
+			FloatMax f = poly.to_float (exp);
+			if (has_exp)
+				f = std::ldexp (f, exp_val);
+			num = (F)f;
+		} else {
+			// Limit the exponent to avoid the integer overflow. The result is zero or infinity anyway.
+			const int EXP_LIMIT = 100000;
+			exp += std::max (std::min (exp_val, EXP_LIMIT), -EXP_LIMIT);
+			if (!to_float_fast (poly, exp, num))
+				poly.to_float10 (exp, num);
 		}
+	} catch (const CORBA::DATA_CONVERSION&) {
+		num = std::numeric_limits <F>::infinity ();
+		overflow = true;
 	}
 
-	return cur ();
+	return c;
 }
 
+template
+int32_t WideInEx::get_float (float& ret, const struct lconv* loc, bool& overflow);
+
+template
+int32_t WideInEx::get_float (double& ret, const struct lconv* loc, bool& overflow);
+
+template
+int32_t WideInEx::get_float (long double& ret, const struct lconv* loc, bool& overflow);
+
 }
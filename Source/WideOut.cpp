@@ -26,9 +26,18 @@
 #include <Nirvana/WideOut.h>
 #include <Nirvana/WideIn.h>
 #include <Nirvana/utf8.h>
+#include <algorithm>
 
 namespace Nirvana {
 
+void WideOut::put_ascii (const char* s, size_t len)
+{
+	for (const char* end = s + len; s != end; ++s) {
+		assert ((unsigned char)*s < 0x80);
+		put (*s);
+	}
+}
+
 void WideOutUTF8::put (uint32_t wc)
 {
 	__Mbstate mbs;
@@ -55,9 +64,18 @@ void WideOutCP::put (uint32_t wc)
 		WideOutUTF8::put (wc);
 }
 
+void WideOutCP::put_ascii (const char* s, size_t len)
+{
+	if (code_page_)
+		WideOut::put_ascii (s, len);
+	else
+		WideOutUTF8::put_ascii (s, len);
+}
+
 WideOutEx::WideOutEx (WideOut& out) :
 	out_ (out),
-	pos_ (0)
+	pos_ (0),
+	count_only_ (out.count_only ())
 {}
 
 void WideOutEx::put (uint32_t wc)
@@ -66,6 +84,21 @@ void WideOutEx::put (uint32_t wc)
 	++pos_;
 }
 
+void WideOutEx::fill (char c, size_t count)
+{
+	if (count_only_) {
+		skip_ascii (count);
+		return;
+	}
+	char buf [32];
+	std::fill_n (buf, count < sizeof (buf) ? count : sizeof (buf), c);
+	while (count) {
+		size_t cb = count < sizeof (buf) ? count : sizeof (buf);
+		put_ascii (buf, cb);
+		count -= cb;
+	}
+}
+
 void copy (WideIn& in, WideOut& out)
 {
 	for (;;) {
@@ -0,0 +1,1272 @@
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include <Nirvana/charconv.h>
+#include <Nirvana/DecimalToFloat.h>
+#include <Nirvana/FloatToDecimal.h>
+#include <Nirvana/WideInEx.h>
+#include <Nirvana/bitutils.h>
+#include <string.h>
+#include <cmath>
+
+namespace Nirvana {
+
+namespace {
+
+const char digit_pairs [200] = {
+	'0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+	'1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+	'2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+	'3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+	'4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+	'5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+	'6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+	'7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+	'8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+	'9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+const char digit_chars [] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+inline bool is_digit (char c) noexcept
+{
+	return '0' <= c && c <= '9';
+}
+
+inline unsigned hex_digit (char c) noexcept
+{
+	if ('0' <= c && c <= '9')
+		return (unsigned)(c - '0');
+	else if ('a' <= c && c <= 'f')
+		return (unsigned)(c - 'a' + 10);
+	else if ('A' <= c && c <= 'F')
+		return (unsigned)(c - 'A' + 10);
+	else
+		return 16;
+}
+
+// Case insensitive match of the lowercase ASCII string.
+bool match (const char*& p, const char* last, const char* s) noexcept
+{
+	const char* q = p;
+	for (; *s; ++s, ++q) {
+		if (q == last || (*q | 0x20) != *s)
+			return false;
+	}
+	p = q;
+	return true;
+}
+
+to_chars_result too_large (char* last) noexcept
+{
+	return { last, std::errc::value_too_large };
+}
+
+to_chars_result put (char* first, char* last, const char* s, size_t len) noexcept
+{
+	if ((size_t)(last - first) < len)
+		return too_large (last);
+	memcpy (first, s, len);
+	return { first + len, std::errc () };
+}
+
+// Exact decimal expansion of the finite non-negative binary floating point value.
+// The digits are produced from the most significant one, so the output may be rounded
+// at any position without the double rounding. The value mant * 2 ^ exp is split into
+// the integer part, converted to the groups of 9 decimal digits, and the fraction,
+// which yields the next digit as the carry of the multiplication by 10.
+class ExactDecimal
+{
+public:
+	template <typename F>
+	explicit ExactDecimal (F value) noexcept;
+
+	// The decimal exponent of the first digit. Zero for the zero value.
+	int magnitude () const noexcept
+	{
+		return magnitude_;
+	}
+
+	// Get the next digit. Zeros are returned after the last non-zero digit.
+	unsigned next () noexcept
+	{
+		if (pending_ >= 0) {
+			unsigned d = (unsigned)pending_;
+			pending_ = -1;
+			return d;
+		}
+		if (!group_digits_ && group_cnt_) {
+			group_ = groups_ [--group_cnt_];
+			group_digits_ = 9;
+		}
+		if (group_digits_) {
+			uint32_t p = (uint32_t)FloatToDecimal::pow10_ [--group_digits_];
+			unsigned d = group_ / p;
+			group_ %= p;
+			return d;
+		}
+		return next_frac ();
+	}
+
+	// `true` if all the remaining digits are zeros.
+	bool exhausted () const noexcept
+	{
+		return pending_ <= 0 && !group_ && group_cnt_ <= groups_lo_ && frac_lo_ == frac_cnt_;
+	}
+
+private:
+	unsigned next_frac () noexcept;
+
+private:
+	static const unsigned LIMB_BITS = 32;
+
+	// The integer part of the greatest value and the fraction of the least one.
+	static const size_t INT_LIMBS = std::numeric_limits <long double>::max_exponent / LIMB_BITS + 4;
+	static const size_t FRAC_LIMBS = (std::numeric_limits <long double>::digits
+		- std::numeric_limits <long double>::min_exponent) / LIMB_BITS + 2;
+	static const size_t GROUPS = std::numeric_limits <long double>::max_exponent10 / 9 + 2;
+
+	// The fraction is frac_ / 2 ^ (32 * frac_cnt_), the limbs are little-endian.
+	uint32_t frac_ [FRAC_LIMBS];
+	size_t frac_lo_; // The lowest non-zero limb
+	size_t frac_cnt_;
+
+	// The integer part groups, the least significant first.
+	uint32_t groups_ [GROUPS];
+	size_t groups_lo_; // The lowest non-zero group
+	size_t group_cnt_; // Groups remaining for output
+	uint32_t group_;   // Rest of the current group
+	unsigned group_digits_;
+
+	int pending_; // The first fraction digit found on construction, or -1
+	int magnitude_;
+};
+
+template <typename F>
+ExactDecimal::ExactDecimal (F value) noexcept :
+	frac_lo_ (0),
+	frac_cnt_ (0),
+	groups_lo_ (0),
+	group_cnt_ (0),
+	group_ (0),
+	group_digits_ (0),
+	pending_ (-1),
+	magnitude_ (0)
+{
+	static_assert (std::numeric_limits <F>::digits <= 64, "Unexpected floating point format");
+
+	if (value == 0) {
+		pending_ = 0;
+		return;
+	}
+
+	int e;
+	F m = std::frexp (value, &e);
+	uint64_t mant = (uint64_t)std::ldexp (m, std::numeric_limits <F>::digits);
+	int exp = e - std::numeric_limits <F>::digits;
+
+	uint64_t whole;
+	uint64_t frac;
+	unsigned frac_bits;
+	if (exp >= 0) {
+		whole = 0;
+		frac = 0;
+		frac_bits = 0;
+	} else if (exp > -64) {
+		frac_bits = -exp;
+		whole = mant >> frac_bits;
+		frac = mant & (((uint64_t)1 << frac_bits) - 1);
+	} else {
+		frac_bits = -exp;
+		whole = 0;
+		frac = mant;
+	}
+
+	// Integer part
+	uint32_t limbs [INT_LIMBS];
+	size_t limb_cnt;
+	if (exp >= 0) {
+		size_t shift = exp / LIMB_BITS;
+		unsigned bit_shift = exp % LIMB_BITS;
+		std::fill_n (limbs, shift, 0);
+		limbs [shift] = (uint32_t)(mant << bit_shift);
+		limbs [shift + 1] = (uint32_t)(mant >> (LIMB_BITS - bit_shift));
+		limbs [shift + 2] = bit_shift ? (uint32_t)(mant >> (2 * LIMB_BITS - bit_shift)) : 0;
+		limb_cnt = shift + 3;
+	} else {
+		limbs [0] = (uint32_t)whole;
+		limbs [1] = (uint32_t)(whole >> LIMB_BITS);
+		limb_cnt = 2;
+	}
+	while (limb_cnt && !limbs [limb_cnt - 1]) {
+		--limb_cnt;
+	}
+
+	size_t group_cnt = 0;
+	while (limb_cnt) {
+		uint64_t rem = 0;
+		for (size_t i = limb_cnt; i-- > 0;) {
+			uint64_t x = (rem << LIMB_BITS) | limbs [i];
+			limbs [i] = (uint32_t)(x / 1000000000);
+			rem = x % 1000000000;
+		}
+		groups_ [group_cnt++] = (uint32_t)rem;
+		while (limb_cnt && !limbs [limb_cnt - 1]) {
+			--limb_cnt;
+		}
+	}
+
+	// Fraction, left aligned to the limb boundary
+	if (frac) {
+		frac_cnt_ = (frac_bits + LIMB_BITS - 1) / LIMB_BITS;
+		unsigned pad = (unsigned)(frac_cnt_ * LIMB_BITS - frac_bits);
+		std::fill_n (frac_, frac_cnt_, 0);
+		frac_ [0] = (uint32_t)(frac << pad);
+		if (frac_cnt_ > 1)
+			frac_ [1] = (uint32_t)(frac >> (LIMB_BITS - pad));
+		if (frac_cnt_ > 2 && pad)
+			frac_ [2] = (uint32_t)(frac >> (2 * LIMB_BITS - pad));
+		while (!frac_ [frac_lo_]) {
+			++frac_lo_;
+		}
+	}
+
+	if (group_cnt) {
+		while (!groups_ [groups_lo_]) {
+			++groups_lo_;
+		}
+		group_ = groups_ [--group_cnt];
+		group_digits_ = FloatToDecimal::digits (group_);
+		group_cnt_ = group_cnt;
+		magnitude_ = (int)(group_cnt * 9 + group_digits_) - 1;
+	} else {
+		// Skip the leading zeros of the fraction
+		unsigned d;
+		int zeros = 0;
+		while (!(d = next_frac ())) {
+			++zeros;
+		}
+		pending_ = (int)d;
+		magnitude_ = -zeros - 1;
+	}
+}
+
+unsigned ExactDecimal::next_frac () noexcept
+{
+	uint64_t carry = 0;
+	for (size_t i = frac_lo_; i < frac_cnt_; ++i) {
+		uint64_t x = (uint64_t)frac_ [i] * 10 + carry;
+		frac_ [i] = (uint32_t)x;
+		carry = x >> LIMB_BITS;
+	}
+	while (frac_lo_ < frac_cnt_ && !frac_ [frac_lo_]) {
+		++frac_lo_;
+	}
+	return (unsigned)carry;
+}
+
+// Write n digits rounded half to even.
+// Returns `true` if the rounding carried out of the first digit, the digits are zeros then.
+bool put_rounded (ExactDecimal& dec, char* p, size_t n) noexcept
+{
+	char* end = p + n;
+	for (char* q = p; q != end; ++q) {
+		if (dec.exhausted ()) {
+			memset (q, '0', end - q);
+			return false;
+		}
+		*q = (char)('0' + dec.next ());
+	}
+	unsigned d = dec.next ();
+	// The digit characters have the same parity as the digits
+	if (d > 5 || (d == 5 && (!dec.exhausted () || (n && (end [-1] & 1))))) {
+		for (char* q = end; q != p;) {
+			if (*--q != '9') {
+				++*q;
+				return false;
+			}
+			*q = '0';
+		}
+		return true;
+	}
+	return false;
+}
+
+// Round the value to n significant digits.
+// Obtains the decimal exponent and the number of digits without the trailing zeros.
+void round_significant (ExactDecimal& dec, unsigned n, int& magnitude, unsigned& count) noexcept
+{
+	magnitude = dec.magnitude ();
+	unsigned last_nonzero = 0, last_non9 = 0, d = 0;
+	bool up = false;
+	for (unsigned i = 1; i <= n; ++i) {
+		d = dec.next ();
+		if (d)
+			last_nonzero = i;
+		if (d != 9)
+			last_non9 = i;
+		if (dec.exhausted ())
+			break;
+	}
+	if (!dec.exhausted ()) {
+		unsigned r = dec.next ();
+		up = r > 5 || (r == 5 && (!dec.exhausted () || (d & 1)));
+	}
+	if (!up)
+		count = last_nonzero ? last_nonzero : 1;
+	else if (last_non9)
+		count = last_non9;
+	else {
+		count = 1;
+		++magnitude;
+	}
+}
+
+size_t exponent_len (int exp) noexcept
+{
+	unsigned e = exp < 0 ? 0 - (unsigned)exp : (unsigned)exp;
+	return e >= 1000 ? 6 : e >= 100 ? 5 : 4;
+}
+
+// Write the decimal exponent, at least two digits as printf does.
+char* put_exponent (char* p, int exp) noexcept
+{
+	unsigned e = exp < 0 ? 0 - (unsigned)exp : (unsigned)exp;
+	*(p++) = 'e';
+	*(p++) = exp < 0 ? '-' : '+';
+	if (e >= 100) {
+		if (e >= 1000) {
+			*(p++) = (char)('0' + e / 1000);
+			e %= 1000;
+		}
+		*(p++) = (char)('0' + e / 100);
+		e %= 100;
+	}
+	memcpy (p, digit_pairs + e * 2, 2);
+	return p + 2;
+}
+
+// Scientific notation with the precision digits after the decimal point.
+to_chars_result put_scientific (char* first, char* last, ExactDecimal& dec, unsigned precision)
+	noexcept
+{
+	int x = dec.magnitude ();
+	size_t n = (size_t)precision + 1;
+
+	// The digits are written after the first position, then the first digit is moved before
+	// the decimal point.
+	if ((size_t)(last - first) < n + 1)
+		return too_large (last);
+	if (put_rounded (dec, first + 1, n)) {
+		first [1] = '1';
+		++x;
+	}
+	char* p = first + 1;
+	first [0] = first [1];
+	if (precision) {
+		first [1] = '.';
+		p += n;
+	}
+	if ((size_t)(last - p) < exponent_len (x))
+		return too_large (last);
+	return { put_exponent (p, x), std::errc () };
+}
+
+// Fixed notation with the precision digits after the decimal point.
+to_chars_result put_fixed (char* first, char* last, ExactDecimal& dec, unsigned precision) noexcept
+{
+	const int x = dec.magnitude ();
+	const long long n = (long long)x + 1 + precision; // Number of significant digits
+	const size_t avail = last - first;
+
+	if (x >= 0) {
+		size_t len = (size_t)n + (precision > 0);
+		if (avail < len)
+			return too_large (last);
+		char* p = first + n;
+		if (put_rounded (dec, first, (size_t)n)) {
+			if (avail < ++len)
+				return too_large (last);
+			first [0] = '1';
+			*(p++) = '0';
+		}
+		if (precision) {
+			memmove (p - precision + 1, p - precision, precision);
+			p [-(int)precision] = '.';
+			++p;
+		}
+		return { p, std::errc () };
+	} else {
+		size_t len = 1 + (precision > 0) + (size_t)precision;
+		if (avail < len)
+			return too_large (last);
+		char* p = first;
+		*(p++) = '0';
+		if (precision)
+			*(p++) = '.';
+		if (n < 0) {
+			// The value is less than the half of the last digit
+			memset (p, '0', precision);
+		} else {
+			size_t zeros = -x - 1;
+			memset (p, '0', zeros);
+			if (put_rounded (dec, p + zeros, (size_t)n)) {
+				char* c = p + zeros - 1;
+				if ('.' == *c)
+					--c;
+				*c = '1';
+			}
+		}
+		return { first + len, std::errc () };
+	}
+}
+
+// As printf "%g" without the '#' flag: the trailing zeros are removed.
+to_chars_result put_general (char* first, char* last, ExactDecimal& dec, unsigned precision) noexcept
+{
+	if (!precision)
+		precision = 1;
+
+	// The first pass obtains the exponent and the digit count of the rounded value
+	ExactDecimal probe (dec);
+	int x;
+	unsigned cnt;
+	round_significant (probe, precision, x, cnt);
+
+	const size_t avail = last - first;
+	if ((int)precision > x && x >= -4) {
+		if (x >= 0) {
+			unsigned whole = x + 1;
+			size_t len = std::max (cnt, whole) + (cnt > whole);
+			if (avail < len)
+				return too_large (last);
+			if (put_rounded (dec, first, cnt))
+				first [0] = '1';
+			if (cnt > whole) {
+				memmove (first + whole + 1, first + whole, cnt - whole);
+				first [whole] = '.';
+			} else
+				memset (first + cnt, '0', whole - cnt);
+			return { first + len, std::errc () };
+		} else {
+			size_t zeros = -x - 1;
+			size_t len = 2 + zeros + cnt;
+			if (avail < len)
+				return too_large (last);
+			first [0] = '0';
+			first [1] = '.';
+			memset (first + 2, '0', zeros);
+			if (put_rounded (dec, first + 2 + zeros, cnt))
+				first [2 + zeros] = '1';
+			return { first + len, std::errc () };
+		}
+	} else {
+		size_t len = cnt + (cnt > 1) + exponent_len (x);
+		if (avail < len)
+			return too_large (last);
+		if (put_rounded (dec, first + 1, cnt))
+			first [1] = '1';
+		first [0] = first [1];
+		char* p = first + 1;
+		if (cnt > 1) {
+			first [1] = '.';
+			p += cnt;
+		}
+		return { put_exponent (p, x), std::errc () };
+	}
+}
+
+// The decimal digits of the floating point value.
+struct Digits
+{
+	char digits [40];
+
+	// Number of significant digits without trailing zeros.
+	unsigned count;
+
+	// The decimal exponent of the first digit.
+	int magnitude;
+};
+
+void get_digits (uint64_t significand, int exponent, Digits& dig) noexcept
+{
+	while (significand >= 10 && significand % 10 == 0) {
+		significand /= 10;
+		++exponent;
+	}
+	unsigned n = FloatToDecimal::digits (significand);
+	char* p = dig.digits + n;
+	do {
+		*--p = (char)('0' + significand % 10);
+		significand /= 10;
+	} while (p > dig.digits);
+	dig.count = n;
+	dig.magnitude = exponent + (int)n - 1;
+}
+
+// Shortest digits of the finite non-zero value.
+
+void shortest (double value, Digits& dig) noexcept
+{
+	FloatToDecimal dec = FloatToDecimal::shortest (value);
+	get_digits (dec.significand (), dec.exponent (), dig);
+}
+
+void shortest (float value, Digits& dig) noexcept
+{
+	FloatToDecimal dec = FloatToDecimal::shortest (value);
+	get_digits (dec.significand (), dec.exponent (), dig);
+}
+
+void shortest (long double value, Digits& dig) noexcept
+{
+	if (std::numeric_limits <long double>::digits == std::numeric_limits <double>::digits)
+		shortest ((double)value, dig);
+	else {
+		// There is no shortest algorithm for the extended precision.
+		// The exact digits are rounded to 1, 2... digits until the value round trips,
+		// max_digits10 digits are always enough.
+		const unsigned MAX_DIGITS = std::numeric_limits <long double>::max_digits10;
+		ExactDecimal dec (value);
+		char exact [MAX_DIGITS + 1];
+		for (char* p = exact; p != std::end (exact); ++p) {
+			*p = (char)('0' + dec.next ());
+		}
+		const bool sticky = !dec.exhausted ();
+
+		for (unsigned n = 1; n <= MAX_DIGITS; ++n) {
+			bool rest = sticky;
+			for (unsigned i = n + 1; i <= MAX_DIGITS && !rest; ++i) {
+				rest = exact [i] != '0';
+			}
+			unsigned d = exact [n] - '0';
+			bool up = d > 5 || (d == 5 && (rest || (exact [n - 1] & 1)));
+
+			// Try the nearest candidate first, then the other neighbour.
+			for (int attempt = 0; attempt < 2; ++attempt, up = !up) {
+				memcpy (dig.digits, exact, n);
+				int magnitude = dec.magnitude ();
+				if (up) {
+					char* q = dig.digits + n;
+					for (;;) {
+						if (q == dig.digits) {
+							dig.digits [0] = '1';
+							++magnitude;
+							break;
+						}
+						if (*--q != '9') {
+							++*q;
+							break;
+						}
+						*q = '0';
+					}
+				}
+
+				char buf [MAX_DIGITS + 8];
+				memcpy (buf, dig.digits, n);
+				char* end = put_exponent (buf + n, magnitude - (int)n + 1);
+				long double v;
+				from_chars_result res = from_chars (buf, end, v, chars_format::scientific);
+				if (res.ec == std::errc () && v == value) {
+					unsigned cnt = n;
+					while (cnt > 1 && dig.digits [cnt - 1] == '0') {
+						--cnt;
+					}
+					dig.count = cnt;
+					dig.magnitude = magnitude;
+					return;
+				}
+			}
+		}
+		assert (false);
+	}
+}
+
+// Integral values below the limit are written with the trailing zeros of the shortest
+// representation, the greater values are written exactly.
+
+template <typename F> inline
+F exact_limit () noexcept
+{
+	return std::ldexp ((F)1, std::numeric_limits <F>::digits);
+}
+
+to_chars_result put_scientific (char* first, char* last, const Digits& dig) noexcept
+{
+	size_t len = dig.count + (dig.count > 1) + exponent_len (dig.magnitude);
+	if ((size_t)(last - first) < len)
+		return too_large (last);
+
+	char* p = first;
+	*(p++) = dig.digits [0];
+	if (dig.count > 1) {
+		*(p++) = '.';
+		memcpy (p, dig.digits + 1, dig.count - 1);
+		p += dig.count - 1;
+	}
+	return { put_exponent (p, dig.magnitude), std::errc () };
+}
+
+template <typename F>
+to_chars_result put_fixed (char* first, char* last, const Digits& dig, F value) noexcept
+{
+	const int n = (int)dig.count;
+	const int x = dig.magnitude;
+	if (x >= n && !(value < exact_limit <F> ()))
+	{
+		ExactDecimal dec (value);
+		return put_fixed (first, last, dec, 0);
+	}
+
+	size_t len = x >= 0 ? std::max (n, x + 1) + (n > x + 1) : n + 1 - x;
+	if ((size_t)(last - first) < len)
+		return too_large (last);
+
+	char* p = first;
+	if (x < 0) {
+		*(p++) = '0';
+		*(p++) = '.';
+		memset (p, '0', -x - 1);
+		p += -x - 1;
+		memcpy (p, dig.digits, n);
+		p += n;
+	} else if (n > x + 1) {
+		memcpy (p, dig.digits, x + 1);
+		p += x + 1;
+		*(p++) = '.';
+		memcpy (p, dig.digits + x + 1, n - x - 1);
+		p += n - x - 1;
+	} else {
+		memcpy (p, dig.digits, n);
+		p += n;
+		memset (p, '0', x + 1 - n);
+		p += x + 1 - n;
+	}
+	return { p, std::errc () };
+}
+
+// Write infinity, NaN or zero.
+template <typename F>
+bool put_special (char*& first, char* last, F value, to_chars_result& res) noexcept
+{
+	if (std::signbit (value)) {
+		if (first == last) {
+			res = too_large (last);
+			return true;
+		}
+		*(first++) = '-';
+	}
+	if (std::isnan (value))
+		res = put (first, last, "nan", 3);
+	else if (std::isinf (value))
+		res = put (first, last, "inf", 3);
+	else
+		return false;
+	return true;
+}
+
+template <typename F>
+to_chars_result to_chars_shortest (char* first, char* last, F value, chars_format fmt) noexcept
+{
+	to_chars_result res;
+	if (put_special (first, last, value, res))
+		return res;
+
+	Digits dig;
+	if (value == 0) {
+		dig.digits [0] = '0';
+		dig.count = 1;
+		dig.magnitude = 0;
+	} else
+		shortest (std::fabs (value), dig);
+
+	const int n = (int)dig.count;
+	const int x = dig.magnitude;
+	bool fixed;
+	switch (fmt) {
+		case chars_format::fixed:
+			fixed = true;
+			break;
+		case chars_format::scientific:
+			fixed = false;
+			break;
+		case chars_format::general:
+			// As printf "%g" with precision 6.
+			fixed = -4 <= x && x < 6;
+			break;
+		default: {
+			// Plain: the fixed notation length is compared to "d.ddde-XX".
+			unsigned e = x < 0 ? 0 - (unsigned)x : (unsigned)x;
+			const int sci_len = n + (n > 1) + (e >= 1000 ? 6 : e >= 100 ? 5 : 4);
+			const int fixed_len = x >= 0 ? std::max (n, x + 1) + (n > x + 1) : n + 1 - x;
+			fixed = fixed_len <= sci_len;
+		}
+	}
+
+	if (fixed)
+		return put_fixed (first, last, dig, std::fabs (value));
+	else
+		return put_scientific (first, last, dig);
+}
+
+// Hexadecimal significand of the finite value: lead.frac * 2 ^ exp.
+// The fraction is left aligned in 64 bits.
+// The leading digit is 1 or 0 for the subnormal values. For the 64-bit significand with
+// the explicit integer bit, the leading digit is the first 4 bits as glibc does.
+template <typename F>
+void hex_parts (F value, unsigned& lead, uint64_t& frac, unsigned& frac_digits, int& exp) noexcept
+{
+	const int MANT_BITS = std::numeric_limits <F>::digits - 1;
+	static_assert (MANT_BITS < 64, "Unexpected floating point format");
+	const int MIN_EXP = std::numeric_limits <F>::min_exponent - 1;
+
+	frac_digits = MANT_BITS == 63 ? 15 : (MANT_BITS + 3) / 4;
+	if (value == 0) {
+		lead = 0;
+		frac = 0;
+		exp = 0;
+		return;
+	}
+
+	int e;
+	std::frexp (value, &e);
+	if (MANT_BITS == 63) {
+		uint64_t m = (uint64_t)std::ldexp (value, 64 - e);
+		lead = (unsigned)(m >> 60);
+		frac = m << 4;
+		exp = e - 4;
+	} else {
+		exp = std::max (e - 1, MIN_EXP);
+		uint64_t m = (uint64_t)std::ldexp (value, MANT_BITS - exp);
+		lead = (unsigned)(m >> MANT_BITS);
+		frac = m << (64 - MANT_BITS);
+	}
+}
+
+template <typename F>
+to_chars_result to_chars_hex (char* first, char* last, F value, int precision) noexcept
+{
+	to_chars_result res;
+	if (put_special (first, last, value, res))
+		return res;
+
+	unsigned lead;
+	uint64_t frac;
+	unsigned frac_digits;
+	int exp;
+	hex_parts (std::fabs (value), lead, frac, frac_digits, exp);
+
+	if (precision < 0) {
+		// Shortest
+		while (frac_digits && !(frac << (frac_digits - 1) * 4))
+			--frac_digits;
+		if (!frac)
+			frac_digits = 0;
+	} else if ((unsigned)precision < frac_digits) {
+		// Round half to even
+		unsigned drop = 64 - precision * 4;
+		uint64_t rest = drop < 64 ? frac << (64 - drop) : frac;
+		uint64_t kept = drop < 64 ? frac >> drop : 0;
+		const uint64_t HALF = (uint64_t)1 << 63;
+		bool odd = precision ? (kept & 1) : (lead & 1);
+		if (rest > HALF || (rest == HALF && odd)) {
+			if (precision) {
+				++kept;
+				if (kept >> (precision * 4)) {
+					kept = 0;
+					++lead;
+				}
+			} else
+				++lead;
+		}
+		frac = precision ? kept << drop : 0;
+		frac_digits = precision;
+		if (lead == 16) {
+			lead = 1;
+			exp += 4;
+		}
+	}
+
+	unsigned e = exp < 0 ? 0 - (unsigned)exp : (unsigned)exp;
+	unsigned pad = precision > (int)frac_digits ? precision - frac_digits : 0;
+	size_t len = 1 + (frac_digits + pad > 0) + frac_digits + pad + 2
+		+ (e >= 10000 ? 5 : e >= 1000 ? 4 : e >= 100 ? 3 : e >= 10 ? 2 : 1);
+	if ((size_t)(last - first) < len)
+		return too_large (last);
+
+	char* p = first;
+	*(p++) = digit_chars [lead];
+	if (frac_digits + pad > 0) {
+		*(p++) = '.';
+		for (unsigned i = 0; i < frac_digits; ++i) {
+			*(p++) = digit_chars [frac >> 60];
+			frac <<= 4;
+		}
+		memset (p, '0', pad);
+		p += pad;
+	}
+	*(p++) = 'p';
+	*(p++) = exp < 0 ? '-' : '+';
+	return to_chars_unsigned (p, last, e, false, 10);
+}
+
+template <typename F>
+to_chars_result to_chars_prec (char* first, char* last, F value, chars_format fmt, int precision)
+	noexcept
+{
+	if (fmt == chars_format::hex)
+		return to_chars_hex (first, last, value, precision);
+
+	to_chars_result res;
+	if (put_special (first, last, value, res))
+		return res;
+
+	// As printf does, the negative precision is ignored.
+	if (precision < 0)
+		precision = 6;
+
+	ExactDecimal dec (std::fabs (value));
+	switch (fmt) {
+		case chars_format::fixed:
+			return put_fixed (first, last, dec, precision);
+		case chars_format::scientific:
+			return put_scientific (first, last, dec, precision);
+		default:
+			return put_general (first, last, dec, precision);
+	}
+}
+
+// Correctly rounded conversion of the decimal value.
+// Returns `false` if the conversion must be done by the slow path.
+
+inline
+bool decimal_fast (uint64_t significand, int exp, bool truncated, double& ret) noexcept
+{
+	if (!truncated) {
+		DecimalToFloat::convert (significand, exp, ret);
+		return true;
+	} else
+		return DecimalToFloat::convert_truncated (significand, exp, ret);
+}
+
+inline
+bool decimal_fast (uint64_t significand, int exp, bool truncated, float& ret) noexcept
+{
+	if (!truncated) {
+		DecimalToFloat::convert (significand, exp, ret);
+		return true;
+	} else
+		return DecimalToFloat::convert_truncated (significand, exp, ret);
+}
+
+inline
+bool decimal_fast (uint64_t significand, int exp, bool truncated, long double& ret) noexcept
+{
+	if (std::numeric_limits <long double>::digits == std::numeric_limits <double>::digits) {
+		double d;
+		bool ok = decimal_fast (significand, exp, truncated, d);
+		ret = d;
+		return ok;
+	}
+	return false;
+}
+
+// Round the binary value (m + g / 16) * 2 ^ exp to F.
+// The sticky flag means that some non-zero bits are below g.
+template <typename F>
+F round_binary (uint64_t m, unsigned g, bool sticky, int exp) noexcept
+{
+	const int p = std::numeric_limits <F>::digits;
+	const int qmin = std::numeric_limits <F>::min_exponent - p;
+	const int qmax = std::numeric_limits <F>::max_exponent - p;
+
+	// Normalize: value = (hi + lo / 2 ^ 64) * 2 ^ exp, hi has the most significant bit set.
+	unsigned s = nlz (m);
+	uint64_t hi = m << s;
+	uint64_t lo = (uint64_t)g << 60;
+	if (s) {
+		hi |= lo >> (64 - s);
+		lo <<= s;
+	}
+	exp -= s;
+
+	// Keep p bits
+	int e = exp + 64 - p;
+	int shift = 64 - p;
+	if (e < qmin) {
+		shift += qmin - e;
+		e = qmin;
+	}
+	if (shift > 64)
+		return 0;
+
+	uint64_t mant;
+	bool round_up;
+	if (shift == 0) {
+		mant = hi;
+		const uint64_t HALF = (uint64_t)1 << 63;
+		round_up = lo > HALF || (lo == HALF && (sticky || (mant & 1)));
+	} else if (shift < 64) {
+		mant = hi >> shift;
+		uint64_t rest = hi & (((uint64_t)1 << shift) - 1);
+		uint64_t half = (uint64_t)1 << (shift - 1);
+		round_up = rest > half || (rest == half && (lo || sticky || (mant & 1)));
+	} else {
+		mant = 0;
+		const uint64_t HALF = (uint64_t)1 << 63;
+		round_up = hi > HALF || (hi == HALF && (lo || sticky));
+	}
+
+	if (round_up) {
+		++mant;
+		if (p < 64 ? (mant >> p) != 0 : mant == 0) {
+			mant = (uint64_t)1 << (p - 1);
+			++e;
+		}
+	}
+
+	if (e > qmax)
+		return std::numeric_limits <F>::infinity ();
+	return std::ldexp ((F)mant, e);
+}
+
+template <typename F>
+from_chars_result from_chars_hex (const char* first, const char* p, const char* last, F& value)
+	noexcept
+{
+	// Up to 16 significant digits are collected in m, the next one in g.
+	uint64_t m = 0;
+	unsigned g = 0;
+	unsigned kept = 0;
+	bool sticky = false;
+	int exp = 0;
+	bool any = false;
+	unsigned d;
+
+	for (; p != last && (d = hex_digit (*p)) < 16; ++p) {
+		any = true;
+		if (kept < 16) {
+			if (kept || d) {
+				m = (m << 4) | d;
+				++kept;
+			}
+		} else {
+			if (kept == 16) {
+				g = d;
+				++kept;
+			} else
+				sticky |= d != 0;
+			exp += 4;
+		}
+	}
+	if (p != last && *p == '.') {
+		++p;
+		for (; p != last && (d = hex_digit (*p)) < 16; ++p) {
+			any = true;
+			if (kept < 16) {
+				if (kept || d) {
+					m = (m << 4) | d;
+					++kept;
+				}
+				exp -= 4;
+			} else if (kept == 16) {
+				g = d;
+				++kept;
+			} else
+				sticky |= d != 0;
+		}
+	}
+	if (!any)
+		return { first, std::errc::invalid_argument };
+
+	if (p != last && (*p == 'p' || *p == 'P')) {
+		const char* pe = p + 1;
+		bool neg = pe != last && *pe == '-';
+		if (pe != last && (*pe == '-' || *pe == '+'))
+			++pe;
+		int e = 0;
+		const char* end = pe;
+		for (; end != last && is_digit (*end); ++end) {
+			if (e < 100000)
+				e = e * 10 + (*end - '0');
+		}
+		if (end != pe) {
+			exp += neg ? -e : e;
+			p = end;
+		}
+	}
+
+	F r = m ? round_binary <F> (m, g, sticky, exp) : 0;
+	if (m && (r == 0 || std::isinf (r)))
+		return { p, std::errc::result_out_of_range };
+
+	value = *first == '-' ? -r : r;
+	return { p, std::errc () };
+}
+
+template <typename F>
+from_chars_result from_chars_float (const char* first, const char* last, F& value,
+	chars_format fmt) noexcept
+{
+	const char* p = first;
+	bool neg = false;
+	if (p != last && *p == '-') {
+		neg = true;
+		++p;
+	}
+
+	if (p == last)
+		return { first, std::errc::invalid_argument };
+
+	if (match (p, last, "inf")) {
+		const char* inf = p;
+		if (!match (p, last, "inity"))
+			p = inf;
+		value = neg ? -std::numeric_limits <F>::infinity () : std::numeric_limits <F>::infinity ();
+		return { p, std::errc () };
+	} else if (match (p, last, "nan")) {
+		if (p != last && *p == '(') {
+			const char* q = p + 1;
+			while (q != last && (is_digit (*q) || ('a' <= (*q | 0x20) && (*q | 0x20) <= 'z')
+				|| *q == '_'))
+				++q;
+			if (q != last && *q == ')')
+				p = q + 1;
+		}
+		value = neg ? -std::numeric_limits <F>::quiet_NaN () : std::numeric_limits <F>::quiet_NaN ();
+		return { p, std::errc () };
+	}
+
+	if (fmt == chars_format::hex)
+		return from_chars_hex (first, p, last, value);
+
+	// Up to 19 significant digits are collected in the significand.
+	const char* digits = p;
+	uint64_t significand = 0;
+	unsigned sig_digits = 0;
+	bool truncated = false;
+	int exp = 0;
+	bool any = false;
+
+	for (; p != last && is_digit (*p); ++p) {
+		unsigned d = *p - '0';
+		any = true;
+		if (sig_digits < DecimalToFloat::SIGNIFICAND_DIGITS) {
+			if (significand || d) {
+				significand = significand * 10 + d;
+				++sig_digits;
+			}
+		} else {
+			truncated |= d != 0;
+			++exp;
+		}
+	}
+	if (p != last && *p == '.') {
+		++p;
+		for (; p != last && is_digit (*p); ++p) {
+			unsigned d = *p - '0';
+			any = true;
+			if (sig_digits < DecimalToFloat::SIGNIFICAND_DIGITS) {
+				if (significand || d) {
+					significand = significand * 10 + d;
+					++sig_digits;
+				}
+				--exp;
+			} else
+				truncated |= d != 0;
+		}
+	}
+	if (!any)
+		return { first, std::errc::invalid_argument };
+
+	bool has_exp = false;
+	if (((unsigned)fmt & (unsigned)chars_format::scientific) && p != last
+		&& (*p == 'e' || *p == 'E')) {
+		const char* pe = p + 1;
+		bool neg_exp = pe != last && *pe == '-';
+		if (pe != last && (*pe == '-' || *pe == '+'))
+			++pe;
+		// Limit the exponent to avoid the integer overflow. The result is zero or infinity anyway.
+		const int EXP_LIMIT = 100000;
+		int e = 0;
+		const char* end = pe;
+		for (; end != last && is_digit (*end); ++end) {
+			if (e < EXP_LIMIT)
+				e = e * 10 + (*end - '0');
+		}
+		if (end != pe) {
+			has_exp = true;
+			exp += neg_exp ? -e : e;
+			p = end;
+		}
+	}
+	if (fmt == chars_format::scientific && !has_exp)
+		return { first, std::errc::invalid_argument };
+
+	F r;
+	if (!significand)
+		r = 0;
+	else if (!decimal_fast (significand, exp, truncated, r)) {
+		// Slow path
+		try {
+			WideInBufUTF8 in (digits, p);
+			WideInEx in_ex (in);
+			in_ex.get_float (r);
+		} catch (...) {
+			r = std::numeric_limits <F>::infinity ();
+		}
+	}
+
+	if (significand && (r == 0 || std::isinf (r)))
+		return { p, std::errc::result_out_of_range };
+
+	value = neg ? -r : r;
+	return { p, std::errc () };
+}
+
+}
+
+to_chars_result to_chars_unsigned (char* first, char* last, uint64_t value, bool neg,
+	unsigned base) noexcept
+{
+	// The digit count is calculated first, then the digits are written from the end.
+	unsigned n;
+	switch (base) {
+		case 10:
+			n = FloatToDecimal::digits (value);
+			break;
+		case 2:
+		case 4:
+		case 8:
+		case 16:
+		case 32: {
+			unsigned shift = 64 - nlz ((uint64_t)base - 1);
+			n = (64 - nlz (value | 1) + shift - 1) / shift;
+		} break;
+		default:
+			n = 1;
+			for (uint64_t u = value; u >= base; u /= base) {
+				++n;
+			}
+	}
+
+	if ((size_t)(last - first) < n + neg)
+		return too_large (last);
+
+	if (neg)
+		*(first++) = '-';
+	char* end = first + n;
+	char* p = end;
+	if (base == 10) {
+		while (value >= 100) {
+			memcpy (p -= 2, digit_pairs + (value % 100) * 2, 2);
+			value /= 100;
+		}
+		if (value >= 10)
+			memcpy (p -= 2, digit_pairs + value * 2, 2);
+		else
+			*--p = (char)('0' + value);
+	} else {
+		do {
+			*--p = digit_chars [value % base];
+			value /= base;
+		} while (p > first);
+	}
+	return { end, std::errc () };
+}
+
+from_chars_result from_chars (const char* first, const char* last, double& value,
+	chars_format fmt) noexcept
+{
+	return from_chars_float (first, last, value, fmt);
+}
+
+from_chars_result from_chars (const char* first, const char* last, float& value,
+	chars_format fmt) noexcept
+{
+	return from_chars_float (first, last, value, fmt);
+}
+
+from_chars_result from_chars (const char* first, const char* last, long double& value,
+	chars_format fmt) noexcept
+{
+	return from_chars_float (first, last, value, fmt);
+}
+
+to_chars_result to_chars (char* first, char* last, double value) noexcept
+{
+	return to_chars_shortest (first, last, value, (chars_format)0);
+}
+
+to_chars_result to_chars (char* first, char* last, float value) noexcept
+{
+	return to_chars_shortest (first, last, value, (chars_format)0);
+}
+
+to_chars_result to_chars (char* first, char* last, long double value) noexcept
+{
+	return to_chars_shortest (first, last, value, (chars_format)0);
+}
+
+to_chars_result to_chars (char* first, char* last, double value, chars_format fmt) noexcept
+{
+	if (fmt == chars_format::hex)
+		return to_chars_hex (first, last, value, -1);
+	return to_chars_shortest (first, last, value, fmt);
+}
+
+to_chars_result to_chars (char* first, char* last, float value, chars_format fmt) noexcept
+{
+	if (fmt == chars_format::hex)
+		return to_chars_hex (first, last, value, -1);
+	return to_chars_shortest (first, last, value, fmt);
+}
+
+to_chars_result to_chars (char* first, char* last, long double value, chars_format fmt) noexcept
+{
+	if (fmt == chars_format::hex)
+		return to_chars_hex (first, last, value, -1);
+	return to_chars_shortest (first, last, value, fmt);
+}
+
+to_chars_result to_chars (char* first, char* last, double value, chars_format fmt,
+	int precision) noexcept
+{
+	return to_chars_prec (first, last, value, fmt, precision);
+}
+
+to_chars_result to_chars (char* first, char* last, float value, chars_format fmt,
+	int precision) noexcept
+{
+	return to_chars_prec (first, last, value, fmt, precision);
+}
+
+to_chars_result to_chars (char* first, char* last, long double value, chars_format fmt,
+	int precision) noexcept
+{
+	return to_chars_prec (first, last, value, fmt, precision);
+}
+
+}
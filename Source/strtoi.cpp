@@ -0,0 +1,205 @@
+/*
+* Nirvana runtime library.
+*
+* This is a part of the Nirvana project.
+*
+* Author: Igor Popov
+*
+* Copyright (c) 2025 Igor Popov.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU Lesser General Public
+* License along with this library.  If not, see <http://www.gnu.org/licenses/>.
+*
+* Send comments and/or bug reports to:
+*  popov.nirvana@gmail.com
+*/
+#include <Nirvana/strtoi.h>
+#include <Nirvana/bitutils.h>
+#include <string.h>
+#include <wctype.h>
+
+namespace Nirvana {
+
+namespace {
+
+inline bool is_space (char c) noexcept
+{
+	return c == ' ' || ('\t' <= c && c <= '\r');
+}
+
+inline bool is_space (wchar_t c) noexcept
+{
+	return iswspace (c);
+}
+
+// Load 8 checked decimal digits as the little endian byte vector.
+
+inline uint64_t load8 (const char* p) noexcept
+{
+	uint64_t v;
+	if (endian::native == endian::little)
+		memcpy (&v, p, 8);
+	else {
+		v = 0;
+		for (unsigned i = 0; i < 8; ++i) {
+			v |= (uint64_t)(uint8_t)p [i] << (i * 8);
+		}
+	}
+	return v;
+}
+
+inline uint64_t load8 (const wchar_t* p) noexcept
+{
+	uint64_t v = 0;
+	for (unsigned i = 0; i < 8; ++i) {
+		v |= (uint64_t)(uint8_t)p [i] << (i * 8);
+	}
+	return v;
+}
+
+}
+
+template <typename C>
+const C* IntParser <C>::parse (const C* begin, const C* end, unsigned base,
+	uint64_t neg_limit, uint64_t pos_limit, bool& neg, uint64_t& ret, bool& overflow) noexcept
+{
+	neg = false;
+	ret = 0;
+	overflow = false;
+
+	if (base == 1 || base > 36)
+		return begin;
+
+	const C* p = begin;
+	while (p != end && is_space (*p)) {
+		++p;
+	}
+
+	if (p != end) {
+		if (*p == '-') {
+			neg = true;
+			++p;
+		} else if (*p == '+')
+			++p;
+	}
+
+	// If base is 0, allow 0x for hex and 0 for octal, else assume decimal.
+	// If base is already 16, allow 0x.
+	// Recognize binary prefix only when base == 2.
+	if (p != end && *p == '0' && p + 1 != end) {
+		C c = p [1];
+		if ((base == 0 || base == 16) && (c == 'x' || c == 'X')) {
+			p += 2;
+			base = 16;
+		} else if (base == 2 && (c == 'b' || c == 'B'))
+			p += 2;
+	}
+	if (base == 0)
+		base = (p != end && *p == '0') ? 8 : 10;
+
+	const C* digits_end = parse_unsigned (p, end, base, neg ? neg_limit : pos_limit, ret, overflow);
+
+	if (digits_end == p) {
+		neg = false;
+		return begin;
+	}
+	return digits_end;
+}
+
+template <typename C>
+const C* IntParser <C>::parse_unsigned (const C* begin, const C* end, unsigned base,
+	uint64_t limit, uint64_t& ret, bool& overflow) noexcept
+{
+	ret = 0;
+	overflow = false;
+	if (base == 10)
+		return parse_decimal (begin, end, limit, ret, overflow);
+	else
+		return parse_digits (begin, end, base, limit, ret, overflow);
+}
+
+template <typename C>
+const C* IntParser <C>::parse_decimal (const C* p, const C* end, uint64_t limit,
+	uint64_t& ret, bool& overflow) noexcept
+{
+	// Leading zeros do not count
+	while (p != end && *p == '0') {
+		++p;
+	}
+	const C* digits = p;
+	while (p != end && '0' <= *p && *p <= '9') {
+		++p;
+	}
+
+	size_t cnt = p - digits;
+	if (cnt > 20) {
+		overflow = true;
+		return p;
+	}
+
+	// Up to 19 digits always fit in uint64_t
+	size_t fit = cnt < 19 ? cnt : 19;
+	const C* s = digits;
+	const C* s_end = digits + fit;
+	uint64_t u = 0;
+
+	// Convert 8 digits at once
+	for (; s_end - s >= 8; s += 8) {
+		uint64_t v = load8 (s) - 0x3030303030303030;
+		v = (v * 10) + (v >> 8);
+		v = (((v & 0x000000FF000000FF) * 0x000F424000000064)
+			+ (((v >> 16) & 0x000000FF000000FF) * 0x0000271000000001)) >> 32;
+		u = u * 100000000 + v;
+	}
+	for (; s != s_end; ++s) {
+		u = u * 10 + (unsigned)(*s - '0');
+	}
+
+	if (cnt == 20) {
+		unsigned d = (unsigned)(*s - '0');
+		if (u > (limit - d) / 10) {
+			overflow = true;
+			return p;
+		}
+		u = u * 10 + d;
+	} else if (u > limit) {
+		overflow = true;
+		return p;
+	}
+
+	ret = u;
+	return p;
+}
+
+template <typename C>
+const C* IntParser <C>::parse_digits (const C* p, const C* end, unsigned base, uint64_t limit,
+	uint64_t& ret, bool& overflow) noexcept
+{
+	uint64_t cutoff = limit / base;
+	unsigned cutlim = (unsigned)(limit % base);
+	uint64_t u = 0;
+	unsigned d;
+	for (; (d = digit (p, end)) < base; ++p) {
+		if (overflow || u > cutoff || (u == cutoff && d > cutlim))
+			overflow = true;
+		else
+			u = u * base + d;
+	}
+	ret = u;
+	return p;
+}
+
+template class IntParser <char>;
+template class IntParser <wchar_t>;
+
+}
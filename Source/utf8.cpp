@@ -25,79 +25,296 @@
 */
 #include <Nirvana/utf8.h>
 #include <Nirvana/bitutils.h>
+#include <Nirvana/platform.h>
+#include <algorithm>
 
 namespace Nirvana {
 
-bool is_valid_utf8 (const char* p, size_t size) noexcept
-{
-	while (size >= 4) {
-		uint32_t c4 = *(const uint32_t*)p;
-		if ((c4 & 0x80808080) == 0) {
-			p += 4;
-			size -= 4;
-		} else if ((c4 & (endian::native == endian::big ? 0x80808000 : 0x00808080)) == 0) {
-			p += 3;
-			size -= 3;
-		} else if ((c4 & (endian::native == endian::big ? 0x80800000 : 0x00008080)) == 0) {
-			p += 2;
-			size -= 2;
-		} else if ((c4 & (endian::native == endian::big ? 0x80000000 : 0x00000080)) == 0) {
-			++p;
-			--size;
-		} else if ((c4 & (endian::native == endian::big ? 0xE0000000 : 0x000000E0))
-			== (endian::native == endian::big ? 0xC0000000 : 0x000000C0)) {
-			// 2 octets
-			if ((c4 & (endian::native == endian::big ? 0x00C00000 : 0x0000C000))
-				!= (endian::native == endian::big ? 0x00800000 : 0x00008000))
-				return false;
-			p += 2;
-			size -= 2;
-		} else if ((c4 & (endian::native == endian::big ? 0xF0000000 : 0x000000F0))
-			== (endian::native == endian::big ? 0xE0000000 : 0x000000E0)) {
-			// 3 octets
-			if ((c4 & 0x00C0C000) != 0x00808000)
-				return false;
-			p += 3;
-			size -= 3;
-		} else if ((c4 & (endian::native == endian::big ? 0xF8000000 : 0x000000F8))
-			== (endian::native == endian::big ? 0xF0000000 : 0x000000F0)) {
-			// 4 octets
-			if ((c4 & (endian::native == endian::big ? 0x00C0C0C0 : 0xC0C0C000))
-				!= (endian::native == endian::big ? 0x00808080 : 0x80808000))
-				return false;
-			p += 4;
-			size -= 4;
-		} else
+namespace {
+
+// ASCII runs are processed in blocks of two machine words. A UTF-8 block is tested
+// by the high bits of both words at once and copied without decoding.
+const size_t BLOCK_SIZE = sizeof (UWord) * 2;
+const UWord HIGH_BITS = ~(UWord)0 / 0xFF * 0x80;
+
+inline bool is_ascii_block (const uint8_t* p) noexcept
+{
+	const UWord* w = (const UWord*)p;
+	return !((w [0] | w [1]) & HIGH_BITS);
+}
+
+template <typename WC> inline
+bool is_ascii_block (const WC* p) noexcept
+{
+	uint32_t acc = 0;
+	for (size_t i = 0; i < BLOCK_SIZE; ++i) {
+		acc |= (uint32_t)p [i];
+	}
+	return acc < 0x80;
+}
+
+// Decode the sequence.
+// Returns the sequence length, 0 if the sequence is invalid
+// or -1 if the source ends inside the valid sequence.
+inline int decode (const uint8_t* p, const uint8_t* end, uint32_t& wc) noexcept
+{
+	unsigned c = p [0];
+	size_t avail = end - p;
+	if (c < 0x80) {
+		wc = c;
+		return 1;
+	} else if (c < 0xC2) {
+		return 0; // Continuation octet or overlong 2-octet sequence
+	} else if (c < 0xE0) {
+		if (avail < 2)
+			return -1;
+		unsigned c1 = p [1];
+		if ((c1 & 0xC0) != 0x80)
+			return 0;
+		wc = ((c & 0x1F) << 6) | (c1 & 0x3F);
+		return 2;
+	} else if (c < 0xF0) {
+		// The second octet range excludes overlongs and surrogates
+		unsigned lo = c == 0xE0 ? 0xA0 : 0x80, hi = c == 0xED ? 0x9F : 0xBF;
+		if (avail < 2)
+			return -1;
+		unsigned c1 = p [1];
+		if (c1 < lo || hi < c1)
+			return 0;
+		if (avail < 3)
+			return -1;
+		unsigned c2 = p [2];
+		if ((c2 & 0xC0) != 0x80)
+			return 0;
+		wc = ((c & 0x0F) << 12) | ((c1 & 0x3F) << 6) | (c2 & 0x3F);
+		return 3;
+	} else if (c < 0xF5) {
+		// The second octet range excludes overlongs and code points above U+10FFFF
+		unsigned lo = c == 0xF0 ? 0x90 : 0x80, hi = c == 0xF4 ? 0x8F : 0xBF;
+		if (avail < 2)
+			return -1;
+		unsigned c1 = p [1];
+		if (c1 < lo || hi < c1)
+			return 0;
+		if (avail < 3)
+			return -1;
+		unsigned c2 = p [2];
+		if ((c2 & 0xC0) != 0x80)
+			return 0;
+		if (avail < 4)
+			return -1;
+		unsigned c3 = p [3];
+		if ((c3 & 0xC0) != 0x80)
+			return 0;
+		wc = ((c & 0x07) << 18) | ((c1 & 0x3F) << 12) | ((c2 & 0x3F) << 6) | (c3 & 0x3F);
+		return 4;
+	} else
+		return 0;
+}
+
+// Put the code point into the UTF-16 or UTF-32 destination.
+// Returns `false` if there is no room.
+template <typename WC> inline
+bool put_wide (uint32_t wc, WC*& dst, WC* dst_end) noexcept
+{
+	if (sizeof (WC) == 2 && wc > 0xFFFF) {
+		if (dst_end - dst < 2)
 			return false;
+		wc -= 0x10000;
+		*(dst++) = (WC)(0xD800 | (wc >> 10));
+		*(dst++) = (WC)(0xDC00 | (wc & 0x3FF));
+	} else
+		*(dst++) = (WC)wc;
+	return true;
+}
+
+// Result of the single character conversion
+enum class Step
+{
+	OK,
+	STOP, // Incomplete source or no room in the destination
+	INVALID
+};
+
+template <typename WC> inline
+Step to_wide (const uint8_t*& src, const uint8_t* end, WC*& dst, WC* dst_end) noexcept
+{
+	uint32_t wc;
+	int len = decode (src, end, wc);
+	if (len <= 0)
+		return len < 0 ? Step::STOP : Step::INVALID;
+	if (!put_wide (wc, dst, dst_end))
+		return Step::STOP;
+	src += len;
+	return Step::OK;
+}
+
+template <typename WC> inline
+Step to_utf8 (const WC*& src, const WC* end, uint8_t*& dst, uint8_t* dst_end) noexcept
+{
+	uint32_t wc = (uint32_t)*src;
+	size_t units = 1;
+	if ((wc & ~0x7FF) == 0xD800) {
+		// Surrogate
+		if (sizeof (WC) != 2 || wc >= 0xDC00)
+			return Step::INVALID;
+		if (end - src < 2)
+			return Step::STOP; // The low surrogate is not available yet
+		uint32_t low = (uint32_t)src [1];
+		if ((low & ~0x3FF) != 0xDC00)
+			return Step::INVALID;
+		wc = 0x10000 + ((wc - 0xD800) << 10) + (low - 0xDC00);
+		units = 2;
+	} else if (wc > 0x10FFFF)
+		return Step::INVALID;
+
+	size_t room = dst_end - dst;
+	uint8_t* d = dst;
+	if (wc <= 0x7F) {
+		d [0] = (uint8_t)wc;
+		dst = d + 1;
+	} else if (wc <= 0x7FF) {
+		if (room < 2)
+			return Step::STOP;
+		d [0] = (uint8_t)(0xC0 | (wc >> 6));
+		d [1] = (uint8_t)(0x80 | (wc & 0x3F));
+		dst = d + 2;
+	} else if (wc <= 0xFFFF) {
+		if (room < 3)
+			return Step::STOP;
+		d [0] = (uint8_t)(0xE0 | (wc >> 12));
+		d [1] = (uint8_t)(0x80 | ((wc >> 6) & 0x3F));
+		d [2] = (uint8_t)(0x80 | (wc & 0x3F));
+		dst = d + 3;
+	} else {
+		if (room < 4)
+			return Step::STOP;
+		d [0] = (uint8_t)(0xF0 | (wc >> 18));
+		d [1] = (uint8_t)(0x80 | ((wc >> 12) & 0x3F));
+		d [2] = (uint8_t)(0x80 | ((wc >> 6) & 0x3F));
+		d [3] = (uint8_t)(0x80 | (wc & 0x3F));
+		dst = d + 4;
 	}
+	src += units;
+	return Step::OK;
+}
 
-	while (size > 0) {
-		unsigned c = *(p++);
-		--size;
-		if (c & 0x80) {
-			size_t ocnt; // additional octets count
-			if ((c & 0xE0) == 0xC0)
-				ocnt = 1;
-			else if ((c & 0xF0) == 0xE0)
-				ocnt = 2;
-			else if ((c & 0xF8) == 0xF0)
-				ocnt = 3;
-			else
-				return false;
-			if (ocnt > size)
-				return false;
-			while (ocnt--) {
-				c = *(p++);
-				--size;
-				if ((c & 0xC0) != 0x80)
-					return false;
-			}
+}
+
+// The loops below copy the whole ASCII blocks. If the block contains non-ASCII characters,
+// it is converted by characters and the next block is tried.
+
+bool is_valid_utf8 (const char* s, size_t size) noexcept
+{
+	const uint8_t* p = (const uint8_t*)s;
+	const uint8_t* end = p + size;
+	while (p < end) {
+		if ((size_t)(end - p) >= BLOCK_SIZE && is_ascii_block (p))
+			p += BLOCK_SIZE;
+		else {
+			const uint8_t* block_end = p + std::min ((size_t)(end - p), BLOCK_SIZE);
+			do {
+				if (*p < 0x80)
+					++p;
+				else {
+					uint32_t wc;
+					int len = decode (p, end, wc);
+					if (len <= 0)
+						return false;
+					p += len;
+				}
+			} while (p < block_end);
 		}
 	}
 
 	return true;
 }
 
+template <typename WC>
+bool utf8_to_wide (const char*& src, const char* end, WC*& dst, WC* dst_end) noexcept
+{
+	const uint8_t* p = (const uint8_t*)src;
+	const uint8_t* src_end = (const uint8_t*)end;
+	WC* d = dst;
+	Step step = Step::OK;
+	while (p < src_end && d < dst_end) {
+		if ((size_t)(src_end - p) >= BLOCK_SIZE && (size_t)(dst_end - d) >= BLOCK_SIZE
+			&& is_ascii_block (p)) {
+			d = std::copy (p, p + BLOCK_SIZE, d);
+			p += BLOCK_SIZE;
+		} else {
+			const uint8_t* block_end = p + std::min ((size_t)(src_end - p), BLOCK_SIZE);
+			do {
+				step = to_wide (p, src_end, d, dst_end);
+			} while (Step::OK == step && p < block_end && d < dst_end);
+			if (Step::OK != step)
+				break;
+		}
+	}
+	src = (const char*)p;
+	dst = d;
+	return Step::INVALID != step;
+}
+
+template
+bool utf8_to_wide (const char*& src, const char* end, char16_t*& dst, char16_t* dst_end) noexcept;
+
+template
+bool utf8_to_wide (const char*& src, const char* end, char32_t*& dst, char32_t* dst_end) noexcept;
+
+template
+bool utf8_to_wide (const char*& src, const char* end, wchar_t*& dst, wchar_t* dst_end) noexcept;
+
+template <typename WC>
+bool wide_to_utf8 (const WC*& src, const WC* end, char*& dst, char* dst_end) noexcept
+{
+	const WC* p = src;
+	uint8_t* d = (uint8_t*)dst;
+	uint8_t* out_end = (uint8_t*)dst_end;
+	Step step = Step::OK;
+	while (p < end && d < out_end) {
+		if ((size_t)(end - p) >= BLOCK_SIZE && (size_t)(out_end - d) >= BLOCK_SIZE
+			&& is_ascii_block (p)) {
+			d = std::copy (p, p + BLOCK_SIZE, d);
+			p += BLOCK_SIZE;
+		} else {
+			const WC* block_end = p + std::min ((size_t)(end - p), BLOCK_SIZE);
+			do {
+				step = to_utf8 (p, end, d, out_end);
+			} while (Step::OK == step && p < block_end && d < out_end);
+			if (Step::OK != step)
+				break;
+		}
+	}
+	src = p;
+	dst = (char*)d;
+	return Step::INVALID != step;
+}
+
+template
+bool wide_to_utf8 (const char16_t*& src, const char16_t* end, char*& dst, char* dst_end) noexcept;
+
+template
+bool wide_to_utf8 (const char32_t*& src, const char32_t* end, char*& dst, char* dst_end) noexcept;
+
+template
+bool wide_to_utf8 (const wchar_t*& src, const wchar_t* end, char*& dst, char* dst_end) noexcept;
+
+size_t ascii_len (const char* p, size_t size) noexcept
+{
+	const UWord HIGH_BITS = ~(UWord)0 / 0xFF * 0x80;
+	const char* begin = p;
+	while (size >= sizeof (UWord)) {
+		if (*(const UWord*)p & HIGH_BITS)
+			break;
+		p += sizeof (UWord);
+		size -= sizeof (UWord);
+	}
+	for (const char* end = p + size; p != end && !(*p & 0x80); ++p)
+		;
+	return p - begin;
+}
+
 int octet_cnt (int b) noexcept
 {
 	if ((b & ~0x7F) == 0)
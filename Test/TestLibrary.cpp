@@ -1,15 +1,29 @@
 ﻿#include <Nirvana/Nirvana.h>
+#include <CORBA/Server.h>
+#include <Nirvana/nls_s.h>
 #include <gtest/gtest.h>
 #include <Nirvana/bitutils.h>
 #include <Nirvana/Hash.h>
 #include <Nirvana/string_conv.h>
 #include <Nirvana/strtoi.h>
 #include <Nirvana/strtof.h>
+#include <Nirvana/ArrayParser.h>
+#include <Nirvana/charconv.h>
 #include <Nirvana/Formatter.h>
+#include <Nirvana/format.h>
 #include <Nirvana/Parser.h>
 #include <Nirvana/FloatToBCD.h>
+#include <Nirvana/FloatToDecimal.h>
 #include <Nirvana/Polynomial.h>
+#include <ctype.h>
+#include <locale.h>
+#include <time.h>
+#include <wchar.h>
+#include <wctype.h>
 #include <random>
+#include <charconv>
+#include <memory>
+#include "CodePageTable.h"
 
 #pragma float_control (precise, on)
 
@@ -174,6 +188,32 @@ TEST_F (TestLibrary, UTF8)
 	}
 }
 
+TEST_F (TestLibrary, UTF8Strict)
+{
+	// Overlong, surrogate and out of range sequences
+	EXPECT_FALSE (is_valid_utf8 ("\xC0\xAF", 2));
+	EXPECT_FALSE (is_valid_utf8 ("\xE0\x80\xAF", 3));
+	EXPECT_FALSE (is_valid_utf8 ("\xED\xA0\x80", 3));
+	EXPECT_FALSE (is_valid_utf8 ("\xF4\x90\x80\x80", 4));
+	EXPECT_TRUE (is_valid_utf8 ("\xF4\x8F\xBF\xBF", 4));
+
+	// Non-BMP character is converted to the UTF-16 surrogate pair
+	std::string src (300, 'a');
+	src += "\xF0\x9F\x98\x80";
+	std::u16string w;
+	append_wide (src, w);
+	ASSERT_EQ (w.size (), (size_t)302);
+	EXPECT_EQ (w [300], 0xD83D);
+	EXPECT_EQ (w [301], 0xDE00);
+	std::string s;
+	append_utf8 (w, s);
+	EXPECT_EQ (s, src);
+
+	std::wstring ws;
+	EXPECT_THROW (append_wide ("abc\xED\xA0\x80", ws), CORBA::CODESET_INCOMPATIBLE);
+	EXPECT_THROW (append_wide ("abc\xE2\x82", ws), CORBA::CODESET_INCOMPATIBLE);
+}
+
 TEST_F (TestLibrary, Exception)
 {
 	std::exception_ptr ep;
@@ -242,6 +282,60 @@ TEST_F (TestLibrary, StrToI)
 	}
 }
 
+TEST_F (TestLibrary, StrToI64)
+{
+	struct Test
+	{
+		const char* s;
+		unsigned base;
+		int end;
+		int64_t i64;
+		int err_i64;
+		uint64_t u64;
+		int err_u64;
+	};
+
+	static const Test tests [] = {
+		// s,                           base, end,     int64_t,  error,     uint64_t,  error
+		{ " \t+0000000000000000000000012", 10,  -1,          12,      0,           12,      0 },
+		{ "9223372036854775807",           10,  -1,   INT64_MAX,      0,    INT64_MAX,      0 },
+		{ "-9223372036854775808",          10,  -1,   INT64_MIN,      0, 1ULL << 63,       0 },
+		{ "-9223372036854775809",          10,  -1,   INT64_MIN, ERANGE,   UINT64_MAX, ERANGE },
+		{ "18446744073709551615",          10,  -1,          -1,      0,   UINT64_MAX,      0 },
+		{ "18446744073709551616",          10,  -1,   INT64_MAX, ERANGE,   UINT64_MAX, ERANGE },
+		{ "100000000000000000000",         10,  -1,   INT64_MAX, ERANGE,   UINT64_MAX, ERANGE },
+		{ "-1",                            10,  -1,          -1,      0,   UINT64_MAX,      0 },
+		{ "12345678901234567x",             0,  17, 12345678901234567, 0, 12345678901234567, 0 },
+		{ "0777",                           0,  -1,         511,      0,          511,      0 },
+		{ "0b101",                          2,  -1,           5,      0,            5,      0 },
+		{ "zz",                            36,  -1,        1295,      0,         1295,      0 },
+		{ "-",                             10,   0,           0, EINVAL,            0, EINVAL },
+		{ "1",                              1,   0,           0, EINVAL,            0, EINVAL }
+	};
+
+	for (size_t i = 0; i < std::size (tests); ++i) {
+		const Test& test = tests [i];
+		const char* s_end = test.end < 0 ? test.s + strlen (test.s) : test.s + test.end;
+		char* end;
+
+		int64_t i64;
+		ASSERT_EQ (strtoi (test.s, &end, test.base, i64), test.err_i64) << i;
+		EXPECT_EQ (i64, test.i64) << i;
+		EXPECT_EQ (end, s_end) << i;
+
+		uint64_t u64;
+		ASSERT_EQ (strtoi (test.s, &end, test.base, u64), test.err_u64) << i;
+		EXPECT_EQ (u64, test.u64) << i;
+		EXPECT_EQ (end, s_end) << i;
+
+		std::wstring ws (test.s, test.s + strlen (test.s));
+		wchar_t* wend;
+		ASSERT_EQ (strtoi (ws.c_str (), &wend, test.base, i64), test.err_i64) << i;
+		EXPECT_EQ (i64, test.i64) << i;
+		EXPECT_EQ (wend - ws.c_str (), s_end - test.s) << i;
+	}
+}
+
 std::string f2str (long double whole)
 {
 	std::string s;
@@ -274,6 +368,36 @@ TEST_F (TestLibrary, FloatToBCD)
 	}
 }
 
+TEST_F (TestLibrary, FloatToDecimal)
+{
+	char buf [FloatToDecimal::SHORTEST_MAX + 1];
+
+	*FloatToDecimal::to_chars (0.1, buf) = 0;
+	EXPECT_STREQ (buf, "0.1");
+	*FloatToDecimal::to_chars (0.1f, buf) = 0;
+	EXPECT_STREQ (buf, "0.1");
+	*FloatToDecimal::to_chars (100.0, buf) = 0;
+	EXPECT_STREQ (buf, "100");
+	*FloatToDecimal::to_chars (1e22, buf) = 0;
+	EXPECT_STREQ (buf, "1e+22");
+	*FloatToDecimal::to_chars (-std::numeric_limits <double>::max (), buf) = 0;
+	EXPECT_STREQ (buf, "-1.7976931348623157e+308");
+
+	std::uniform_int_distribution <uint64_t> dist;
+	std::mt19937 gen;
+	for (int i = 0; i < 100000; ++i) {
+		uint64_t bits = dist (gen);
+		double d0;
+		memcpy (&d0, &bits, sizeof (d0));
+		if (!std::isfinite (d0))
+			continue;
+		*FloatToDecimal::to_chars (d0, buf) = 0;
+		double d;
+		ASSERT_EQ (strtof (buf, (char**)nullptr, d), 0) << buf;
+		ASSERT_EQ (d, d0) << buf;
+	}
+}
+
 TEST_F (TestLibrary, Polynomial)
 {
 	Polynomial <10, 62> poly;
@@ -389,6 +513,307 @@ TEST_F (TestLibrary, StrToF)
 	}
 }
 
+TEST_F (TestLibrary, StrToFRounding)
+{
+	static const struct
+	{
+		const char* s;
+		double d;
+	} dtests [] = {
+		{ "0.789528489", 0.789528489 },
+		{ "1.66356079e+28", 1.66356079e+28 },
+		{ "-4.9915437e+113", -4.9915437e+113 },
+		{ "3.37521285e+19", 3.37521285e+19 },
+		{ "9007199254740993", 9007199254740992.0 },
+		{ "9007199254740995", 9007199254740996.0 },
+		{ "2.2250738585072011e-308", 2.2250738585072011e-308 },
+		{ "4.9406564584124654e-324", 4.9406564584124654e-324 },
+		{ "1.7976931348623157e308", 1.7976931348623157e308 },
+		{ "123456789012345678901234567890", 123456789012345678901234567890.0 },
+		{ "0.000000000000000000000000000000001e33", 1 },
+		{ "1e-400", 0 },
+		{ "9007199254740993.0000000000000000001", 9007199254740994.0 },
+		{ "9007199254740992.9999999999999999999", 9007199254740992.0 },
+		{ "2.4703282292062327208828439643411068618252990130716238221279284125033775363510437593264991818081799618989828234772285886546332835517796989819938739800539093906315035659515570226392290858392449105184435931802849936536152500319370457678249219365623669863658480757001585769269903706311928279558551332927834338409351978015531246597263579574622766465272827220056374006485499977096599470454020828166226237857393450736339007967761930577506740176324673600968951340535537458516661134223766678604162159680461914467291840300530057530849048765391711386591646239524912623653881879636239373280423891018672348497668235089863388587925628302755995657524455507255189313690836254779186948667994968324049705821028513185451396213837722826145437693412532098591327667236328125e-324", 0 },
+		{ "2.47032822920623272088284396434110686182529901307162382212792841250337753635104375932649918180817996189898282347722858865463328355177969898199387398005390939063150356595155702263922908583924491051844359318028499365361525003193704576782492193656236698636584807570015857692699037063119282795585513329278343384093519780155312465972635795746227664652728272200563740064854999770965994704540208281662262378573934507363390079677619305775067401763246736009689513405355374585166611342237666786041621596804619144672918403005300575308490487653917113865916462395249126236538818796362393732804238910186723484976682350898633885879256283027559956575244555072551893136908362547791869486679949683240497058210285131854513962138377228261454376934125320985913276672363281251e-324", 4.9406564584124654e-324 },
+		{ "0x1.8p1", 3 },
+		{ "0x1p-2", 0.25 },
+		{ "0x1.fffffffffffffp+1023", 0x1.fffffffffffffp+1023 },
+		{ "-0x1.9ap-4", -0x1.9ap-4 },
+		{ "0x1p-1074", 0x1p-1074 }
+	};
+
+	for (const auto& test : dtests) {
+		double d;
+		char* end;
+		ASSERT_EQ (strtof (test.s, &end, d), 0) << test.s;
+		EXPECT_EQ (d, test.d) << test.s;
+		EXPECT_EQ (end, test.s + strlen (test.s)) << test.s;
+	}
+
+	static const struct
+	{
+		const char* s;
+		float f;
+	} ftests [] = {
+		{ ".6e11", 6e10f },
+		{ "2.8937119e7", 2.8937119e7f },
+		{ "1.000000059604644775390625", 1.0f },
+		{ "1.000000178813934326171875", 1.0000002384185791015625f },
+		{ "3.4028235e38", 3.4028235e38f },
+		{ "1e-45", 1e-45f }
+	};
+
+	for (const auto& test : ftests) {
+		float f;
+		char* end;
+		ASSERT_EQ (strtof (test.s, &end, f), 0) << test.s;
+		EXPECT_EQ (f, test.f) << test.s;
+		EXPECT_EQ (end, test.s + strlen (test.s)) << test.s;
+	}
+
+	if (std::numeric_limits <long double>::digits == 64) {
+		// Halfway between 1 and the next value is 1 + 2^-64
+		static const char half [] = "1.0000000000000000000542101086242752217003726400434970855712890625";
+		long double l;
+		ASSERT_EQ (strtof (half, (char**)nullptr, l), 0);
+		EXPECT_EQ (l, 1.0L);
+		std::string above (half);
+		above += "000000000000000000000000000001";
+		ASSERT_EQ (strtof (above.c_str (), (char**)nullptr, l), 0);
+		EXPECT_EQ (l, 1.0L + std::ldexp (1.0L, -63));
+		ASSERT_EQ (strtof ("0.1", (char**)nullptr, l), 0);
+		EXPECT_EQ (l, 0.1L);
+		ASSERT_EQ (strtof ("1e4000", (char**)nullptr, l), 0);
+		EXPECT_EQ (l, 1e4000L);
+	}
+
+	double d;
+	EXPECT_EQ (strtof ("1e400", (char**)nullptr, d), ERANGE);
+}
+
+TEST_F (TestLibrary, ArrayParser)
+{
+	const char* text = " 1, -2 ,3\n4\t5,";
+	std::vector <int> v;
+	EXPECT_EQ (ArrayParser::parse (text, text + strlen (text), ',', v), 0);
+	EXPECT_EQ (v, std::vector <int> ({ 1, -2, 3, 4, 5 }));
+
+	const char* err = nullptr;
+	text = "1,,2";
+	EXPECT_EQ (ArrayParser::parse (text, text + strlen (text), ',', v, &err), EINVAL);
+	EXPECT_EQ (err, text + 2);
+	text = "1,2x";
+	EXPECT_EQ (ArrayParser::parse (text, text + strlen (text), ',', v, &err), EINVAL);
+	EXPECT_EQ (err, text + 2);
+	text = "1 99999999999";
+	EXPECT_EQ (ArrayParser::parse (text, text + strlen (text), ',', v, &err), ERANGE);
+	EXPECT_EQ (err, text + 2);
+
+	// The numbers parsed before the error are not appended
+	EXPECT_EQ (v, std::vector <int> ({ 1, -2, 3, 4, 5 }));
+
+	// Large text is split into chunks
+	std::string big;
+	std::vector <double> expected;
+	std::mt19937_64 rndgen;
+	for (int i = 0; i < 100000; ++i) {
+		double d = std::uniform_real_distribution <double> (-1e10, 1e10) (rndgen);
+		expected.push_back (d);
+		Formatter::append_format (big, (i % 10 == 9) ? "%.17g\n" : "%.17g, ", d);
+	}
+
+	std::vector <ArrayParser::Chunk> chunks;
+	ArrayParser::split (big.data (), big.data () + big.size (), ',', 4, chunks);
+	EXPECT_EQ (chunks.size (), 4);
+
+	std::vector <double> values;
+	size_t tasks = 0;
+	EXPECT_EQ (ArrayParser::parse (big.data (), big.data () + big.size (), ',', values, 4,
+		[&tasks] (size_t cnt, auto& task) {
+			for (size_t i = 0; i < cnt; ++i) {
+				task (i);
+			}
+			tasks = cnt;
+		}), 0);
+	EXPECT_EQ (tasks, 4);
+	EXPECT_EQ (values, expected);
+}
+
+TEST_F (TestLibrary, CharConv)
+{
+	char buf [64];
+	char* const end = buf + sizeof (buf);
+	auto str = [&buf] (const to_chars_result& res) {
+		EXPECT_EQ (res.ec, std::errc ());
+		return std::string (buf, res.ptr);
+	};
+
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, -1234567890123LL)), "-1234567890123");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, INT64_MIN)), "-9223372036854775808");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, (short)-5)), "-5");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, (short)INT16_MIN)), "-32768");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, (signed char)-1)), "-1");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, (signed char)INT8_MIN)), "-128");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, (signed char)-16, 16)), "-10");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 255u, 16)), "ff");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 0, 2)), "0");
+	EXPECT_EQ (Nirvana::to_chars (buf, buf + 2, 100).ec, std::errc::value_too_large);
+
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 0.1)), "0.1");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1e5)), "1e+05");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 123456.0)), "123456");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, -0.0)), "-0");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1e5, chars_format::general)), "100000");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1e-5, chars_format::general)), "1e-05");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1.5f, chars_format::scientific)), "1.5e+00");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 0.25, chars_format::fixed)), "0.25");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1e23, chars_format::fixed)), "99999999999999991611392");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1.5, chars_format::hex)), "1.8p+0");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, std::numeric_limits <double>::denorm_min (),
+		chars_format::hex)), "0.0000000000001p-1022");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1.5, chars_format::hex, 0)), "2p+0");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 2.5, chars_format::fixed, 0)), "2");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 1.0 / 3, chars_format::scientific, 3)), "3.333e-01");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, -std::numeric_limits <float>::infinity ())), "-inf");
+
+	struct Test
+	{
+		const char* s;
+		chars_format fmt;
+		int end;
+		double value;
+		std::errc ec;
+	};
+
+	static const Test tests [] = {
+		{ "1.5e3x",    chars_format::general,     5,  1500, std::errc () },
+		{ "1.5e3",     chars_format::fixed,       3,   1.5, std::errc () },
+		{ "1.5",       chars_format::scientific,  0,     0, std::errc::invalid_argument },
+		{ "1e+",       chars_format::general,     1,     1, std::errc () },
+		{ "-.5",       chars_format::general,     3,  -0.5, std::errc () },
+		{ "+1",        chars_format::general,     0,     0, std::errc::invalid_argument },
+		{ " 1",        chars_format::general,     0,     0, std::errc::invalid_argument },
+		{ "1.8p1",     chars_format::hex,         5,     3, std::errc () },
+		{ "0x1",       chars_format::hex,         1,     0, std::errc () },
+		{ "1e400",     chars_format::general,     5,     0, std::errc::result_out_of_range },
+		{ "1e-400",    chars_format::general,     6,     0, std::errc::result_out_of_range },
+		{ "infinityx", chars_format::general,     8, std::numeric_limits <double>::infinity (), std::errc () },
+		{ "2.2250738585072011e-308", chars_format::general, 23, 2.2250738585072011e-308, std::errc () }
+	};
+
+	for (size_t i = 0; i < std::size (tests); ++i) {
+		const Test& test = tests [i];
+		double v = 0;
+		from_chars_result res = Nirvana::from_chars (test.s, test.s + strlen (test.s), v, test.fmt);
+		EXPECT_EQ (res.ec, test.ec) << i;
+		EXPECT_EQ (res.ptr, test.s + test.end) << i;
+		EXPECT_EQ (v, test.value) << i;
+	}
+
+	double nan;
+	const char nan_s [] = "-nan(123)";
+	EXPECT_EQ (Nirvana::from_chars (nan_s, nan_s + 9, nan).ptr, nan_s + 9);
+	EXPECT_TRUE (std::isnan (nan));
+
+	int i;
+	const char i_s [] = "-2147483649";
+	EXPECT_EQ (Nirvana::from_chars (i_s, i_s + 11, i).ec, std::errc::result_out_of_range);
+	unsigned u;
+	EXPECT_EQ (Nirvana::from_chars (i_s, i_s + 11, u).ec, std::errc::invalid_argument);
+	EXPECT_EQ (Nirvana::from_chars (i_s + 1, i_s + 11, u).ec, std::errc ());
+	EXPECT_EQ (u, 2147483649u);
+	const char h_s [] = "7fffffffG";
+	EXPECT_EQ (Nirvana::from_chars (h_s, h_s + 9, i, 16).ptr, h_s + 8);
+	EXPECT_EQ (i, INT32_MAX);
+}
+
+inline chars_format to_nirvana (std::chars_format fmt)
+{
+	return (chars_format)fmt;
+}
+
+inline int to_nirvana (int precision)
+{
+	return precision;
+}
+
+// Compare Nirvana::to_chars with std::to_chars.
+// The arguments after the value are the format and the precision, if any.
+template <typename F, typename ... Args>
+void to_chars_diff (F value, Args ... args)
+{
+	// Enough for the fixed notation of the long double extremes
+	static char buf [6000];
+	static char ref [6000];
+	to_chars_result res = Nirvana::to_chars (buf, std::end (buf), value, to_nirvana (args)...);
+	std::to_chars_result ref_res = std::to_chars (ref, std::end (ref), value, args...);
+	ASSERT_EQ (res.ec, std::errc ());
+	ASSERT_EQ (ref_res.ec, std::errc ());
+	size_t len = res.ptr - buf;
+	EXPECT_EQ (std::string (buf, len), std::string (ref, ref_res.ptr)) << (double)value;
+
+	// The exact size buffer is enough
+	EXPECT_EQ (Nirvana::to_chars (buf, buf + len, value, to_nirvana (args)...).ptr, buf + len);
+	EXPECT_EQ (Nirvana::to_chars (buf, buf + len - 1, value, to_nirvana (args)...).ec,
+		std::errc::value_too_large);
+}
+
+template <typename F>
+void to_chars_diff_all (F value, int precision)
+{
+	static const std::chars_format formats [] = {
+		std::chars_format::fixed, std::chars_format::scientific, std::chars_format::general
+	};
+
+	to_chars_diff (value);
+	for (std::chars_format fmt : formats) {
+		to_chars_diff (value, fmt);
+		to_chars_diff (value, fmt, precision);
+	}
+}
+
+TEST_F (TestLibrary, CharConvFloat)
+{
+	char buf [64];
+	char* const end = buf + sizeof (buf);
+	auto str = [&buf] (const to_chars_result& res) {
+		EXPECT_EQ (res.ec, std::errc ());
+		return std::string (buf, res.ptr);
+	};
+
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 0.5L, chars_format::scientific, 3)), "5.000e-01");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 0.5, chars_format::scientific, 17)),
+		"5.00000000000000000e-01");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 100.0, chars_format::general, 20)), "100");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 0.1, chars_format::fixed, 20)), "0.10000000000000000555");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 9.5, chars_format::general, 1)), "1e+01");
+	EXPECT_EQ (str (Nirvana::to_chars (buf, end, 0.0009765625, chars_format::general, 0)), "0.001");
+
+	std::mt19937_64 gen;
+	for (int i = 0; i < 1000; ++i) {
+		int precision = (int)(gen () % 40);
+		uint64_t bits = gen ();
+		double d;
+		memcpy (&d, &bits, sizeof (d));
+		if (!std::isfinite (d))
+			d = (double)(bits % 1000000) / (double)(1 << (bits % 20));
+		to_chars_diff_all (d, precision);
+		to_chars_diff_all ((float)(bits % 100000000) / (float)(1 << (bits % 30)), precision);
+
+		long double ld = std::ldexp ((long double)(bits >> 1), (int)(gen () % 400) - 230);
+		to_chars_diff_all (ld, precision);
+	}
+
+	static const long double values [] = { 0.5L, 123.456L, 1e23L, 0.1L, 1.0L / 3, 9.5L,
+		std::numeric_limits <long double>::denorm_min (), std::numeric_limits <long double>::max () };
+	for (long double v : values) {
+		to_chars_diff_all (v, 17);
+		to_chars_diff_all (v, 20);
+		to_chars_diff_all ((double)v, 17);
+	}
+}
+
 TEST_F (TestLibrary, Formatter)
 {
 	std::string s;
@@ -397,6 +822,22 @@ TEST_F (TestLibrary, Formatter)
 	EXPECT_EQ (s, "1 -1");
 	s.clear ();
 
+	cnt = Formatter::append_format (s, "%d %lld %llu %5d|%-5d|%+.3d",
+		0, -9223372036854775807LL - 1, 18446744073709551615ULL, 42, 42, 7);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "0 -9223372036854775808 18446744073709551615    42|42   |+007");
+	s.clear ();
+
+	cnt = Formatter::append_format (s, "%x %#X %#08x %o %#o %#.0o %.0x|", 0xBEEF, 0xBEEF, 0xBEEF, 8, 8, 0, 0);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "beef 0XBEEF 0x00beef 10 010 0 |");
+	s.clear ();
+
+	cnt = Formatter::append_format (s, "literal text \xE2\x82\xAC%%|%5s|%-4s|", "\xC3\xA9t\xC3\xA9", "ab");
+	EXPECT_EQ (cnt, 27);
+	EXPECT_EQ (s, "literal text \xE2\x82\xAC%|  \xC3\xA9t\xC3\xA9|ab  |");
+	s.clear ();
+
 	cnt = Formatter::append_format (s, "%e", 12345.6789);
 	EXPECT_EQ (cnt, s.size ());
 	EXPECT_EQ (s, "1.234568e+04");
@@ -416,6 +857,117 @@ TEST_F (TestLibrary, Formatter)
 	EXPECT_EQ (cnt, s.size ());
 	EXPECT_EQ (s, "-12345.678900");
 	s.clear ();
+
+	cnt = Formatter::append_format (s, "%.2f %.0f %.0f", 0.125, 0.5, 1.5);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "0.12 0 2");
+	s.clear ();
+
+	cnt = Formatter::append_format (s, "%g %g %g %g", 0.1, 100000.0, 1000000.0, 1e-5);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "0.1 100000 1e+06 1e-05");
+	s.clear ();
+
+	cnt = Formatter::append_format (s, "%.17g %#.3g", 0.1, 1.0);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "0.10000000000000001 1.00");
+	s.clear ();
+}
+
+TEST_F (TestLibrary, FormatterCompiled)
+{
+	Formatter::Compiled fmt ("%s=%5d|%-*d|%.*f|%%");
+	std::string s;
+	size_t cnt = Formatter::append_format (s, fmt, "a", 42, 4, 7, 2, 0.125);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "a=   42|7   |0.12|%");
+	s.clear ();
+
+	cnt = Formatter::append_format (s, fmt, "b", 1, -3, 2, -1, 0.5);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "b=    1|2  |0.500000|%");
+
+	char buf [8];
+	cnt = Formatter::format_buf (buf, sizeof (buf), fmt, "c", 1, 0, 2, 0, 1.0);
+	EXPECT_EQ (cnt, 13);
+	EXPECT_STREQ (buf, "c=    1");
+
+	EXPECT_THROW (Formatter::Compiled ("%y"), CORBA::BAD_PARAM);
+}
+
+TEST_F (TestLibrary, FormatterCount)
+{
+	std::string s;
+	format_to (s, "%s|%-6s|%08x|%#o|%+.3d|%5c|%.2f|%e", "\xC3\xA9t\xC3\xA9", "ab", 255, 8, 7, 'z',
+		1.005, 1e100);
+
+	WideOutCount <char> count;
+	format_to (count, "%s|%-6s|%08x|%#o|%+.3d|%5c|%.2f|%e", "\xC3\xA9t\xC3\xA9", "ab", 255, 8, 7, 'z',
+		1.005, 1e100);
+	EXPECT_EQ (count.count (), s.size ());
+
+	WideOutCount <wchar_t> wcount;
+	format_to (wcount, "%s|%-6s|%08x", "\xC3\xA9t\xC3\xA9", "ab", 255);
+	EXPECT_EQ (wcount.count (), 19);
+}
+
+static std::string format_loc (const struct lconv* loc, const char* fmt, ...)
+{
+	std::string s;
+	WideOutContainerT <std::string> out (s);
+	va_list args;
+	va_start (args, fmt);
+	Formatter::format (fmt, args, out, loc);
+	va_end (args);
+	return s;
+}
+
+TEST_F (TestLibrary, FormatterGrouping)
+{
+	struct lconv loc {};
+	loc.decimal_point = const_cast <char*> (",");
+	loc.thousands_sep = const_cast <char*> (".");
+	loc.grouping = const_cast <char*> ("\3");
+
+	EXPECT_EQ (format_loc (&loc, "%'d|%'d|%d|%'x", 1234567, -123, 1234567, 0x12345), "1.234.567|-123|1234567|12345");
+	EXPECT_EQ (format_loc (&loc, "%'8d|%'-8d|%'08d|%'.5d", 1234, 1234, 1234, 1234), "   1.234|1.234   |0001.234|01.234");
+	EXPECT_EQ (format_loc (&loc, "%'.2f|%'012.2f|%.1f|%'e", 1234567.891, -12345.5, 1.5, 12345.0),
+		"1.234.567,89|-0012.345,50|1,5|1,234500e+04");
+	EXPECT_EQ (format_loc (nullptr, "%'d|%'.1f", 1234567, 1234.5), "1234567|1234.5");
+
+	loc.thousands_sep = const_cast <char*> (",");
+	loc.grouping = const_cast <char*> ("\3\2");
+	EXPECT_EQ (format_loc (&loc, "%'lld", 1234567890LL), "1,23,45,67,890");
+}
+
+TEST_F (TestLibrary, Format)
+{
+	std::string s = Nirvana::format ("%d|%5s|%x|%.3f|%s|%-*d|%c", -5, "ab", (unsigned char)255, 3.14159,
+		std::string ("str"), 4, 7, 'z');
+	EXPECT_EQ (s, "-5|   ab|ff|3.142|str|7   |z");
+
+	// Length modifiers are ignored
+	s.clear ();
+	size_t cnt = format_to (s, "%hhd %lu %x", -3, ~0ULL, -1);
+	EXPECT_EQ (cnt, s.size ());
+	EXPECT_EQ (s, "-3 18446744073709551615 ffffffff");
+
+	std::wstring ws;
+	format_to (ws, "%s=%g", L"k", 1.5);
+	EXPECT_EQ (ws, L"k=1.5");
+
+	// Objects with to_string () method, like Fixed and Decimal
+	struct Money
+	{
+		std::string to_string () const
+		{
+			return "12.50";
+		}
+	};
+	EXPECT_EQ (Nirvana::format ("%6s", Money ()), " 12.50");
+
+	// Grouping flag is accepted, without the locale it has no effect
+	EXPECT_EQ (Nirvana::format ("%'d|%'8d", 1234567, -1234), "1234567|   -1234");
 }
 
 TEST_F (TestLibrary, FormatterF)
@@ -522,7 +1074,7 @@ TEST_F (TestLibrary, FormatterA)
 	cnt = Formatter::append_format (s, "%La", ld0);
 	EXPECT_EQ (cnt, s.size ());
 	if (sizeof (ld0) == 8)
-		EXPECT_EQ (s, "-0x1.fffffffffffffp+1024");
+		EXPECT_EQ (s, "-0x1.fffffffffffffp+1023");
 	ASSERT_EQ (strtof (s.c_str (), (char**)nullptr, ld), 0);
 	EXPECT_EQ (ld, ld0);
 	s.clear ();
@@ -531,7 +1083,7 @@ TEST_F (TestLibrary, FormatterA)
 	cnt = Formatter::append_format (s, "%La", ld0);
 	EXPECT_EQ (cnt, s.size ());
 	if (sizeof (ld0) == 8)
-		EXPECT_EQ (s, "0x1.fffffffffffffp+1024");
+		EXPECT_EQ (s, "0x1.fffffffffffffp+1023");
 	ASSERT_EQ (strtof (s.c_str (), (char**)nullptr, ld), 0);
 	EXPECT_EQ (ld, ld0);
 	s.clear ();
@@ -541,7 +1093,7 @@ TEST_F (TestLibrary, FormatterA)
 	EXPECT_EQ (cnt, s.size ());
 	ASSERT_EQ (strtof (s.c_str (), (char**)nullptr, ld), 0);
 	if (sizeof (ld0) == 8)
-		EXPECT_EQ (s, "0x0.0000000000000p+00");
+		EXPECT_EQ (s, "0x0p+0");
 	EXPECT_EQ (ld, ld0);
 	s.clear ();
 
@@ -556,6 +1108,58 @@ TEST_F (TestLibrary, FormatterA)
 		ASSERT_EQ (ld, ld0) << i << ' ' << s;
 		s.clear ();
 	}
+
+	// Rounding at the precision is half to even
+	Formatter::append_format (s, "%.0a", 1.5);
+	EXPECT_EQ (s, "0x2p+0");
+	s.clear ();
+	Formatter::append_format (s, "%.0a", 1.25);
+	EXPECT_EQ (s, "0x1p+0");
+	s.clear ();
+	Formatter::append_format (s, "%.1a", 1.03125);
+	EXPECT_EQ (s, "0x1.0p+0");
+	s.clear ();
+	Formatter::append_format (s, "%.1a", 1.09375);
+	EXPECT_EQ (s, "0x1.2p+0");
+	s.clear ();
+	Formatter::append_format (s, "%.2a", 0.1);
+	EXPECT_EQ (s, "0x1.9ap-4");
+	s.clear ();
+	Formatter::append_format (s, "%a", std::numeric_limits <double>::denorm_min ());
+	EXPECT_EQ (s, "0x1p-1074");
+	s.clear ();
+	Formatter::append_format (s, "%-12.1A|", -3.0);
+	EXPECT_EQ (s, "-0X1.8P+1   |");
+}
+
+TEST_F (TestLibrary, HexFloatExponent)
+{
+	// The hexadecimal exponent convention is shared by the formatter and the parser.
+	// Both are checked against std::to_chars, so a change on one side only fails here.
+	std::mt19937_64 gen;
+	for (int i = 0; i < 1000; ++i) {
+		double v = std::ldexp ((double)(gen () >> 11) / (double)((uint64_t)1 << 53),
+			(int)(gen () % 2040) - 1020);
+		// The formatter writes subnormals normalized
+		if (!std::isnormal (v))
+			continue;
+		if (i % 2)
+			v = -v;
+
+		char ref [64];
+		std::to_chars_result res = std::to_chars (ref, std::end (ref), std::fabs (v),
+			std::chars_format::hex);
+		ASSERT_EQ (res.ec, std::errc ());
+		std::string expected = std::string (v < 0 ? "-0x" : "0x") + std::string (ref, res.ptr);
+
+		std::string s;
+		Formatter::append_format (s, "%a", v);
+		EXPECT_EQ (s, expected);
+
+		double parsed;
+		ASSERT_EQ (strtof (expected.c_str (), (char**)nullptr, parsed), 0) << expected;
+		EXPECT_EQ (parsed, v) << expected;
+	}
 }
 
 TEST_F (TestLibrary, Scan)
@@ -566,6 +1170,394 @@ TEST_F (TestLibrary, Scan)
 	EXPECT_EQ (cnt, 2);
 	EXPECT_EQ (i, 10);
 	EXPECT_EQ (f, 3.5);
+
+	double d = 0;
+	EXPECT_THROW (Parser::parse ("+-5", "%lf", &d), CORBA::DATA_CONVERSION);
+
+	// Out of range values are stored as infinity, the scan continues
+	cnt = Parser::parse ("1e51 7", "%f %i", &f, &i);
+	EXPECT_EQ (cnt, 2);
+	EXPECT_EQ (f, std::numeric_limits <float>::infinity ());
+	EXPECT_EQ (i, 7);
+	cnt = Parser::parse ("-1e400 8", "%lf %i", &d, &i);
+	EXPECT_EQ (cnt, 2);
+	EXPECT_EQ (d, -std::numeric_limits <double>::infinity ());
+	EXPECT_EQ (i, 8);
+
+	// Conversions before the invalid specification are performed
+	int j = 0;
+	EXPECT_THROW (Parser::parse ("1 2 3", "%d %d %y", &i, &j), CORBA::BAD_PARAM);
+	EXPECT_EQ (i, 1);
+	EXPECT_EQ (j, 2);
+}
+
+TEST_F (TestLibrary, ScanCompiled)
+{
+	Parser::Compiled fmt ("%d-%2s%*s %lf <%[^>]> %x %c%n %hhu");
+	for (int pass = 0; pass < 2; ++pass) {
+		int d = 0, n = 0;
+		char s [4] = { 0 }, set [8] = { 0 }, c = 0;
+		double x = 0;
+		unsigned h = 0;
+		unsigned char uc = 0;
+		size_t cnt = Parser::parse ("-12-abc 2.5e3 <ab c> ff Z 300", fmt, &d, s, &x, set, &h, &c, &n, &uc);
+		EXPECT_EQ (cnt, 8);
+		EXPECT_EQ (d, -12);
+		EXPECT_STREQ (s, "ab");
+		EXPECT_EQ (x, 2500);
+		EXPECT_STREQ (set, "ab c");
+		EXPECT_EQ (h, 255);
+		EXPECT_EQ (c, 'Z');
+		EXPECT_EQ (n, 25);
+		EXPECT_EQ (uc, 255);
+	}
+
+	char s [8] = { 0 };
+	wchar_t w [4] = { 0 };
+	int n = 0;
+	size_t cnt = Parser::parse ("\xD0\x96\xD0\xB8 \xD0\x96! ", "%s %ls %n", s, w, &n);
+	EXPECT_EQ (cnt, 2);
+	EXPECT_STREQ (s, "\xD0\x96\xD0\xB8");
+	EXPECT_EQ (w [0], 0x416);
+	EXPECT_EQ (w [1], '!');
+
+	wchar_t ws [4] = { 0 };
+	double v = 0;
+	cnt = Parser::parse (L"abc 1.25", L"%ls %lf", ws, &v);
+	EXPECT_EQ (cnt, 2);
+	EXPECT_STREQ (ws, L"abc");
+	EXPECT_EQ (v, 1.25);
+}
+
+TEST_F (TestLibrary, StrftimeLocaleFormats)
+{
+	struct tm tm {};
+	tm.tm_year = 124;
+	tm.tm_mon = 1;
+	tm.tm_mday = 9;
+	tm.tm_wday = 5;
+	tm.tm_yday = 39;
+	tm.tm_hour = 13;
+	tm.tm_min = 5;
+	tm.tm_sec = 7;
+
+	char buf [64];
+	size_t cnt = strftime (buf, sizeof (buf), "%c", &tm);
+	EXPECT_EQ (cnt, 24);
+	EXPECT_STREQ (buf, "Fri Feb  9 13:05:07 2024");
+	EXPECT_EQ (strftime (buf, sizeof (buf), "%x|%X", &tm), 17);
+	EXPECT_STREQ (buf, "02/09/24|13:05:07");
+	EXPECT_EQ (strftime (buf, sizeof (buf), "%r", &tm), 11);
+	EXPECT_STREQ (buf, "01:05:07 PM");
+	EXPECT_EQ (strftime (buf, sizeof (buf), "<%Ec|%Ex>", &tm), 35);
+	EXPECT_STREQ (buf, "<Fri Feb  9 13:05:07 2024|02/09/24>");
+}
+
+TEST_F (TestLibrary, WideCase)
+{
+	EXPECT_EQ (wcscasecmp (L"Hello, World", L"hELLO, wORLD"), 0);
+	EXPECT_EQ (wcscasecmp (L"\x0100\x0411\x00C0", L"\x0101\x0431\x00E0"), 0);
+	EXPECT_LT (wcscasecmp (L"abc", L"ABD"), 0);
+	EXPECT_GT (wcscasecmp (L"abcd", L"ABC"), 0);
+	EXPECT_LT (wcscasecmp (L"", L"a"), 0);
+	EXPECT_EQ (wcsncasecmp (L"abcX", L"ABCy", 3), 0);
+	EXPECT_NE (wcsncasecmp (L"abcX", L"ABCy", 4), 0);
+	EXPECT_EQ (wcsncasecmp (L"a", L"b", 0), 0);
+	EXPECT_EQ (wcsncasecmp (L"ab", L"AB", 10), 0);
+
+	// The lengths cover the whole words and the tails of the word-at-a-time conversion,
+	// the non-ASCII character is placed in each position.
+	static const wchar_t mixed [] = L"Hello, World! @[`{ AZaz 09 \x00C0\x00E0 \x0100\x0101 \x0411\x0431";
+	static const wchar_t lower [] = L"hello, world! @[`{ azaz 09 \x00E0\x00E0 \x0101\x0101 \x0431\x0431";
+	static const wchar_t upper [] = L"HELLO, WORLD! @[`{ AZAZ 09 \x00C0\x00C0 \x0100\x0100 \x0411\x0411";
+	const size_t len = std::size (mixed) - 1;
+	for (size_t n = 0; n <= len; ++n) {
+		for (size_t pos = 0; pos <= std::min (n, (size_t)9); ++pos) {
+			wchar_t src [std::size (mixed)];
+			std::copy (mixed, mixed + len + 1, src);
+			if (pos < n)
+				src [pos] = L'\x00C9';
+			wchar_t exp_lower [std::size (mixed)], exp_upper [std::size (mixed)];
+			for (size_t i = 0; i <= len; ++i) {
+				exp_lower [i] = i < n ? lower [i] : src [i];
+				exp_upper [i] = i < n ? upper [i] : src [i];
+			}
+			if (pos < n) {
+				exp_lower [pos] = L'\x00E9';
+				exp_upper [pos] = L'\x00C9';
+			}
+
+			wchar_t dst [std::size (mixed)];
+			std::copy (src, src + len + 1, dst);
+			towlower_n (dst, src, n);
+			EXPECT_TRUE (std::equal (dst, dst + len + 1, exp_lower)) << n << ' ' << pos;
+			std::copy (src, src + len + 1, dst);
+			towupper_n (dst, src, n);
+			EXPECT_TRUE (std::equal (dst, dst + len + 1, exp_upper)) << n << ' ' << pos;
+
+			// In place
+			towlower_n (src, src, n);
+			EXPECT_TRUE (std::equal (src, src + len + 1, exp_lower)) << n << ' ' << pos;
+		}
+	}
+
+	wchar_t empty = L'A';
+	towlower_n (&empty, &empty, 0);
+	EXPECT_EQ (empty, L'A');
+}
+
+TEST_F (TestLibrary, CType)
+{
+	for (int c = 0; c < 256; ++c) {
+		bool xdigit = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+		EXPECT_EQ (isxdigit (c) != 0, xdigit) << c;
+	}
+
+	// The _l variants test the category bits, the locale may differ above ASCII only
+	locale_t loc = (locale_t)LC_GLOBAL_LOCALE;
+	for (int c = 0; c < 0x80; ++c) {
+		EXPECT_EQ (isalnum_l (c, loc) != 0, isalnum (c) != 0) << c;
+		EXPECT_EQ (isalpha_l (c, loc) != 0, isalpha (c) != 0) << c;
+		EXPECT_EQ (isblank_l (c, loc) != 0, isblank (c) != 0) << c;
+		EXPECT_EQ (iscntrl_l (c, loc) != 0, iscntrl (c) != 0) << c;
+		EXPECT_EQ (isdigit_l (c, loc) != 0, isdigit (c) != 0) << c;
+		EXPECT_EQ (isgraph_l (c, loc) != 0, isgraph (c) != 0) << c;
+		EXPECT_EQ (islower_l (c, loc) != 0, islower (c) != 0) << c;
+		EXPECT_EQ (isprint_l (c, loc) != 0, isprint (c) != 0) << c;
+		EXPECT_EQ (ispunct_l (c, loc) != 0, ispunct (c) != 0) << c;
+		EXPECT_EQ (isspace_l (c, loc) != 0, isspace (c) != 0) << c;
+		EXPECT_EQ (isupper_l (c, loc) != 0, isupper (c) != 0) << c;
+		EXPECT_EQ (isxdigit_l (c, loc) != 0, isxdigit (c) != 0) << c;
+	}
+	EXPECT_TRUE (isalpha_l ('a', loc));
+	EXPECT_TRUE (isalnum_l ('Z', loc));
+	EXPECT_TRUE (isxdigit_l ('f', loc));
+	EXPECT_FALSE (isxdigit_l ('g', loc));
+	EXPECT_TRUE (isprint (' '));
+	EXPECT_FALSE (isgraph (' '));
+	EXPECT_FALSE (isalpha (0xC0));
+	EXPECT_FALSE (isalpha (EOF));
+}
+
+TEST_F (TestLibrary, WCType)
+{
+	enum
+	{
+		ALPHA = 0x01,
+		ALNUM = 0x02,
+		UPPER = 0x04,
+		LOWER = 0x08,
+		SPACE = 0x10,
+		PUNCT = 0x20,
+		PRINT = 0x40,
+		GRAPH = 0x80,
+		CNTRL = 0x100
+	};
+
+	static const struct
+	{
+		wint_t c;
+		unsigned classes;
+	} tests [] = {
+		{ L'A', ALPHA | ALNUM | UPPER | PRINT | GRAPH },
+		{ L'z', ALPHA | ALNUM | LOWER | PRINT | GRAPH },
+		{ L'7', ALNUM | PRINT | GRAPH },
+		{ L'!', PUNCT | PRINT | GRAPH },
+		{ L' ', SPACE | PRINT },
+		{ L'\n', SPACE | CNTRL },
+		{ 0x00C0, ALPHA | ALNUM | UPPER | PRINT | GRAPH }, // Latin capital A with grave
+		{ 0x0431, ALPHA | ALNUM | LOWER | PRINT | GRAPH }, // Cyrillic small be
+		{ 0x01C5, ALPHA | ALNUM | PRINT | GRAPH },         // Titlecase letter
+		{ 0x05D0, ALPHA | ALNUM | PRINT | GRAPH },         // Hebrew alef
+		{ 0x4E00, ALPHA | ALNUM | PRINT | GRAPH },         // CJK ideograph
+		{ 0x0660, ALNUM | PRINT | GRAPH },                 // Arabic-indic digit zero
+		{ 0x2160, ALPHA | ALNUM | PRINT | GRAPH },         // Roman numeral one
+		{ 0x00A0, SPACE | PRINT },                         // No-break space
+		{ 0x2028, SPACE | PRINT | CNTRL },                 // Line separator
+		{ 0x20AC, PUNCT | PRINT | GRAPH },                 // Euro sign
+		{ 0x200B, 0 },                                     // Zero width space, format
+		{ 0xD800, 0 },                                     // Surrogate
+		{ 0x0378, 0 },                                     // Unassigned
+		{ 0xE0100, PRINT | GRAPH },                        // Variation selector
+		{ 0x10FFFF, 0 },
+		{ 0x110000, 0 }
+	};
+
+	for (const auto& test : tests) {
+		wint_t c = test.c;
+		EXPECT_EQ (iswalpha (c) != 0, (test.classes & ALPHA) != 0) << c;
+		EXPECT_EQ (iswalnum (c) != 0, (test.classes & ALNUM) != 0) << c;
+		EXPECT_EQ (iswupper (c) != 0, (test.classes & UPPER) != 0) << c;
+		EXPECT_EQ (iswlower (c) != 0, (test.classes & LOWER) != 0) << c;
+		EXPECT_EQ (iswspace (c) != 0, (test.classes & SPACE) != 0) << c;
+		EXPECT_EQ (iswpunct (c) != 0, (test.classes & PUNCT) != 0) << c;
+		EXPECT_EQ (iswprint (c) != 0, (test.classes & PRINT) != 0) << c;
+		EXPECT_EQ (iswgraph (c) != 0, (test.classes & GRAPH) != 0) << c;
+		EXPECT_EQ (iswcntrl (c) != 0, (test.classes & CNTRL) != 0) << c;
+	}
+
+	// The ASCII classes agree with the narrow ones
+	for (int c = 0; c < 0x80; ++c) {
+		EXPECT_EQ (iswalpha (c) != 0, isalpha (c) != 0) << c;
+		EXPECT_EQ (iswdigit (c) != 0, isdigit (c) != 0) << c;
+		EXPECT_EQ (iswxdigit (c) != 0, isxdigit (c) != 0) << c;
+		EXPECT_EQ (iswupper (c) != 0, isupper (c) != 0) << c;
+		EXPECT_EQ (iswlower (c) != 0, islower (c) != 0) << c;
+		EXPECT_EQ (iswpunct (c) != 0, ispunct (c) != 0) << c;
+	}
+}
+
+// Single-byte code page for the CodePageTable test.
+// ASCII, the Cyrillic capital and small letters at 0xC0-0xFF, the euro sign at 0x80
+// and the second mapping of 'A' at 0x9F. The other octets are not defined.
+class TestCodePage :
+	public IDL::traits <Nirvana::CodePage>::ServantStatic <TestCodePage>
+{
+public:
+	static const char* name () noexcept
+	{
+		return "test";
+	}
+
+	static bool defined (unsigned c) noexcept
+	{
+		return c < 0x80 || c >= 0xC0 || c == 0x80 || c == 0x9F;
+	}
+
+	static uint32_t to_wide (uint8_t c)
+	{
+		if (c < 0x80)
+			return c;
+		else if (c >= 0xC0)
+			return 0x0410 + (c - 0xC0);
+		else if (c == 0x80)
+			return 0x20AC;
+		else if (c == 0x9F)
+			return 'A';
+		throw CORBA::CODESET_INCOMPATIBLE ();
+	}
+
+	static uint8_t to_narrow (uint32_t wc, uint8_t default_char, bool& used_default)
+	{
+		used_default = false;
+		for (unsigned c = 0; c < 256; ++c) {
+			if (defined (c) && to_wide ((uint8_t)c) == wc)
+				return (uint8_t)c;
+		}
+		if (default_char > 0x7F)
+			throw CORBA::CODESET_INCOMPATIBLE ();
+		used_default = true;
+		return default_char;
+	}
+
+	static Nirvana::CodePage::CharCategory get_category (uint8_t c) noexcept
+	{
+		return 0;
+	}
+
+	static uint8_t to_upper (uint8_t c) noexcept
+	{
+		return c;
+	}
+
+	static uint8_t to_lower (uint8_t c) noexcept
+	{
+		return c;
+	}
+};
+
+TEST_F (TestLibrary, CodePageTable)
+{
+	Nirvana::CodePage::_ptr_type cp = TestCodePage::_get_ptr ();
+	std::unique_ptr <CRTL::CodePageTable> table (new CRTL::CodePageTable);
+	EXPECT_FALSE (table->is_same (cp));
+	table->build (cp);
+	EXPECT_TRUE (table->is_same (cp));
+
+	// Each defined octet converts to wide and back.
+	// The second mapping of the wide character converts back to the first octet.
+	for (unsigned c = 0; c < 256; ++c) {
+		const char narrow = (char)c;
+		const char* src = &narrow;
+		wchar_t wide = 0;
+		wchar_t* dst = &wide;
+		bool defined = TestCodePage::defined (c);
+		EXPECT_EQ (table->to_wide (src, &narrow + 1, dst, &wide + 1), defined) << c;
+		if (!defined) {
+			// Unmapped octet is not consumed
+			EXPECT_EQ (src, &narrow) << c;
+			EXPECT_EQ (dst, &wide) << c;
+			continue;
+		}
+		EXPECT_EQ ((uint32_t)wide, TestCodePage::to_wide ((uint8_t)c)) << c;
+
+		const wchar_t* wsrc = &wide;
+		char back = 0;
+		char* ndst = &back;
+		EXPECT_TRUE (table->to_narrow (wsrc, &wide + 1, ndst, &back + 1)) << c;
+		EXPECT_EQ (ndst, &back + 1) << c;
+		EXPECT_EQ ((uint8_t)back, c == 0x9F ? (unsigned)'A' : c) << c;
+	}
+
+	// String round trip
+	static const char text [] = "Text \xC0\xE0\xFF \x80";
+	const size_t len = std::size (text);
+	wchar_t wide [std::size (text)];
+	const char* src = text;
+	wchar_t* wdst = wide;
+	EXPECT_TRUE (table->to_wide (src, text + len, wdst, wide + len));
+	EXPECT_EQ (src, text + len);
+	EXPECT_EQ (wdst, wide + len);
+	EXPECT_EQ (wide [5], (wchar_t)0x0410);
+	EXPECT_EQ (wide [7], (wchar_t)0x044F);
+	EXPECT_EQ (wide [len - 1], 0);
+
+	char narrow [std::size (text)];
+	const wchar_t* wsrc = wide;
+	char* dst = narrow;
+	EXPECT_TRUE (table->to_narrow (wsrc, wide + len, dst, narrow + len));
+	EXPECT_EQ (dst, narrow + len);
+	EXPECT_EQ (memcmp (narrow, text, len), 0);
+
+	// The conversion stops at the unmapped octet
+	static const char bad [] = "ab\x81" "cd";
+	src = bad;
+	wdst = wide;
+	EXPECT_FALSE (table->to_wide (src, bad + std::size (bad), wdst, wide + len));
+	EXPECT_EQ (src, bad + 2);
+	EXPECT_EQ (wdst, wide + 2);
+
+	// The conversion stops if there is no room
+	src = text;
+	wdst = wide;
+	EXPECT_TRUE (table->to_wide (src, text + len, wdst, wide + 3));
+	EXPECT_EQ (src, text + 3);
+
+	// The code page substitutes the default character for a character it can not represent.
+	// The table has no default character and fails on such characters, so the conversion
+	// functions return EILSEQ as with CodePage::NO_DEFAULT.
+	bool used_default = false;
+	EXPECT_EQ (cp->to_narrow (0xE9, '?', used_default), '?');
+	EXPECT_TRUE (used_default);
+	EXPECT_THROW (cp->to_narrow (0xE9, Nirvana::CodePage::NO_DEFAULT, used_default),
+		CORBA::CODESET_INCOMPATIBLE);
+
+	static const wchar_t wbad [] = L"ab\x00E9" L"cd";
+	wsrc = wbad;
+	dst = narrow;
+	EXPECT_FALSE (table->to_narrow (wsrc, wbad + std::size (wbad), dst, narrow + len));
+	EXPECT_EQ (wsrc, wbad + 2);
+	EXPECT_EQ (dst, narrow + 2);
+
+	// The wide character mapped to the zero octet is the null only
+	static const wchar_t wnull [] = { 0x0100, 0 };
+	wsrc = wnull;
+	dst = narrow;
+	EXPECT_FALSE (table->to_narrow (wsrc, wnull + 2, dst, narrow + len));
+	EXPECT_EQ (wsrc, wnull);
+	wsrc = wnull + 1;
+	EXPECT_TRUE (table->to_narrow (wsrc, wnull + 2, dst, narrow + len));
+	EXPECT_EQ (narrow [0], 0);
 }
 
 }